@@ -0,0 +1,158 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+	std::atomic<bool> b_Counting(false);
+	std::atomic<long long> allocationCount(0);
+
+	// Every overload ends up in these, so whatever new the library picks, any matching delete frees it
+	void* Allocate(std::size_t size) {
+		if (b_Counting.load(std::memory_order_relaxed)) {
+			allocationCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (size == 0) size = 1;
+		for (;;) {
+			if (void* p = std::malloc(size)) return p;
+
+			std::new_handler handler = std::get_new_handler();
+			if (!handler) throw std::bad_alloc();
+			handler();
+		}
+	}
+
+	void Free(void* p) noexcept {
+		std::free(p);
+	}
+
+	// Over-aligned blocks keep the malloc pointer just below the aligned one; MSVC has no
+	// aligned_alloc, and _aligned_malloc would need its own free
+	void* AllocateAligned(std::size_t size, std::align_val_t alignment) {
+		std::size_t align = (std::size_t)alignment;
+		if (align < alignof(void*)) align = alignof(void*);
+
+		void* block = Allocate(size + align + sizeof(void*));
+		std::uintptr_t aligned = ((std::uintptr_t)block + sizeof(void*) + align - 1) & ~(std::uintptr_t)(align - 1);
+		((void**)aligned)[-1] = block;
+		return (void*)aligned;
+	}
+
+	void FreeAligned(void* p) noexcept {
+		if (p) Free(((void**)p)[-1]);
+	}
+}
+
+void AllocationCounter::Start() {
+	allocationCount = 0;
+	b_Counting = true;
+}
+
+long long AllocationCounter::Stop() {
+	b_Counting = false;
+	return allocationCount;
+}
+
+void* operator new(std::size_t size) {
+	return Allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+	return Allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return Allocate(size);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return Allocate(size);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return AllocateAligned(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try {
+		return AllocateAligned(size, alignment);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try {
+		return AllocateAligned(size, alignment);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void operator delete(void* p) noexcept {
+	Free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	Free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	Free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+	Free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+	Free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	Free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+	FreeAligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+	FreeAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+	FreeAligned(p);
+}
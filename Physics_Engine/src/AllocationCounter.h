@@ -0,0 +1,11 @@
+#pragma once
+
+// Counts heap allocations between Start and Stop. AllocationCounter.cpp replaces every global
+// operator new and delete, so it is only linked into the headless executable, never the game.
+class AllocationCounter {
+public:
+	static void Start();
+
+	// Allocations made on any thread since Start
+	static long long Stop();
+};
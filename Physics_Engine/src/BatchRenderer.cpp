@@ -0,0 +1,147 @@
+#include "BatchRenderer.h"
+#include "rlgl.h"
+
+#include <cmath>
+
+BatchRenderer::BatchRenderer() {
+	for (int i = 0; i <= CIRCLE_SEGMENTS; i++) {
+		float angle = 2.0f * PI * (float)i / (float)CIRCLE_SEGMENTS;
+		unitCircle[i][0] = std::cos(angle);
+		unitCircle[i][1] = std::sin(angle);
+	}
+}
+
+void BatchRenderer::Begin() {
+	triangles.clear();
+	lines.clear();
+}
+
+void BatchRenderer::AddPiece(const RenderSnapshot::Piece& piece) {
+	if (piece.type == FlatShape::Box) {
+		AddBox(piece.position, piece.angle, piece.width, piece.height, piece.color);
+	}
+	else if (piece.type == FlatShape::Circle) {
+		AddCircle(piece.position, piece.angle, piece.radius, piece.color);
+	}
+	else if (piece.type == FlatShape::Segment) {
+		float hx = std::cos(piece.angle) * piece.width * 0.5f;
+		float hy = std::sin(piece.angle) * piece.width * 0.5f;
+		AddThickLine(piece.position.x - hx, piece.position.y - hy, piece.position.x + hx, piece.position.y + hy,
+			RenderSnapshot::Piece::SEGMENT_THICKNESS, piece.color);
+	}
+}
+
+void BatchRenderer::AddParticles(const std::vector<float>& x, const std::vector<float>& y, const float& r,
+	const FlatAABB& view, const Color& color)
+{
+	for (size_t i = 0; i < x.size(); i++) {
+		if (x[i] + r < view.min.x || x[i] - r > view.max.x || y[i] + r < view.min.y || y[i] - r > view.max.y) {
+			continue;
+		}
+
+		triangles.push_back({ x[i] + r, y[i] + r, color });
+		triangles.push_back({ x[i] + r, y[i] - r, color });
+		triangles.push_back({ x[i] - r, y[i] - r, color });
+		triangles.push_back({ x[i] - r, y[i] + r, color });
+		triangles.push_back({ x[i] + r, y[i] + r, color });
+		triangles.push_back({ x[i] - r, y[i] - r, color });
+	}
+}
+
+void BatchRenderer::AddBox(const FlatVector& p, const float& angle, const float& width, const float& height, const Color& fillColor) {
+	float c = std::cos(angle);
+	float s = std::sin(angle);
+	float hw = width * 0.5f;
+	float hh = height * 0.5f;
+
+	// same corner order as FlatShape::CreateBoxVertices
+	float local[4][2] = { { -hw, -hh }, { hw, -hh }, { hw, hh }, { -hw, hh } };
+	float corners[4][2];
+	for (int i = 0; i < 4; i++) {
+		corners[i][0] = c * local[i][0] - s * local[i][1] + p.x;
+		corners[i][1] = s * local[i][0] + c * local[i][1] + p.y;
+	}
+
+	// counter-clockwise on screen, as Graphics::DrawPolygonFill emits them
+	const int order[6] = { 2, 1, 0, 3, 2, 0 };
+	for (int i = 0; i < 6; i++) {
+		triangles.push_back({ corners[order[i]][0], corners[order[i]][1], fillColor });
+	}
+
+	for (int i = 0; i < 4; i++) {
+		int j = (i + 1) % 4;
+		AddLine(corners[i][0], corners[i][1], corners[j][0], corners[j][1], BLUE);
+	}
+}
+
+void BatchRenderer::AddCircle(const FlatVector& p, const float& angle, const float& r, const Color& fillColor) {
+	for (int i = 0; i < CIRCLE_SEGMENTS; i++) {
+		float ax = p.x + unitCircle[i][0] * r;
+		float ay = p.y + unitCircle[i][1] * r;
+		float bx = p.x + unitCircle[i + 1][0] * r;
+		float by = p.y + unitCircle[i + 1][1] * r;
+
+		triangles.push_back({ p.x, p.y, fillColor });
+		triangles.push_back({ bx, by, fillColor });
+		triangles.push_back({ ax, ay, fillColor });
+
+		AddLine(ax, ay, bx, by, BLUE);
+	}
+
+	AddThickLine(p.x, p.y, p.x + std::cos(angle) * r, p.y + std::sin(angle) * r, 0.1f, RED);
+}
+
+void BatchRenderer::AddLine(const float& ax, const float& ay, const float& bx, const float& by, const Color& color) {
+	lines.push_back({ ax, ay, color });
+	lines.push_back({ bx, by, color });
+}
+
+void BatchRenderer::AddThickLine(const float& ax, const float& ay, const float& bx, const float& by,
+	const float& thick, const Color& color)
+{
+	float dx = bx - ax;
+	float dy = by - ay;
+	float length = std::sqrt(dx * dx + dy * dy);
+	if (length < 1e-6f) return;
+
+	float nx = -dy / length * thick * 0.5f;
+	float ny = dx / length * thick * 0.5f;
+
+	triangles.push_back({ ax - nx, ay - ny, color });
+	triangles.push_back({ ax + nx, ay + ny, color });
+	triangles.push_back({ bx - nx, by - ny, color });
+
+	triangles.push_back({ ax + nx, ay + ny, color });
+	triangles.push_back({ bx + nx, by + ny, color });
+	triangles.push_back({ bx - nx, by - ny, color });
+}
+
+void BatchRenderer::Flush() {
+	Submit(triangles, RL_TRIANGLES);
+	Submit(lines, RL_LINES);
+}
+
+void BatchRenderer::Submit(const std::vector<Vertex>& vertices, const int& mode) {
+	rlSetTexture(0);
+
+	for (size_t start = 0; start < vertices.size(); start += BATCH_VERTICES) {
+		size_t end = std::min(start + BATCH_VERTICES, vertices.size());
+
+		rlCheckRenderBatchLimit((int)(end - start));
+		rlBegin(mode);
+		for (size_t i = start; i < end; i++) {
+			const Vertex& v = vertices[i];
+			rlColor4ub(v.color.r, v.color.g, v.color.b, v.color.a);
+			rlVertex2f(v.x, v.y);
+		}
+		rlEnd();
+	}
+}
+
+size_t BatchRenderer::TriangleCount() const {
+	return triangles.size() / 3;
+}
+
+size_t BatchRenderer::LineCount() const {
+	return lines.size() / 2;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "raylib.h"
+#include "RenderSnapshot.h"
+#include <vector>
+
+// Packs every piece of a frame into two flat vertex buffers (triangles and
+// lines) and submits them to rlgl in a handful of batches, instead of a
+// raylib shape call per primitive.
+class BatchRenderer {
+public:
+	static const int CIRCLE_SEGMENTS = 24;
+
+private:
+	struct Vertex {
+		float x;
+		float y;
+		Color color;
+	};
+
+	static const int BATCH_VERTICES = 3 * 1024; // multiple of 2 and 3
+
+	std::vector<Vertex> triangles;
+	std::vector<Vertex> lines;
+	float unitCircle[CIRCLE_SEGMENTS + 1][2];
+
+public:
+	BatchRenderer();
+
+	void Begin();
+	void AddPiece(const RenderSnapshot::Piece& piece);
+
+	// One unlined square per particle inside view
+	void AddParticles(const std::vector<float>& x, const std::vector<float>& y, const float& radius,
+		const FlatAABB& view, const Color& color);
+	void Flush();
+
+	size_t TriangleCount() const;
+	size_t LineCount() const;
+
+private:
+	void AddBox(const FlatVector& p, const float& angle, const float& width, const float& height, const Color& fillColor);
+	void AddCircle(const FlatVector& p, const float& angle, const float& radius, const Color& fillColor);
+	void AddLine(const float& ax, const float& ay, const float& bx, const float& by, const Color& color);
+	void AddThickLine(const float& ax, const float& ay, const float& bx, const float& by, const float& thick, const Color& color);
+
+	static void Submit(const std::vector<Vertex>& vertices, const int& mode);
+};
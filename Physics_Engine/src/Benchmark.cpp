@@ -0,0 +1,498 @@
+#include "Benchmark.h"
+#include "FlatMath.h"
+#include "FlatFixed.h"
+#include "FlatWorld.h"
+#include "FlatContactSolver.h"
+#include "Collisions.h"
+#include "AllocationCounter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+	constexpr int MATH_POINTS = 4096;
+	constexpr int MATH_ROUNDS = 500;
+
+	// results are written here so the optimizer can't drop the measured work
+	volatile float sink;
+
+	float Uniform(std::mt19937& rng, const float& a, const float& b) {
+		// 24 random bits, so the inputs don't depend on the standard library's distributions
+		return a + (b - a) * (float)(rng() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// What the engine does per vertex and contact: transform, normalize, dot, cross, length.
+	template<typename T>
+	double MathKernel(const std::vector<float>& input) {
+		std::vector<FlatVectorT<T>> points;
+		for (int i = 0; i + 1 < input.size(); i += 2) {
+			points.emplace_back(T(input[i]), T(input[i + 1]));
+		}
+
+		FlatTransformT<T> transform(FlatVectorT<T>(T(1.5f), T(-2.0f)), T(0.7f));
+		FlatVectorT<T> axis(T(0.6f), T(0.8f));
+		T sum(0);
+
+		auto st = std::chrono::steady_clock::now();
+		for (int round = 0; round < MATH_ROUNDS; round++) {
+			for (int i = 0; i + 1 < points.size(); i++) {
+				FlatVectorT<T> a = FlatVectorT<T>::Transform(points[i], transform);
+				FlatVectorT<T> b = FlatVectorT<T>::Transform(points[i + 1], transform);
+				FlatVectorT<T> n = FlatMathT<T>::Normalize(b - a);
+
+				sum += FlatMathT<T>::Dot(n, axis) + FlatMathT<T>::Cross(a, n) * T(0.001f);
+				sum += FlatMathT<T>::Length(a - b) * T(0.001f);
+			}
+		}
+		auto ed = std::chrono::steady_clock::now();
+
+		sink = (float)(sum == T(0));
+		return std::chrono::duration<double, std::nano>(ed - st).count() / ((double)MATH_ROUNDS * (points.size() - 1));
+	}
+
+	double WorldStep(std::mt19937& rng) {
+		FlatWorld world;
+		world.SetThreadCount(1);
+
+		FlatBody* ground = nullptr;
+		FlatBody::CreateBoxBody(200.0f, 2.0f, 1.0f, true, 0.5f, ground);
+		ground->MoveTo(FlatVector(0.0f, 30.0f));
+		world.AddBody(ground);
+
+		std::shared_ptr<const FlatShape> box, circle;
+		FlatShape::CreateBox(1.0f, 1.0f, box);
+		FlatShape::CreateCircle(0.5f, circle);
+
+		for (int i = 0; i < 1000; i++) {
+			FlatBody* body = nullptr;
+			FlatBody::CreateBody(i % 2 == 0 ? box : circle, 1.0f, false, 0.5f, body);
+
+			body->MoveTo(FlatVector(Uniform(rng, -90.0f, 90.0f), Uniform(rng, -20.0f, 25.0f)));
+			world.AddBody(body);
+		}
+
+		const int frames = 120;
+		auto st = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			world.Step(8, 1.0f / 60.0f);
+		}
+		auto ed = std::chrono::steady_clock::now();
+
+		return std::chrono::duration<double, std::milli>(ed - st).count() / frames;
+	}
+
+	constexpr int SOLVER_GRID = 64;
+	constexpr int SOLVER_ROUNDS = 50;
+
+	// A grid of touching boxes on a static floor: every box has contacts with its right
+	// and lower neighbours, the bottom row with the floor. Returns the world checksum.
+	uint64_t SolveGrid(const FlatContactSolver::Path& path, double& seconds, int& constraintCount) {
+		std::mt19937 rng(Benchmark::SEED);
+		FlatWorld world;
+
+		FlatBody* floor = nullptr;
+		FlatBody::CreateBoxBody((float)SOLVER_GRID, 1.0f, 1.0f, true, 0.5f, floor);
+		world.AddBody(floor);
+
+		std::shared_ptr<const FlatShape> box;
+		FlatShape::CreateBox(1.0f, 1.0f, box);
+
+		std::vector<FlatBody*> grid;
+		for (int i = 0; i < SOLVER_GRID * SOLVER_GRID; i++) {
+			FlatBody* body = nullptr;
+			FlatBody::CreateBody(box, 1.0f, false, Uniform(rng, 0.0f, 1.0f), body);
+			world.AddBody(body);
+			grid.push_back(body);
+
+			// one integration step under a random "gravity" gives every box its own velocity
+			FlatVector velocity(Uniform(rng, -5.0f, 5.0f), Uniform(rng, -5.0f, 5.0f));
+			body->Step(velocity, 1, 1.0f);
+		}
+
+		std::vector<FlatContactSolver::Constraint> constraints;
+		auto addContact = [&](FlatBody* a, FlatBody* b, const FlatVector& normal) {
+			FlatVector n = FlatMath::Normalize(normal + FlatVector(Uniform(rng, -0.1f, 0.1f), Uniform(rng, -0.1f, 0.1f)));
+			FlatVector c1(Uniform(rng, -0.5f, 0.5f), Uniform(rng, -0.5f, 0.5f));
+			FlatVector c2(Uniform(rng, -0.5f, 0.5f), Uniform(rng, -0.5f, 0.5f));
+			int count = rng() % 2 + 1;
+
+			FlatManifold manifold(a, b, n, 0.01f, a->GetPosition() + c1, a->GetPosition() + c2, count);
+			constraints.push_back(FlatContactSolver::MakeConstraint(manifold));
+		};
+
+		for (int y = 0; y < SOLVER_GRID; y++) {
+			for (int x = 0; x < SOLVER_GRID; x++) {
+				FlatBody* body = grid[y * SOLVER_GRID + x];
+				if (x + 1 < SOLVER_GRID) addContact(body, grid[y * SOLVER_GRID + x + 1], FlatVector(1.0f, 0.0f));
+				if (y + 1 < SOLVER_GRID) addContact(body, grid[(y + 1) * SOLVER_GRID + x], FlatVector(0.0f, 1.0f));
+				else addContact(body, floor, FlatVector(0.0f, 1.0f));
+			}
+		}
+
+		std::vector<FlatContactSolver::Constraint*> order;
+		for (auto& constraint : constraints) {
+			order.push_back(&constraint);
+		}
+
+		std::vector<int> bodyGroups(world.BodyCount());
+
+		auto st = std::chrono::steady_clock::now();
+		for (int round = 0; round < SOLVER_ROUNDS; round++) {
+			FlatContactSolver::Solve(order.data(), (int)order.size(), path, bodyGroups);
+		}
+		auto ed = std::chrono::steady_clock::now();
+
+		seconds = std::chrono::duration<double>(ed - st).count();
+		constraintCount = (int)constraints.size();
+		return world.Checksum();
+	}
+
+	constexpr int COLLISION_CASES = 1024;
+	constexpr int COLLISION_ROUNDS = 200;
+
+	enum Layout { Separated, Touching, Deep, Rotated, LAYOUT_COUNT };
+	const char* LAYOUT_NAMES[LAYOUT_COUNT] = { "separated", "touching", "deep", "rotated" };
+
+	// Two bodies per case with their geometry copied out, so the intersection routines are timed
+	// without the transform update. normal and depth are Collide's, for FindContactPoints.
+	struct CollisionCase {
+		FlatBody* a;
+		FlatBody* b;
+		FlatVector centerA, centerB;
+		float radiusA, radiusB;
+		std::vector<FlatVector> verticesA, verticesB;
+		FlatVector normal;
+		float depth;
+		bool b_Colliding;
+	};
+
+	struct PointCase {
+		FlatVector p, a, b;
+	};
+
+	// Bodies of 0.5 to 2 m, B placed from A along a random direction:
+	// separated   a gap of 10% to 100% of the bounding radii
+	// touching    axis aligned, overlapping by 1 mm, as bodies resting on each other
+	// deep        centers within a third of the smaller body of each other
+	// rotated     both at random angles, anywhere from deep to just apart
+	CollisionCase MakeCollisionCase(std::mt19937& rng, const FlatBody::ShapeType& typeA, const FlatBody::ShapeType& typeB, const Layout& layout) {
+		auto create = [&](const FlatBody::ShapeType& type, float& extent) {
+			FlatBody* body = nullptr;
+			if (type == FlatBody::Circle) {
+				float radius = Uniform(rng, 0.25f, 1.0f);
+				FlatBody::CreateCircleBody(radius, 1.0f, false, 0.5f, body);
+				extent = radius;
+			}
+			else {
+				float width = Uniform(rng, 0.5f, 2.0f);
+				float height = Uniform(rng, 0.5f, 2.0f);
+				FlatBody::CreateBoxBody(width, height, 1.0f, false, 0.5f, body);
+				extent = 0.5f * std::sqrt(width * width + height * height);
+			}
+			return body;
+		};
+
+		CollisionCase c;
+		float extentA, extentB;
+		c.a = create(typeA, extentA);
+		c.b = create(typeB, extentB);
+
+		float angle = Uniform(rng, 0.0f, 6.2831853f);
+		FlatVector direction(std::cos(angle), std::sin(angle));
+		FlatVector offset;
+
+		if (layout == Separated) {
+			offset = direction * (extentA + extentB) * Uniform(rng, 1.1f, 2.0f);
+		}
+		else if (layout == Touching) {
+			// along x or y, the reach of each body on that axis less the overlap
+			bool b_AlongX = rng() % 2 == 0;
+			auto reach = [&](FlatBody* body) {
+				if (body->shapeType == FlatBody::Circle) return body->shape->radius;
+				return 0.5f * (b_AlongX ? body->shape->width : body->shape->height);
+			};
+
+			float distance = reach(c.a) + reach(c.b) - 0.001f;
+			float side = rng() % 2 == 0 ? 1.0f : -1.0f;
+			float slide = 0.0f;
+
+			// boxes slide along each other; a circle stays over the face it rests on
+			if (typeA == FlatBody::Box && typeB == FlatBody::Box) {
+				slide = Uniform(rng, -0.25f, 0.25f) * (b_AlongX ? c.a->shape->height : c.a->shape->width);
+			}
+
+			offset = b_AlongX ? FlatVector(side * distance, slide) : FlatVector(slide, side * distance);
+		}
+		else if (layout == Deep) {
+			offset = direction * std::min(extentA, extentB) * Uniform(rng, 0.05f, 0.33f);
+		}
+		else {
+			c.a->RotateTo(Uniform(rng, 0.0f, 6.2831853f));
+			c.b->RotateTo(Uniform(rng, 0.0f, 6.2831853f));
+			offset = direction * (extentA + extentB) * Uniform(rng, 0.1f, 1.05f);
+		}
+
+		c.a->MoveTo(FlatVector(Uniform(rng, -50.0f, 50.0f), Uniform(rng, -50.0f, 50.0f)));
+		c.b->MoveTo(c.a->GetPosition() + offset);
+
+		FlatBody::FixtureGeometry a = c.a->GetFixture(0);
+		FlatBody::FixtureGeometry b = c.b->GetFixture(0);
+		c.centerA = a.center;
+		c.centerB = b.center;
+		c.radiusA = a.radius;
+		c.radiusB = b.radius;
+		c.verticesA = *a.vertices;
+		c.verticesB = *b.vertices;
+
+		c.b_Colliding = Collisions::Collide(c.a, 0, c.b, 0, c.normal, c.depth);
+		if (!c.b_Colliding) {
+			c.normal = FlatVector();
+			c.depth = 0.0f;
+		}
+		return c;
+	}
+
+	// A segment of 0.5 to 2 m and a point that projects:
+	// separated   past either end, so the end is closest
+	// touching    onto the segment itself
+	// deep        onto the interior from up to 1 m to the side
+	// rotated     anywhere around a segment at a random angle
+	PointCase MakePointCase(std::mt19937& rng, const Layout& layout) {
+		PointCase c;
+		float length = Uniform(rng, 0.5f, 2.0f);
+		c.a = FlatVector(Uniform(rng, -50.0f, 50.0f), Uniform(rng, -50.0f, 50.0f));
+		c.b = c.a + FlatVector(length, 0.0f);
+
+		if (layout == Separated) {
+			float t = rng() % 2 == 0 ? Uniform(rng, -1.0f, -0.05f) : Uniform(rng, 1.05f, 2.0f);
+			c.p = c.a + FlatVector(t * length, Uniform(rng, -1.0f, 1.0f));
+		}
+		else if (layout == Touching) {
+			c.p = c.a + FlatVector(Uniform(rng, 0.0f, 1.0f) * length, 0.0f);
+		}
+		else if (layout == Deep) {
+			c.p = c.a + FlatVector(Uniform(rng, 0.05f, 0.95f) * length, Uniform(rng, -1.0f, 1.0f));
+		}
+		else {
+			float angle = Uniform(rng, 0.0f, 6.2831853f);
+			FlatVector direction(std::cos(angle), std::sin(angle));
+			c.b = c.a + direction * length;
+			c.p = c.a + FlatVector(Uniform(rng, -1.5f, 1.5f) * length, Uniform(rng, -1.5f, 1.5f) * length);
+		}
+
+		return c;
+	}
+
+	struct CollisionResult {
+		double nanoseconds;
+		double allocations;
+	};
+
+	// Runs op(i) for every case COLLISION_ROUNDS times
+	template<typename T>
+	CollisionResult TimeCollisions(const int& count, T&& op) {
+		float sum = 0.0f;
+
+		AllocationCounter::Start();
+		auto st = std::chrono::steady_clock::now();
+		for (int round = 0; round < COLLISION_ROUNDS; round++) {
+			for (int i = 0; i < count; i++) {
+				sum += op(i);
+			}
+		}
+		auto ed = std::chrono::steady_clock::now();
+		long long allocations = AllocationCounter::Stop();
+
+		sink = sum;
+		double ops = (double)COLLISION_ROUNDS * count;
+		return { std::chrono::duration<double, std::nano>(ed - st).count() / ops, (double)allocations / ops };
+	}
+
+	void PrintCollisions(const char* name, const CollisionResult* results) {
+		std::printf("  %-24s", name);
+		for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+			std::printf(" %9.2f", results[layout].nanoseconds);
+		}
+
+		double allocations = 0.0;
+		for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+			allocations += results[layout].allocations;
+		}
+		std::printf(" %9.2f\n", allocations / (double)LAYOUT_COUNT);
+	}
+}
+
+int Benchmark::RunMath() {
+	std::mt19937 rng(SEED);
+
+	std::vector<float> input(MATH_POINTS * 2);
+	for (auto& value : input) {
+		value = Uniform(rng, -100.0f, 100.0f);
+	}
+
+	double floatTime = MathKernel<float>(input);
+	double doubleTime = MathKernel<double>(input);
+
+	// FlatFixed overflows on squared lengths above ~181, keep its inputs small
+	std::vector<float> smallInput(input);
+	for (auto& value : smallInput) {
+		value *= 0.1f;
+	}
+	double fixedTime = MathKernel<FlatFixed>(smallInput);
+
+	double stepTime = WorldStep(rng);
+
+	std::printf("bench-math: %d points x %d rounds, seed %u\n", MATH_POINTS, MATH_ROUNDS, SEED);
+	std::printf("  float         %.2f ns/op\n", floatTime);
+	std::printf("  double        %.2f ns/op\n", doubleTime);
+	std::printf("  16.16 fixed   %.2f ns/op\n", fixedTime);
+	std::printf("  world step    %.3f ms (1000 bodies, 8 iterations, float)\n", stepTime);
+	return 0;
+}
+
+int Benchmark::RunSolver() {
+	double scalarTime, wideTime;
+	int constraintCount;
+	uint64_t scalarChecksum = SolveGrid(FlatContactSolver::Scalar, scalarTime, constraintCount);
+	uint64_t wideChecksum = SolveGrid(FlatContactSolver::Wide, wideTime, constraintCount);
+
+	double solved = (double)constraintCount * SOLVER_ROUNDS;
+
+	std::printf("bench-solver: %d constraints x %d rounds, seed %u\n", constraintCount, SOLVER_ROUNDS, SEED);
+	std::printf("  scalar        %.2f M contacts/s\n", solved / scalarTime * 1e-6);
+	std::printf("  wide (%d)      %.2f M contacts/s\n", FlatContactSolver::WIDTH, solved / wideTime * 1e-6);
+
+	if (scalarChecksum != wideChecksum) {
+		std::printf("  wide and scalar results DIFFER\n");
+		return 1;
+	}
+
+	std::printf("  wide and scalar results match\n");
+	return 0;
+}
+
+int Benchmark::RunCollisions() {
+	std::mt19937 rng(SEED);
+
+	std::vector<CollisionCase> circles[LAYOUT_COUNT];
+	std::vector<CollisionCase> polygons[LAYOUT_COUNT];
+	std::vector<CollisionCase> circlePolygons[LAYOUT_COUNT];
+	std::vector<PointCase> points[LAYOUT_COUNT];
+
+	for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+		for (int i = 0; i < COLLISION_CASES; i++) {
+			circles[layout].push_back(MakeCollisionCase(rng, FlatBody::Circle, FlatBody::Circle, (Layout)layout));
+			polygons[layout].push_back(MakeCollisionCase(rng, FlatBody::Box, FlatBody::Box, (Layout)layout));
+			circlePolygons[layout].push_back(MakeCollisionCase(rng, FlatBody::Circle, FlatBody::Box, (Layout)layout));
+			points[layout].push_back(MakePointCase(rng, (Layout)layout));
+		}
+	}
+
+	CollisionResult circleResults[LAYOUT_COUNT];
+	CollisionResult polygonResults[LAYOUT_COUNT];
+	CollisionResult circlePolygonResults[LAYOUT_COUNT];
+	CollisionResult polygonContactResults[LAYOUT_COUNT];
+	CollisionResult circlePolygonContactResults[LAYOUT_COUNT];
+	CollisionResult pointResults[LAYOUT_COUNT];
+	int hits[LAYOUT_COUNT][3] = {};
+
+	for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+		std::vector<CollisionCase>& cc = circles[layout];
+		std::vector<CollisionCase>& pp = polygons[layout];
+		std::vector<CollisionCase>& cp = circlePolygons[layout];
+		std::vector<PointCase>& pt = points[layout];
+
+		for (int i = 0; i < COLLISION_CASES; i++) {
+			hits[layout][0] += cc[i].b_Colliding;
+			hits[layout][1] += pp[i].b_Colliding;
+			hits[layout][2] += cp[i].b_Colliding;
+		}
+
+		circleResults[layout] = TimeCollisions(COLLISION_CASES, [&](const int& i) {
+			FlatVector normal;
+			float depth;
+			Collisions::IntersectCircles(cc[i].centerA, cc[i].radiusA, cc[i].centerB, cc[i].radiusB, normal, depth);
+			return depth + normal.x;
+		});
+
+		polygonResults[layout] = TimeCollisions(COLLISION_CASES, [&](const int& i) {
+			FlatVector normal;
+			float depth;
+			Collisions::IntersectPolygons(pp[i].centerA, pp[i].verticesA, pp[i].centerB, pp[i].verticesB, normal, depth);
+			return depth + normal.x;
+		});
+
+		circlePolygonResults[layout] = TimeCollisions(COLLISION_CASES, [&](const int& i) {
+			FlatVector normal;
+			float depth;
+			Collisions::IntersectCirclePolygon(cp[i].centerA, cp[i].radiusA, cp[i].centerB, cp[i].verticesB, normal, depth);
+			return depth + normal.x;
+		});
+
+		// on every case, though the world only asks for contacts of pairs that collide
+		polygonContactResults[layout] = TimeCollisions(COLLISION_CASES, [&](const int& i) {
+			FlatVector contact1, contact2;
+			float separation1, separation2;
+			int contactCount;
+			Collisions::FindContactPoints(pp[i].a, 0, pp[i].b, 0, pp[i].normal, pp[i].depth,
+				contact1, contact2, separation1, separation2, contactCount);
+			return contact1.x + contact2.y + separation1 + (float)contactCount;
+		});
+
+		circlePolygonContactResults[layout] = TimeCollisions(COLLISION_CASES, [&](const int& i) {
+			FlatVector contact1, contact2;
+			float separation1, separation2;
+			int contactCount;
+			Collisions::FindContactPoints(cp[i].a, 0, cp[i].b, 0, cp[i].normal, cp[i].depth,
+				contact1, contact2, separation1, separation2, contactCount);
+			return contact1.x + (float)contactCount;
+		});
+
+		pointResults[layout] = TimeCollisions(COLLISION_CASES, [&](const int& i) {
+			float distanceSquared;
+			FlatVector contact;
+			Collisions::PointSegmentDistance(pt[i].p, pt[i].a, pt[i].b, distanceSquared, contact);
+			return distanceSquared + contact.x;
+		});
+	}
+
+	std::printf("bench-collisions: %d cases x %d rounds per layout, seed %u\n", COLLISION_CASES, COLLISION_ROUNDS, SEED);
+	std::printf("  %-24s", "ns/op");
+	for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+		std::printf(" %9s", LAYOUT_NAMES[layout]);
+	}
+	std::printf(" %9s\n", "allocs/op");
+
+	PrintCollisions("IntersectCircles", circleResults);
+	PrintCollisions("IntersectPolygons", polygonResults);
+	PrintCollisions("IntersectCirclePolygon", circlePolygonResults);
+	PrintCollisions("FindContactPoints box", polygonContactResults);
+	PrintCollisions("FindContactPoints circle", circlePolygonContactResults);
+	PrintCollisions("PointSegmentDistance", pointResults);
+
+	// a layout that stops colliding after a change to its generator would silently time something else
+	const char* pairNames[3] = { "colliding % circles", "colliding % boxes", "colliding % circle-box" };
+	for (int pair = 0; pair < 3; pair++) {
+		std::printf("  %-24s", pairNames[pair]);
+		for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+			std::printf(" %9d", hits[layout][pair] * 100 / COLLISION_CASES);
+		}
+		std::printf("\n");
+	}
+
+	for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+		for (auto* cases : { &circles[layout], &polygons[layout], &circlePolygons[layout] }) {
+			for (auto& c : *cases) {
+				delete c.a;
+				delete c.b;
+			}
+		}
+	}
+
+	return 0;
+}
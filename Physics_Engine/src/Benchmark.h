@@ -0,0 +1,20 @@
+#pragma once
+
+// Microbenchmarks, run with Physics_Engine_Headless --bench-<name>.
+// Inputs come from fixed seeds so numbers are comparable between builds.
+class Benchmark {
+public:
+	static constexpr unsigned int SEED = 12345;
+
+	// FlatVector/FlatTransform/FlatMath kernel for float, double and FlatFixed,
+	// plus a float world step to show the math layer in context.
+	static int RunMath();
+
+	// FlatContactSolver scalar and wide paths on the same constraints, in contacts per second.
+	// Returns 1 if the two paths disagree.
+	static int RunSolver();
+
+	// Each Collisions narrowphase routine on its own, in ns/op and heap allocations/op, over seeded
+	// separated, touching, deeply overlapping and rotated inputs.
+	static int RunCollisions();
+};
@@ -0,0 +1,290 @@
+#include "CollisionDiff.h"
+#include "Collisions.h"
+#include "FlatMath.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <tuple>
+
+namespace {
+
+	constexpr int SCENE_BODY_COUNTS[] = { 250, 500, 1000, 2000 };
+	constexpr int SETTLE_FRAMES = 60;
+
+	float Uniform(std::mt19937& rng, const float& a, const float& b) {
+		return a + (b - a) * (float)(rng() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Bodies of 0.3 to 1.2 m at random angles, packed into a square with room for about twice
+	// their area so many overlap, over a static floor with a few rotated static boxes on it.
+	// A fifth are boxes, a fifth compounds (an L of two boxes and a circle) and the rest circles.
+	// A jagged chain crosses the square, its joints alternately convex and concave, and a chain
+	// loop sits in it, so bodies start on both sides of their one-sided segments.
+	void BuildScene(FlatWorld& world, std::mt19937& rng, const int& bodyCount) {
+		float side = std::sqrt((float)bodyCount) * 1.3f;
+
+		FlatBody* floor = nullptr;
+		FlatBody::CreateBoxBody(side + 10.0f, 1.0f, 1.0f, true, 0.5f, floor);
+		floor->MoveTo(FlatVector(0.0f, side * 0.5f + 1.0f));
+		world.AddBody(floor);
+
+		for (int i = 0; i < 4; i++) {
+			FlatBody* ledge = nullptr;
+			FlatBody::CreateBoxBody(Uniform(rng, 2.0f, 6.0f), 0.5f, 1.0f, true, 0.5f, ledge);
+			ledge->MoveTo(FlatVector(Uniform(rng, -0.5f, 0.5f) * side, Uniform(rng, -0.5f, 0.5f) * side));
+			ledge->RotateTo(Uniform(rng, -0.5f, 0.5f));
+			world.AddBody(ledge);
+		}
+
+		std::vector<FlatVector> points;
+		for (float x = -0.6f * side; x <= 0.6f * side; x += 1.5f) {
+			float height = Uniform(rng, 0.2f, 1.0f);
+			points.emplace_back(x, points.size() % 2 == 0 ? height : -height);
+		}
+
+		FlatBody* chain = nullptr;
+		FlatBody::CreateChainBody(points, false, 0.5f, chain);
+		world.AddBody(chain);
+
+		// clockwise on screen, so its normals face out; the notch in its bottom side is a concave joint
+		FlatVector center(Uniform(rng, -0.3f, 0.3f) * side, Uniform(rng, -0.3f, 0.3f) * side);
+		float radius = Uniform(rng, 1.0f, 2.0f);
+		std::vector<FlatVector> loop = {
+			center + FlatVector(-radius, -radius), center + FlatVector(radius, -radius),
+			center + FlatVector(radius, radius), center + FlatVector(0.0f, radius * 0.3f), center + FlatVector(-radius, radius)
+		};
+
+		FlatBody* ring = nullptr;
+		FlatBody::CreateChainBody(loop, true, 0.5f, ring);
+		world.AddBody(ring);
+
+		for (int i = 0; i < bodyCount; i++) {
+			FlatBody* body = nullptr;
+			int kind = rng() % 5;
+
+			if (kind == 0) {
+				FlatBody::CreateBoxBody(Uniform(rng, 0.3f, 1.2f), Uniform(rng, 0.3f, 1.2f), 1.0f, false, 0.5f, body);
+			}
+			else if (kind == 1) {
+				std::shared_ptr<const FlatShape> arm, leg, knob, compound;
+				float size = Uniform(rng, 0.3f, 0.6f);
+				FlatShape::CreateBox(size * 2.0f, size * 0.5f, arm);
+				FlatShape::CreateBox(size * 0.5f, size * 1.5f, leg);
+				FlatShape::CreateCircle(size * 0.4f, knob);
+
+				std::vector<FlatShape::Fixture> fixtures(3);
+				fixtures[0].shape = arm;
+				fixtures[1].shape = leg;
+				fixtures[1].offset = FlatVector(-size * 0.75f, size);
+				fixtures[2].shape = knob;
+				fixtures[2].offset = FlatVector(size * 1.2f, 0.0f);
+
+				FlatShape::CreateCompound(fixtures, compound);
+				FlatBody::CreateBody(compound, 1.0f, false, 0.5f, body);
+			}
+			else {
+				FlatBody::CreateCircleBody(Uniform(rng, 0.15f, 0.6f), 1.0f, false, 0.5f, body);
+			}
+
+			body->MoveTo(FlatVector(Uniform(rng, -0.5f, 0.5f) * side, Uniform(rng, -0.5f, 0.5f) * side));
+			body->RotateTo(Uniform(rng, 0.0f, 6.2831853f));
+			world.AddBody(body);
+		}
+	}
+
+	std::tuple<int, int, int, int> Key(FlatWorld& world, const FlatWorld::CollisionRecord& record) {
+		int a, b;
+		world.GetBodyIndex(record.bodyA, a);
+		world.GetBodyIndex(record.bodyB, b);
+		return std::make_tuple(a, b, record.fixtureA, record.fixtureB);
+	}
+}
+
+void CollisionDiff::Compare(FlatWorld& world, Report& report) {
+	std::vector<FlatWorld::CollisionRecord> reference;
+	std::vector<FlatWorld::CollisionRecord> records;
+
+	auto st = std::chrono::high_resolution_clock::now();
+	FindReferencePairs(world, reference);
+	auto md = std::chrono::high_resolution_clock::now();
+	CollideReference(reference);
+	auto ed = std::chrono::high_resolution_clock::now();
+
+	world.DetectCollisions(records);
+	const FlatWorld::StepStats& stats = world.GetStepStats();
+
+	report.referenceBroadPhaseTime += std::chrono::duration<double, std::milli>(md - st).count();
+	report.referenceNarrowPhaseTime += std::chrono::duration<double, std::milli>(ed - md).count();
+	report.broadPhaseTime += stats.broadPhaseTime;
+	report.narrowPhaseTime += stats.narrowPhaseTime;
+	report.pairCount += reference.size();
+
+	for (auto& record : reference) {
+		if (record.b_Colliding) report.collidingCount++;
+		if (record.bodyA->shapeType == FlatBody::Chain || record.bodyB->shapeType == FlatBody::Chain) report.segmentPairCount++;
+	}
+
+	// both lists are in (body, body, fixture, fixture) order, merge them
+	size_t i = 0;
+	size_t j = 0;
+	while (i < reference.size() || j < records.size()) {
+		bool b_Reference = j == records.size() ||
+			(i < reference.size() && Key(world, reference[i]) < Key(world, records[j]));
+		bool b_World = i == reference.size() ||
+			(j < records.size() && Key(world, records[j]) < Key(world, reference[i]));
+
+		if (b_Reference || b_World) {
+			const FlatWorld::CollisionRecord& only = b_Reference ? reference[i++] : records[j++];
+
+			if (only.b_Colliding && only.depth > DEPTH_TOLERANCE) report.pairDifferences++;
+			else if (b_Reference) report.missingPairs++;
+			else report.extraPairs++;
+			continue;
+		}
+
+		if (!SameResult(reference[i], records[j])) report.resultDifferences++;
+		i++;
+		j++;
+	}
+
+	report.sceneCount++;
+}
+
+int CollisionDiff::Run() {
+	Report total;
+	std::printf("diff-collisions: seed %u, depth %g m, normal %g, contacts %g m\n",
+		SEED, DEPTH_TOLERANCE, NORMAL_TOLERANCE, CONTACT_TOLERANCE);
+
+	int scene = 0;
+	for (const int& bodyCount : SCENE_BODY_COUNTS) {
+		std::mt19937 rng(SEED + scene++);
+		FlatWorld world;
+		BuildScene(world, rng, bodyCount);
+
+		// as placed, with deep overlaps, then settled into resting contacts
+		for (int pass = 0; pass < 2; pass++) {
+			if (pass == 1) {
+				for (int frame = 0; frame < SETTLE_FRAMES; frame++) {
+					world.Step(8, 1.0f / 60.0f);
+				}
+			}
+
+			Report report;
+			Compare(world, report);
+
+			std::printf("  %4d bodies %-7s %6zu pairs %6zu colliding  broad %7.2f / %6.2f ms  narrow %7.2f / %6.2f ms  %zu differences\n",
+				bodyCount, pass == 0 ? "placed" : "settled", report.pairCount, report.collidingCount,
+				report.referenceBroadPhaseTime, report.broadPhaseTime,
+				report.referenceNarrowPhaseTime, report.narrowPhaseTime,
+				report.pairDifferences + report.resultDifferences);
+
+			total.sceneCount += report.sceneCount;
+			total.pairCount += report.pairCount;
+			total.collidingCount += report.collidingCount;
+			total.segmentPairCount += report.segmentPairCount;
+			total.extraPairs += report.extraPairs;
+			total.missingPairs += report.missingPairs;
+			total.pairDifferences += report.pairDifferences;
+			total.resultDifferences += report.resultDifferences;
+			total.referenceBroadPhaseTime += report.referenceBroadPhaseTime;
+			total.referenceNarrowPhaseTime += report.referenceNarrowPhaseTime;
+			total.broadPhaseTime += report.broadPhaseTime;
+			total.narrowPhaseTime += report.narrowPhaseTime;
+		}
+	}
+
+	std::printf("  %d scenes, %zu pairs, %zu colliding, %zu against chain segments; %zu extra and %zu missing pairs that don't collide\n",
+		total.sceneCount, total.pairCount, total.collidingCount, total.segmentPairCount, total.extraPairs, total.missingPairs);
+	std::printf("  speedup over the reference: broadphase %.1fx, narrowphase %.1fx (%d threads)\n",
+		total.referenceBroadPhaseTime / total.broadPhaseTime, total.referenceNarrowPhaseTime / total.narrowPhaseTime,
+		FlatThreadPool::HardwareThreadCount());
+
+	if (total.pairDifferences + total.resultDifferences > 0) {
+		std::printf("  DIFFER: %zu colliding pairs found by one side only, %zu results out of tolerance\n",
+			total.pairDifferences, total.resultDifferences);
+		return 1;
+	}
+
+	std::printf("  world and reference match\n");
+	return 0;
+}
+
+void CollisionDiff::FindReferencePairs(FlatWorld& world, std::vector<FlatWorld::CollisionRecord>& records) {
+	records.clear();
+
+	std::vector<FlatBody*> bodies;
+	FlatBody* body = nullptr;
+	for (int i = 0; world.GetBody(i, body); i++) {
+		bodies.push_back(body);
+	}
+
+	for (int a = 0; a < bodies.size(); a++) {
+		for (int b = a + 1; b < bodies.size(); b++) {
+			FlatBody* bodyA = bodies[a];
+			FlatBody* bodyB = bodies[b];
+
+			if (bodyA->b_IsStatic && bodyB->b_IsStatic) continue;
+			if (!Collisions::IntersectAABB(bodyA->GetAABB(), bodyB->GetAABB())) continue;
+
+			bool b_Compound = bodyA->shapeType == FlatBody::Compound || bodyB->shapeType == FlatBody::Compound ||
+				bodyA->shapeType == FlatBody::Chain || bodyB->shapeType == FlatBody::Chain;
+
+			for (int fixtureA = 0; fixtureA < bodyA->FixtureCount(); fixtureA++) {
+				for (int fixtureB = 0; fixtureB < bodyB->FixtureCount(); fixtureB++) {
+					if (b_Compound && !Collisions::IntersectAABB(bodyA->GetFixtureAABB(fixtureA), bodyB->GetFixtureAABB(fixtureB))) {
+						continue;
+					}
+
+					FlatWorld::CollisionRecord record;
+					record.bodyA = bodyA;
+					record.bodyB = bodyB;
+					record.fixtureA = fixtureA;
+					record.fixtureB = fixtureB;
+					records.push_back(record);
+				}
+			}
+		}
+	}
+}
+
+void CollisionDiff::CollideReference(std::vector<FlatWorld::CollisionRecord>& records) {
+	for (auto& record : records) {
+		record.b_Colliding = Collisions::Collide(record.bodyA, record.fixtureA, record.bodyB, record.fixtureB,
+			record.normal, record.depth);
+
+		if (!record.b_Colliding) {
+			record.normal = FlatVector();
+			record.depth = 0.0f;
+			continue;
+		}
+
+		float separation1, separation2;
+		Collisions::FindContactPoints(record.bodyA, record.fixtureA, record.bodyB, record.fixtureB,
+			record.normal, record.depth, record.contacts[0], record.contacts[1], separation1, separation2, record.contactCount);
+	}
+}
+
+bool CollisionDiff::SameResult(const FlatWorld::CollisionRecord& a, const FlatWorld::CollisionRecord& b) {
+	// one side may call a grazing pair colliding
+	if (a.b_Colliding != b.b_Colliding) {
+		return (a.b_Colliding ? a.depth : b.depth) <= DEPTH_TOLERANCE;
+	}
+
+	if (!a.b_Colliding) return true;
+
+	if (std::abs(a.depth - b.depth) > DEPTH_TOLERANCE * (1.0f + std::abs(a.depth))) return false;
+	if (1.0f - FlatMath::Dot(a.normal, b.normal) > NORMAL_TOLERANCE) return false;
+	if (a.contactCount != b.contactCount) return false;
+
+	// contact points in either order
+	auto near = [](const FlatVector& p, const FlatVector& q) {
+		return FlatMath::DistanceSquared(p, q) <= CONTACT_TOLERANCE * CONTACT_TOLERANCE;
+	};
+
+	if (a.contactCount == 1) return near(a.contacts[0], b.contacts[0]);
+
+	return (near(a.contacts[0], b.contacts[0]) && near(a.contacts[1], b.contacts[1])) ||
+		(near(a.contacts[0], b.contacts[1]) && near(a.contacts[1], b.contacts[0]));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "FlatWorld.h"
+#include <vector>
+
+// Differential check of the world's collision detection, run by the build's tests as
+// Physics_Engine_Headless --diff-collisions. Seeded scenes of circles, boxes, compounds and
+// chains go through FlatWorld::DetectCollisions and through a reference kept deliberately
+// simple: every pair of bodies (and of their fixtures) tested AABB against AABB, then the
+// scalar Collisions routines on each. Pair sets, normals, depths and contact points are
+// compared within tolerances, and both are timed.
+//
+// A pair only one side reports is a difference when it collides deeper than DEPTH_TOLERANCE;
+// broadphases may disagree on pairs whose AABBs just touch.
+class CollisionDiff {
+public:
+	static constexpr unsigned int SEED = 12345;
+
+	static constexpr float DEPTH_TOLERANCE = 1e-4f;   // m, also relative to the depth
+	static constexpr float NORMAL_TOLERANCE = 1e-4f;  // 1 - dot of the two normals
+	static constexpr float CONTACT_TOLERANCE = 1e-3f; // m
+
+	struct Report {
+		int sceneCount = 0;
+		size_t pairCount = 0;         // reference fixture pairs, summed over scenes
+		size_t collidingCount = 0;
+		size_t segmentPairCount = 0;  // reference pairs of a body and a chain segment
+		size_t extraPairs = 0;        // reported by the world only, none of them colliding
+		size_t missingPairs = 0;      // reported by the reference only, none of them colliding
+		size_t pairDifferences = 0;   // colliding pairs only one side reports
+		size_t resultDifferences = 0; // colliding, normal, depth or contacts out of tolerance
+		double referenceBroadPhaseTime = 0.0; // ms
+		double referenceNarrowPhaseTime = 0.0;
+		double broadPhaseTime = 0.0;
+		double narrowPhaseTime = 0.0;
+	};
+
+	// Compares one world as it is; the world is not stepped
+	static void Compare(FlatWorld& world, Report& report);
+
+	// Runs the seeded scenes, prints the report and returns 1 on any difference
+	static int Run();
+
+private:
+	static void FindReferencePairs(FlatWorld& world, std::vector<FlatWorld::CollisionRecord>& records);
+	static void CollideReference(std::vector<FlatWorld::CollisionRecord>& records);
+	static bool SameResult(const FlatWorld::CollisionRecord& a, const FlatWorld::CollisionRecord& b);
+};
@@ -1,6 +1,8 @@
 #include "Collisions.h"
 #include "FlatMath.h"
 
+#include <cfloat>
+
 void Collisions::ProjectVertices(const std::vector<FlatVector>& vertices, const FlatVector& axis, float& _min, float& _max) {
 	_min = FLT_MAX;
 	_max = -FLT_MAX;
@@ -67,61 +69,120 @@ bool Collisions::IntersectCircles(
 	return true;
 }
 
+bool Collisions::OverlapOnAxis(const std::vector<FlatVector>& verticesA, const std::vector<FlatVector>& verticesB,
+	const int& index, FlatVector& axis, float& depth)
+{
+	bool b_EdgeOfA = index < verticesA.size();
+	const std::vector<FlatVector>& vertices = b_EdgeOfA ? verticesA : verticesB;
+	int i = b_EdgeOfA ? index : index - (int)verticesA.size();
+
+	const FlatVector& va = vertices[i];
+	const FlatVector& vb = vertices[(i + 1) % vertices.size()];
+
+	FlatVector edge = vb - va;
+	axis = FlatVector(-edge.y, edge.x);
+	axis = FlatMath::Normalize(axis);
+
+	float minA, maxA, minB, maxB;
+
+	ProjectVertices(verticesA, axis, minA, maxA);
+	ProjectVertices(verticesB, axis, minB, maxB);
+
+	if (minA >= maxB || minB >= maxA) {
+		return false;
+	}
+
+	depth = std::min(maxB - minA, maxA - minB);
+	return true;
+}
+
 bool Collisions::IntersectPolygons(
 	const FlatVector& centerA, const std::vector<FlatVector>& verticesA,
 	const FlatVector& centerB, const std::vector<FlatVector>& verticesB, 
 	FlatVector& normal, float& depth)
+{
+	int axis = -1;
+	return IntersectPolygons(centerA, verticesA, centerB, verticesB, normal, depth, axis);
+}
+
+bool Collisions::IntersectPolygons(
+	const FlatVector& centerA, const std::vector<FlatVector>& verticesA,
+	const FlatVector& centerB, const std::vector<FlatVector>& verticesB,
+	FlatVector& normal, float& depth, int& axis)
 {
 	normal = FlatVector();
 	depth = FLT_MAX;
 
+	int axisCount = (int)(verticesA.size() + verticesB.size());
+	int cached = axis >= 0 && axis < axisCount ? axis : -1;
+	int best = cached;
+
+	// the cached axis first: if it still separates the polygons, nothing else needs projecting
+	if (cached >= 0 && !OverlapOnAxis(verticesA, verticesB, cached, normal, depth)) {
+		normal = FlatVector();
+		return false;
+	}
+
+	// an axis before the cached one wins a tie with it, as when every axis is tested in order
 	for (int i = 0; i < verticesA.size(); i++) {
+		if (i == cached) continue;
+
 		const FlatVector& va = verticesA[i];
 		const FlatVector& vb = verticesA[(i + 1) % verticesA.size()];
 
 		FlatVector edge = vb - va;
-		FlatVector axis = FlatVector(-edge.y, edge.x);
-		axis = FlatMath::Normalize(axis);
+		FlatVector edgeAxis = FlatVector(-edge.y, edge.x);
+		edgeAxis = FlatMath::Normalize(edgeAxis);
 
 		float minA, maxA, minB, maxB;
 
-		ProjectVertices(verticesA, axis, minA, maxA);
-		ProjectVertices(verticesB, axis, minB, maxB);
+		ProjectVertices(verticesA, edgeAxis, minA, maxA);
+		ProjectVertices(verticesB, edgeAxis, minB, maxB);
 
 		if (minA >= maxB || minB >= maxA) {
+			axis = i;
 			return false;
 		}
+
 		float axisDepth = std::min(maxB - minA, maxA - minB);
-		if (axisDepth < depth) {
+		if (axisDepth < depth || (i < cached && best == cached && axisDepth == depth)) {
 			depth = axisDepth;
-			normal = axis;
+			normal = edgeAxis;
+			best = i;
 		}
 	}
 
+	int countA = (int)verticesA.size();
 	for (int i = 0; i < verticesB.size(); i++) {
+		if (countA + i == cached) continue;
+
 		const FlatVector& va = verticesB[i];
 		const FlatVector& vb = verticesB[(i + 1) % verticesB.size()];
 
 		FlatVector edge = vb - va;
-		FlatVector axis = FlatVector(-edge.y, edge.x);
-		axis = FlatMath::Normalize(axis);
+		FlatVector edgeAxis = FlatVector(-edge.y, edge.x);
+		edgeAxis = FlatMath::Normalize(edgeAxis);
 
 		float minA, maxA, minB, maxB;
 
-		ProjectVertices(verticesA, axis, minA, maxA);
-		ProjectVertices(verticesB, axis, minB, maxB);
+		ProjectVertices(verticesA, edgeAxis, minA, maxA);
+		ProjectVertices(verticesB, edgeAxis, minB, maxB);
 
 		if (minA >= maxB || minB >= maxA) {
+			axis = countA + i;
 			return false;
 		}
 
 		float axisDepth = std::min(maxB - minA, maxA - minB);
-		if (axisDepth < depth) {
+		if (axisDepth < depth || (countA + i < cached && best == cached && axisDepth == depth)) {
 			depth = axisDepth;
-			normal = axis;
+			normal = edgeAxis;
+			best = countA + i;
 		}
 	}
 
+	axis = best;
+
 	FlatVector direction = centerB - centerA;
 
 	if (FlatMath::Dot(direction, normal) < 0.0f) {
@@ -189,30 +250,191 @@ bool Collisions::IntersectCirclePolygon(const FlatVector& circleCenter, const fl
 	return true;
 }
 
-void Collisions::FindContactPoints(FlatBody*& bodyA, FlatBody*& bodyB, FlatVector& contact1, FlatVector& contact2, int& contactCount) {
-	FlatBody::ShapeType shapeTypeA = bodyA->shapeType;
-	FlatBody::ShapeType shapeTypeB = bodyB->shapeType;
+FlatVector Collisions::SegmentNormal(const FlatVector& start, const FlatVector& end) {
+	FlatVector edge = end - start;
+	return FlatMath::Normalize(FlatVector(edge.y, -edge.x));
+}
+
+bool Collisions::IntersectCircleSegment(const FlatVector& circleCenter, const float& circleRadius,
+	const FlatVector& ghost1, const FlatVector& start, const FlatVector& end, const FlatVector& ghost2,
+	FlatVector& normal, float& depth)
+{
+	normal = FlatVector();
+	depth = 0.0f;
+
+	FlatVector edge = end - start;
+	FlatVector segmentNormal = SegmentNormal(start, end);
+
+	if (FlatMath::Dot(circleCenter - start, segmentNormal) < 0.0f) {
+		return false;
+	}
+
+	// closest feature by where the center projects onto the edge
+	FlatVector closest;
+	if (FlatMath::Dot(edge, circleCenter - start) <= 0.0f) {
+		// past the start, the previous segment owns the circle if it projects onto it
+		if (FlatMath::Dot(start - ghost1, start - circleCenter) > 0.0f) return false;
+		closest = start;
+	}
+	else if (FlatMath::Dot(edge, end - circleCenter) <= 0.0f) {
+		if (FlatMath::Dot(ghost2 - end, circleCenter - end) > 0.0f) return false;
+		closest = end;
+	}
+	else {
+		float distance = FlatMath::Dot(circleCenter - start, segmentNormal);
+		if (distance >= circleRadius) return false;
+
+		normal = segmentNormal;
+		depth = circleRadius - distance;
+		return true;
+	}
+
+	FlatVector direction = circleCenter - closest;
+	float distanceSquared = FlatMath::LengthSquared(direction);
+	if (distanceSquared >= circleRadius * circleRadius) return false;
+
+	float distance = std::sqrt(distanceSquared);
+	normal = distance > 0.0f ? direction / distance : segmentNormal;
+	depth = circleRadius - distance;
+	return true;
+}
+
+bool Collisions::IntersectPolygonSegment(const FlatVector& polygonCenter, const std::vector<FlatVector>& vertices,
+	const FlatVector& ghost1, const FlatVector& start, const FlatVector& end, const FlatVector& ghost2,
+	FlatVector& normal, float& depth)
+{
+	normal = FlatVector();
+	depth = FLT_MAX;
+
+	FlatVector edge = end - start;
+	FlatVector segmentNormal = SegmentNormal(start, end);
+
+	if (FlatMath::Dot(polygonCenter - start, segmentNormal) < 0.0f) {
+		return false;
+	}
+
+	// the segment's own axis only pushes towards its front
+	float segmentDepth = -FLT_MAX;
+	for (auto& v : vertices) {
+		segmentDepth = std::max(segmentDepth, -FlatMath::Dot(v - start, segmentNormal));
+	}
+
+	if (segmentDepth <= 0.0f) {
+		return false;
+	}
+
+	// the polygon's edges, each normal turned to point from the segment into the polygon
+	float polygonDepth = FLT_MAX;
+	FlatVector polygonNormal;
+
+	for (int i = 0; i < vertices.size(); i++) {
+		const FlatVector& va = vertices[i];
+		const FlatVector& vb = vertices[(i + 1) % vertices.size()];
+
+		FlatVector axis = SegmentNormal(va, vb);
+		if (FlatMath::Dot(axis, va - polygonCenter) < 0.0f) {
+			axis = -axis;
+		}
+
+		float separation = std::min(FlatMath::Dot(start - va, axis), FlatMath::Dot(end - va, axis));
+		if (separation >= 0.0f) {
+			return false;
+		}
+
+		if (-separation < polygonDepth) {
+			polygonDepth = -separation;
+			polygonNormal = -axis;
+		}
+	}
+
+	normal = segmentNormal;
+	depth = segmentDepth;
+
+	if (polygonDepth >= segmentDepth - SEGMENT_AXIS_TOLERANCE) {
+		return true;
+	}
+
+	// A polygon axis may only lean as far as the neighbouring segment's normal at a convex joint;
+	// past that the neighbour owns the contact. At a concave joint it snaps back to this normal.
+	FlatVector edge0 = start - ghost1;
+	FlatVector edge2 = ghost2 - end;
+
+	if (FlatMath::Dot(polygonNormal, edge) <= 0.0f) {
+		if (FlatMath::Cross(edge0, edge) < 0.0f) return true;
+		if (FlatMath::Cross(polygonNormal, SegmentNormal(ghost1, start)) > SEGMENT_SIN_TOLERANCE) return false;
+	}
+	else {
+		if (FlatMath::Cross(edge, edge2) < 0.0f) return true;
+		if (FlatMath::Cross(SegmentNormal(end, ghost2), polygonNormal) > SEGMENT_SIN_TOLERANCE) return false;
+	}
+
+	normal = polygonNormal;
+	depth = polygonDepth;
+	return true;
+}
+
+void Collisions::FindContactPoints(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB,
+	FlatVector& contact1, FlatVector& contact2, int& contactCount)
+{
+	float separation1, separation2;
+	FindContactPoints(bodyA, fixtureA, bodyB, fixtureB, FlatVector(), 0.0f, contact1, contact2, separation1, separation2, contactCount);
+}
+
+void Collisions::FindContactPoints(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB,
+	const FlatVector& normal, const float& depth,
+	FlatVector& contact1, FlatVector& contact2, float& separation1, float& separation2, int& contactCount)
+{
+	FlatBody::FixtureGeometry a = bodyA->GetFixture(fixtureA);
+	FlatBody::FixtureGeometry b = bodyB->GetFixture(fixtureB);
 	
 	contact1 = FlatVector();
 	contact2 = FlatVector();
+	separation1 = -depth;
+	separation2 = -depth;
 	contactCount = 0;
 
-	if (shapeTypeA == FlatBody::ShapeType::Box) {
-		if (shapeTypeB == FlatBody::ShapeType::Box) {
-			FindPolygonContactPoint(bodyA->GetTransformVertices(), bodyB->GetTransformVertices(), contact1, contact2, contactCount);
+	if (a.type == FlatBody::ShapeType::Segment || b.type == FlatBody::ShapeType::Segment) {
+		// worked out from the segment, the separations read the same either way round
+		bool b_SegmentFirst = a.type == FlatBody::ShapeType::Segment;
+		const FlatBody::FixtureGeometry& segment = b_SegmentFirst ? a : b;
+		const FlatBody::FixtureGeometry& other = b_SegmentFirst ? b : a;
+
+		if (other.type == FlatBody::ShapeType::Circle) {
+			float distanceSquared;
+			PointSegmentDistance(other.center, segment.points[1], segment.points[2], distanceSquared, contact1);
+			contactCount = 1;
+		}
+		else if (other.type == FlatBody::ShapeType::Box) {
+			FlatVector segmentNormal = b_SegmentFirst ? normal : -normal;
+			float segmentDepth;
+			if (FlatMath::LengthSquared(segmentNormal) == 0.0f) {
+				IntersectPolygonSegment(other.center, *other.vertices,
+					segment.points[0], segment.points[1], segment.points[2], segment.points[3], segmentNormal, segmentDepth);
+			}
+
+			FindPolygonSegmentContactPoints(*other.vertices, segment.points[1], segment.points[2], segmentNormal,
+				contact1, contact2, separation1, separation2, contactCount);
+		}
+		return;
+	}
+
+	if (a.type == FlatBody::ShapeType::Box) {
+		if (b.type == FlatBody::ShapeType::Box) {
+			FindPolygonContactPoint(*a.vertices, *b.vertices, normal,
+				contact1, contact2, separation1, separation2, contactCount);
 		}
-		else if (shapeTypeB == FlatBody::ShapeType::Circle) {
-			FindCirclePolygonContactPoint(bodyB->GetPosition(), bodyB->radius, bodyA->GetPosition(), bodyA->GetTransformVertices(), contact1);
+		else if (b.type == FlatBody::ShapeType::Circle) {
+			FindCirclePolygonContactPoint(b.center, b.radius, a.center, *a.vertices, contact1);
 			contactCount = 1;
 		}
 	}
-	else if (shapeTypeA == FlatBody::ShapeType::Circle) {
-		if (shapeTypeB == FlatBody::ShapeType::Box) {
-			FindCirclePolygonContactPoint(bodyA->GetPosition(), bodyA->radius, bodyB->GetPosition(), bodyB->GetTransformVertices(), contact1);
+	else if (a.type == FlatBody::ShapeType::Circle) {
+		if (b.type == FlatBody::ShapeType::Box) {
+			FindCirclePolygonContactPoint(a.center, a.radius, b.center, *b.vertices, contact1);
 			contactCount = 1;
 		}
-		else if (shapeTypeB == FlatBody::ShapeType::Circle) {
-			FindCircleContactPoint(bodyA->GetPosition(), bodyA->radius, bodyB->GetPosition(), contact1);
+		else if (b.type == FlatBody::ShapeType::Circle) {
+			FindCircleContactPoint(a.center, a.radius, b.center, contact1);
 			contactCount = 1;
 		}
 	}
@@ -226,13 +448,14 @@ void Collisions::FindCircleContactPoint(const FlatVector& centerA, const float&
 	contact = centerA + direction * radiusA;
 }
 
-void Collisions::FindPolygonContactPoint(const std::vector<FlatVector> verticesA, const std::vector<FlatVector> verticesB,
-	FlatVector& contact1, FlatVector& contact2, int& contactCount)
+void Collisions::FindPolygonContactPoint(const std::vector<FlatVector>& verticesA, const std::vector<FlatVector>& verticesB,
+	const FlatVector& normal, FlatVector& contact1, FlatVector& contact2, float& separation1, float& separation2, int& contactCount)
 {
 	float distanceSquared;
 	FlatVector cp;
 	float minDisSq = FLT_MAX;
 
+	// separations run from the point on A to the point on B along the normal
 	for (auto& p : verticesA) {
 		for (int i = 0; i < verticesB.size(); i++) {
 			const FlatVector& va = verticesB[i];
@@ -243,12 +466,14 @@ void Collisions::FindPolygonContactPoint(const std::vector<FlatVector> verticesA
 			if (FlatMath::NearlyEqual(distanceSquared, minDisSq)) {
 				if (!FlatMath::NearlyEqual(cp, contact1)) {
 					contact2 = cp;
+					separation2 = FlatMath::Dot(cp - p, normal);
 					contactCount = 2;
 				}
 			}
 			else if (distanceSquared < minDisSq) {
 				minDisSq = distanceSquared;
 				contact1 = cp;
+				separation1 = FlatMath::Dot(cp - p, normal);
 				contactCount = 1;
 			}
 		}
@@ -264,12 +489,14 @@ void Collisions::FindPolygonContactPoint(const std::vector<FlatVector> verticesA
 			if (FlatMath::NearlyEqual(distanceSquared, minDisSq)) {
 				if (!FlatMath::NearlyEqual(cp, contact1)) {
 					contact2 = cp;
+					separation2 = FlatMath::Dot(p - cp, normal);
 					contactCount = 2;
 				}
 			}
 			else if (distanceSquared < minDisSq) {
 				minDisSq = distanceSquared;
 				contact1 = cp;
+				separation1 = FlatMath::Dot(p - cp, normal);
 				contactCount = 1;
 			}
 		}
@@ -319,36 +546,374 @@ void Collisions::FindCirclePolygonContactPoint(const FlatVector& centerA, const
 	}
 }
 
-bool Collisions::Collide(FlatBody*& bodyA, FlatBody*& bodyB, FlatVector& normal, float& depth) {
+void Collisions::FindPolygonSegmentContactPoints(const std::vector<FlatVector>& vertices, const FlatVector& start, const FlatVector& end,
+	const FlatVector& normal, FlatVector& contact1, FlatVector& contact2, float& separation1, float& separation2, int& contactCount)
+{
+	contactCount = 0;
+
+	FlatVector segmentNormal = SegmentNormal(start, end);
+	FlatVector n = FlatMath::LengthSquared(normal) > 0.0f ? normal : segmentNormal;
+
+	FlatVector centroid;
+	for (auto& v : vertices) {
+		centroid += v;
+	}
+	centroid = centroid / (float)vertices.size();
+
+	// the polygon's face most against the normal, and the one most along it
+	int incident = 0;
+	int reference = 0;
+	float minAlignment = FLT_MAX;
+	float maxAlignment = -FLT_MAX;
+
+	for (int i = 0; i < vertices.size(); i++) {
+		const FlatVector& va = vertices[i];
+		FlatVector axis = SegmentNormal(va, vertices[(i + 1) % vertices.size()]);
+		if (FlatMath::Dot(axis, va - centroid) < 0.0f) {
+			axis = -axis;
+		}
+
+		float alignment = FlatMath::Dot(axis, n);
+		if (alignment < minAlignment) {
+			minAlignment = alignment;
+			incident = i;
+		}
+		if (-alignment > maxAlignment) {
+			maxAlignment = -alignment;
+			reference = i;
+		}
+	}
+
+	// the reference edge is the segment unless a polygon face lies closer across the normal
+	bool b_SegmentReference = FlatMath::Dot(segmentNormal, n) >= maxAlignment;
+	FlatVector referenceStart = b_SegmentReference ? start : vertices[reference];
+	FlatVector referenceEnd = b_SegmentReference ? end : vertices[(reference + 1) % vertices.size()];
+
+	FlatVector points[2];
+	points[0] = b_SegmentReference ? vertices[incident] : start;
+	points[1] = b_SegmentReference ? vertices[(incident + 1) % vertices.size()] : end;
+
+	// keep the incident edge between the reference edge's ends
+	auto clip = [&points](const FlatVector& direction, const float& offset) {
+		float d0 = FlatMath::Dot(points[0], direction) - offset;
+		float d1 = FlatMath::Dot(points[1], direction) - offset;
+
+		if (d0 < 0.0f && d1 < 0.0f) return false;
+		if (d0 < 0.0f) points[0] = points[0] + (points[1] - points[0]) * (d0 / (d0 - d1));
+		else if (d1 < 0.0f) points[1] = points[1] + (points[0] - points[1]) * (d1 / (d1 - d0));
+		return true;
+	};
+
+	FlatVector tangent = FlatMath::Normalize(referenceEnd - referenceStart);
+	if (!clip(tangent, FlatMath::Dot(referenceStart, tangent)) || !clip(-tangent, -FlatMath::Dot(referenceEnd, tangent))) {
+		return;
+	}
+
+	// contact points lie on the segment, separations run from it to the polygon
+	FlatVector contacts[2];
+	float separations[2];
+	for (int i = 0; i < 2; i++) {
+		if (b_SegmentReference) {
+			separations[i] = FlatMath::Dot(points[i] - referenceStart, n);
+			contacts[i] = points[i] - n * separations[i];
+		}
+		else {
+			separations[i] = FlatMath::Dot(referenceStart - points[i], n);
+			contacts[i] = points[i];
+		}
+	}
+
+	bool b_Keep[2] = { separations[0] <= SEGMENT_CONTACT_DISTANCE, separations[1] <= SEGMENT_CONTACT_DISTANCE };
+	if (!b_Keep[0] && !b_Keep[1]) {
+		b_Keep[separations[0] <= separations[1] ? 0 : 1] = true;
+	}
+	if (b_Keep[0] && b_Keep[1] && FlatMath::NearlyEqual(contacts[0], contacts[1])) {
+		b_Keep[1] = false;
+	}
+
+	for (int i = 0; i < 2; i++) {
+		if (!b_Keep[i]) continue;
+
+		if (contactCount == 0) {
+			contact1 = contacts[i];
+			separation1 = separations[i];
+		}
+		else {
+			contact2 = contacts[i];
+			separation2 = separations[i];
+		}
+		contactCount++;
+	}
+}
+
+bool Collisions::Collide(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB, FlatVector& normal, float& depth) {
+	int axis = -1;
+	return Collide(bodyA, fixtureA, bodyB, fixtureB, normal, depth, axis);
+}
+
+bool Collisions::Collide(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB,
+	FlatVector& normal, float& depth, int& axis)
+{
 	normal = FlatVector();
 	depth = 0.0f;
+	int cachedAxis = axis;
+	axis = -1;
+
+	FlatBody::FixtureGeometry a = bodyA->GetFixture(fixtureA);
+	FlatBody::FixtureGeometry b = bodyB->GetFixture(fixtureB);
+
+	if (a.type == FlatBody::ShapeType::Segment || b.type == FlatBody::ShapeType::Segment) {
+		bool b_SegmentFirst = a.type == FlatBody::ShapeType::Segment;
+		const FlatBody::FixtureGeometry& segment = b_SegmentFirst ? a : b;
+		const FlatBody::FixtureGeometry& other = b_SegmentFirst ? b : a;
+		bool result = false;
+
+		if (other.type == FlatBody::ShapeType::Circle) {
+			result = IntersectCircleSegment(other.center, other.radius,
+				segment.points[0], segment.points[1], segment.points[2], segment.points[3], normal, depth);
+		}
+		else if (other.type == FlatBody::ShapeType::Box) {
+			result = IntersectPolygonSegment(other.center, *other.vertices,
+				segment.points[0], segment.points[1], segment.points[2], segment.points[3], normal, depth);
+		}
 
-	FlatBody::ShapeType shapeTypeA = bodyA->shapeType;
-	FlatBody::ShapeType shapeTypeB = bodyB->shapeType;
+		if (!b_SegmentFirst) normal = -normal;
+		return result;
+	}
 
-	if (shapeTypeA == FlatBody::ShapeType::Box) {
-		if (shapeTypeB == FlatBody::ShapeType::Box) {
-			return IntersectPolygons(bodyA->GetPosition(), bodyA->GetTransformVertices(),
-				bodyB->GetPosition(), bodyB->GetTransformVertices(), normal, depth);
+	if (a.type == FlatBody::ShapeType::Box) {
+		if (b.type == FlatBody::ShapeType::Box) {
+			axis = cachedAxis;
+			return IntersectPolygons(a.center, *a.vertices, b.center, *b.vertices, normal, depth, axis);
 		}
-		else if (shapeTypeB == FlatBody::ShapeType::Circle) {
-			bool result = IntersectCirclePolygon(bodyB->GetPosition(), bodyB->radius,
-				bodyA->GetPosition(), bodyA->GetTransformVertices(), normal, depth);
+		else if (b.type == FlatBody::ShapeType::Circle) {
+			bool result = IntersectCirclePolygon(b.center, b.radius, a.center, *a.vertices, normal, depth);
 
 			normal = -normal;
 			return result;
 		}
 	}
-	else if (shapeTypeA == FlatBody::ShapeType::Circle) {
-		if (shapeTypeB == FlatBody::ShapeType::Box) {
-			return IntersectCirclePolygon(bodyA->GetPosition(), bodyA->radius,
-				bodyB->GetPosition(), bodyB->GetTransformVertices(), normal, depth);
+	else if (a.type == FlatBody::ShapeType::Circle) {
+		if (b.type == FlatBody::ShapeType::Box) {
+			return IntersectCirclePolygon(a.center, a.radius, b.center, *b.vertices, normal, depth);
 		}
-		else if (shapeTypeB == FlatBody::ShapeType::Circle) {
-			return IntersectCircles(bodyA->GetPosition(), bodyA->radius,
-				bodyB->GetPosition(), bodyB->radius, normal, depth);
+		else if (b.type == FlatBody::ShapeType::Circle) {
+			return IntersectCircles(a.center, a.radius, b.center, b.radius, normal, depth);
 		}
 	}
 
 	return false;
 }
+
+
+bool Collisions::PointInCircle(const FlatVector& p, const FlatVector& center, const float& radius) {
+	return FlatMath::DistanceSquared(p, center) <= radius * radius;
+}
+
+bool Collisions::PointInPolygon(const FlatVector& p, const std::vector<FlatVector>& vertices) {
+	// Convex polygon: p is inside when it lies on the same side of every edge
+	bool hasPositive = false;
+	bool hasNegative = false;
+
+	for (int i = 0; i < vertices.size(); i++) {
+		const FlatVector& va = vertices[i];
+		const FlatVector& vb = vertices[(i + 1) % vertices.size()];
+
+		float side = FlatMath::Cross(vb - va, p - va);
+		if (side > 0.0f) hasPositive = true;
+		if (side < 0.0f) hasNegative = true;
+
+		if (hasPositive && hasNegative) return false;
+	}
+
+	return true;
+}
+
+bool Collisions::PointInBody(const FlatVector& p, FlatBody*& body) {
+	// segments have no inside
+	if (body->shapeType == FlatBody::Chain) return false;
+
+	for (int i = 0; i < body->FixtureCount(); i++) {
+		FlatBody::FixtureGeometry fixture = body->GetFixture(i);
+
+		if (fixture.type == FlatBody::ShapeType::Circle) {
+			if (PointInCircle(p, fixture.center, fixture.radius)) return true;
+		}
+		else if (fixture.type == FlatBody::ShapeType::Box) {
+			if (PointInPolygon(p, *fixture.vertices)) return true;
+		}
+	}
+
+	return false;
+}
+
+bool Collisions::IntersectBodyAABB(FlatBody*& body, const FlatAABB& aabb) {
+	if (!IntersectAABB(body->GetAABB(), aabb)) {
+		return false;
+	}
+
+	std::vector<FlatVector> box = {
+		aabb.min,
+		FlatVector(aabb.max.x, aabb.min.y),
+		aabb.max,
+		FlatVector(aabb.min.x, aabb.max.y)
+	};
+	FlatVector boxCenter = (aabb.min + aabb.max) * 0.5f;
+
+	FlatVector normal;
+	float depth;
+
+	for (int i = 0; i < body->FixtureCount(); i++) {
+		FlatBody::FixtureGeometry fixture = body->GetFixture(i);
+
+		if (fixture.type == FlatBody::ShapeType::Circle) {
+			if (IntersectCirclePolygon(fixture.center, fixture.radius, boxCenter, box, normal, depth)) return true;
+		}
+		else if (fixture.type == FlatBody::ShapeType::Box) {
+			if (IntersectPolygons(fixture.center, *fixture.vertices, boxCenter, box, normal, depth)) return true;
+		}
+		else if (fixture.type == FlatBody::ShapeType::Segment) {
+			// either side counts: the segment's bounds overlap and the box straddles its line
+			if (!IntersectAABB(body->GetFixtureAABB(i), aabb)) continue;
+
+			const FlatVector& start = fixture.points[1];
+			FlatVector edge = fixture.points[2] - start;
+			bool b_Front = false;
+			bool b_Back = false;
+			for (auto& corner : box) {
+				float side = FlatMath::Cross(edge, corner - start);
+				if (side >= 0.0f) b_Front = true;
+				if (side <= 0.0f) b_Back = true;
+			}
+			if (b_Front && b_Back) return true;
+		}
+	}
+
+	return false;
+}
+
+bool Collisions::RayCastCircle(const FlatVector& p1, const FlatVector& p2, const FlatVector& center, const float& radius,
+	float& fraction, FlatVector& normal)
+{
+	// |p1 + t * d - center|^2 = radius^2, hits only from outside the circle
+	FlatVector s = p1 - center;
+	float b = FlatMath::Dot(s, s) - radius * radius;
+	if (b < 0.0f) return false;
+
+	FlatVector d = p2 - p1;
+	float c = FlatMath::Dot(s, d);
+	float rr = FlatMath::Dot(d, d);
+	float sigma = c * c - rr * b;
+
+	if (sigma < 0.0f || rr < 1e-12f) return false;
+
+	float t = -(c + std::sqrt(sigma));
+	if (t < 0.0f || t > rr) return false;
+
+	fraction = t / rr;
+	normal = FlatMath::Normalize(s + fraction * d);
+	return true;
+}
+
+bool Collisions::RayCastPolygon(const FlatVector& p1, const FlatVector& p2, const std::vector<FlatVector>& vertices,
+	float& fraction, FlatVector& normal)
+{
+	// Cyrus-Beck clipping of the segment against every edge's half plane
+	if (vertices.size() < 3) return false;
+
+	FlatVector centroid;
+	for (auto& v : vertices) {
+		centroid += v;
+	}
+	centroid = centroid / (float)vertices.size();
+
+	FlatVector d = p2 - p1;
+	float lower = 0.0f;
+	float upper = 1.0f;
+	int index = -1;
+
+	for (int i = 0; i < vertices.size(); i++) {
+		const FlatVector& va = vertices[i];
+		const FlatVector& vb = vertices[(i + 1) % vertices.size()];
+
+		FlatVector edge = vb - va;
+		FlatVector edgeNormal = FlatMath::Normalize(FlatVector(-edge.y, edge.x));
+		if (FlatMath::Dot(edgeNormal, va - centroid) < 0.0f) {
+			edgeNormal = -edgeNormal;
+		}
+
+		float numerator = FlatMath::Dot(edgeNormal, va - p1);
+		float denominator = FlatMath::Dot(edgeNormal, d);
+
+		if (denominator == 0.0f) {
+			if (numerator < 0.0f) return false;
+		}
+		else if (denominator < 0.0f && numerator < lower * denominator) {
+			lower = numerator / denominator;
+			index = i;
+			normal = edgeNormal;
+		}
+		else if (denominator > 0.0f && numerator < upper * denominator) {
+			upper = numerator / denominator;
+		}
+
+		if (upper < lower) return false;
+	}
+
+	if (index < 0) return false; // starts inside
+
+	fraction = lower;
+	return true;
+}
+
+bool Collisions::RayCastSegment(const FlatVector& p1, const FlatVector& p2, const FlatVector& start, const FlatVector& end,
+	float& fraction, FlatVector& normal)
+{
+	FlatVector d = p2 - p1;
+	FlatVector segmentNormal = SegmentNormal(start, end);
+
+	// parallel, or coming from behind
+	float denominator = FlatMath::Dot(segmentNormal, d);
+	if (denominator >= 0.0f) return false;
+
+	float t = FlatMath::Dot(segmentNormal, start - p1) / denominator;
+	if (t < 0.0f || t > 1.0f) return false;
+
+	FlatVector edge = end - start;
+	float s = FlatMath::Dot(p1 + d * t - start, edge) / FlatMath::LengthSquared(edge);
+	if (s < 0.0f || s > 1.0f) return false;
+
+	fraction = t;
+	normal = segmentNormal;
+	return true;
+}
+
+bool Collisions::RayCastBody(const FlatVector& p1, const FlatVector& p2, FlatBody*& body, float& fraction, FlatVector& normal) {
+	// the closest hit over the body's fixtures
+	bool b_Hit = false;
+
+	for (int i = 0; i < body->FixtureCount(); i++) {
+		FlatBody::FixtureGeometry fixture = body->GetFixture(i);
+		float fixtureFraction;
+		FlatVector fixtureNormal;
+		bool b_FixtureHit = false;
+
+		if (fixture.type == FlatBody::ShapeType::Circle) {
+			b_FixtureHit = RayCastCircle(p1, p2, fixture.center, fixture.radius, fixtureFraction, fixtureNormal);
+		}
+		else if (fixture.type == FlatBody::ShapeType::Box) {
+			b_FixtureHit = RayCastPolygon(p1, p2, *fixture.vertices, fixtureFraction, fixtureNormal);
+		}
+		else if (fixture.type == FlatBody::ShapeType::Segment) {
+			b_FixtureHit = RayCastSegment(p1, p2, fixture.points[1], fixture.points[2], fixtureFraction, fixtureNormal);
+		}
+
+		if (b_FixtureHit && (!b_Hit || fixtureFraction < fraction)) {
+			b_Hit = true;
+			fraction = fixtureFraction;
+			normal = fixtureNormal;
+		}
+	}
+
+	return b_Hit;
+}
@@ -6,10 +6,21 @@
 
 class Collisions {
 private:
+	// Chain segments: a polygon axis replaces the segment's normal only when it is shallower by
+	// SEGMENT_AXIS_TOLERANCE (m), and may lean SEGMENT_SIN_TOLERANCE (sine) past a convex joint's
+	// other normal. Clipped contact points further than SEGMENT_CONTACT_DISTANCE (m) are dropped.
+	static constexpr float SEGMENT_AXIS_TOLERANCE = 0.0005f;
+	static constexpr float SEGMENT_SIN_TOLERANCE = 0.1f;
+	static constexpr float SEGMENT_CONTACT_DISTANCE = 0.005f;
+
 	static void ProjectVertices(const std::vector<FlatVector>& vertices, const FlatVector& axis, float& min, float& max);
 	static void ProjectCircle(const FlatVector& center, const float& radius, const FlatVector& axis, float& min, float& max);
 	static int FindClosePointOnPolygon(const FlatVector& circleCenter, const std::vector<FlatVector>& vertices);
 
+	// overlap of two polygons along one axis, numbered as in IntersectPolygons; false when they're apart along it
+	static bool OverlapOnAxis(const std::vector<FlatVector>& verticesA, const std::vector<FlatVector>& verticesB,
+		const int& index, FlatVector& axis, float& depth);
+
 public:
 	static bool IntersectAABB(const FlatAABB& a, const FlatAABB& b);
 
@@ -19,23 +30,75 @@ public:
 	static bool IntersectPolygons(const FlatVector& centerA, const std::vector<FlatVector>& verticesA,
 		const FlatVector& centerB, const std::vector<FlatVector>& verticesB, FlatVector& normal, float& depth);
 
+	// axis numbers the edge normals, A's edges first, then B's. In, the axis an earlier call
+	// returned for the same pair or -1; out, the separating axis when the polygons are apart,
+	// else the axis of least overlap. A pair still apart along its cached axis returns after
+	// projecting onto it alone. The result is the same with or without a cached axis.
+	static bool IntersectPolygons(const FlatVector& centerA, const std::vector<FlatVector>& verticesA,
+		const FlatVector& centerB, const std::vector<FlatVector>& verticesB, FlatVector& normal, float& depth, int& axis);
+
 	static bool IntersectCirclePolygon(const FlatVector& circleCenter, const float& cirleRadius,
 		const FlatVector& polygonCenter, const std::vector<FlatVector>& vertices, FlatVector& normal, float& depth);
 
-	static void FindContactPoints(FlatBody*& bodyA, FlatBody*& bodyB, FlatVector& contact1, FlatVector& contact2, int& contactCount);
+	// One-sided chain segment start -> end, between the ghost vertices of its neighbours. Shapes
+	// behind the segment pass through, and one over a neighbour is left to that segment, so
+	// nothing catches on a joint. The normal points from the segment to the other shape.
+	static bool IntersectCircleSegment(const FlatVector& circleCenter, const float& circleRadius,
+		const FlatVector& ghost1, const FlatVector& start, const FlatVector& end, const FlatVector& ghost2,
+		FlatVector& normal, float& depth);
+
+	static bool IntersectPolygonSegment(const FlatVector& polygonCenter, const std::vector<FlatVector>& vertices,
+		const FlatVector& ghost1, const FlatVector& start, const FlatVector& end, const FlatVector& ghost2,
+		FlatVector& normal, float& depth);
+
+	// Narrowphase between one fixture of each body; circles and boxes only have fixture 0
+	static void FindContactPoints(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB,
+		FlatVector& contact1, FlatVector& contact2, int& contactCount);
+
+	// Also the gap along the normal (A to B) at each point, negative when overlapping.
+	// Circle contacts have a single point at -depth.
+	static void FindContactPoints(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB,
+		const FlatVector& normal, const float& depth,
+		FlatVector& contact1, FlatVector& contact2, float& separation1, float& separation2, int& contactCount);
 
-	static bool Collide(FlatBody*& bodyA, FlatBody*& bodyB, FlatVector& normal, float& depth);
+	static bool Collide(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB, FlatVector& normal, float& depth);
+
+	// Box pairs pass axis through to IntersectPolygons; other pairs leave it at -1
+	static bool Collide(FlatBody*& bodyA, const int& fixtureA, FlatBody*& bodyB, const int& fixtureB,
+		FlatVector& normal, float& depth, int& axis);
 
 	static void PointSegmentDistance(const FlatVector& p, const FlatVector& a, const FlatVector& b,
 		float& distanceSquare, FlatVector& contact);
+
+	static bool PointInCircle(const FlatVector& p, const FlatVector& center, const float& radius);
+	static bool PointInPolygon(const FlatVector& p, const std::vector<FlatVector>& vertices);
+	static bool PointInBody(const FlatVector& p, FlatBody*& body);
+	static bool IntersectBodyAABB(FlatBody*& body, const FlatAABB& aabb);
+
+	static bool RayCastCircle(const FlatVector& p1, const FlatVector& p2, const FlatVector& center, const float& radius,
+		float& fraction, FlatVector& normal);
+	static bool RayCastPolygon(const FlatVector& p1, const FlatVector& p2, const std::vector<FlatVector>& vertices,
+		float& fraction, FlatVector& normal);
+
+	// Hits a segment from its front only
+	static bool RayCastSegment(const FlatVector& p1, const FlatVector& p2, const FlatVector& start, const FlatVector& end,
+		float& fraction, FlatVector& normal);
+	static bool RayCastBody(const FlatVector& p1, const FlatVector& p2, FlatBody*& body, float& fraction, FlatVector& normal);
 	
 private:
 	static void FindCircleContactPoint(const FlatVector& centerA, const float& radiusA,
 		const FlatVector& centerB, FlatVector& contact);
 
-	static void FindPolygonContactPoint(const std::vector<FlatVector> verticesA, const std::vector<FlatVector> verticesB, 
-		FlatVector& contact1, FlatVector& contact2, int& contactCount);
+	static void FindPolygonContactPoint(const std::vector<FlatVector>& verticesA, const std::vector<FlatVector>& verticesB, 
+		const FlatVector& normal, FlatVector& contact1, FlatVector& contact2, float& separation1, float& separation2, int& contactCount);
 
 	static void FindCirclePolygonContactPoint(const FlatVector& centerA, const float& radiusA,
 		const FlatVector& centerB, const std::vector<FlatVector>& polygonVertices,FlatVector& contact);
+
+	// normal from the segment to the polygon; the segment or the polygon face it picks is the
+	// reference the other side is clipped against
+	static void FindPolygonSegmentContactPoints(const std::vector<FlatVector>& vertices, const FlatVector& start, const FlatVector& end,
+		const FlatVector& normal, FlatVector& contact1, FlatVector& contact2, float& separation1, float& separation2, int& contactCount);
+
+	static FlatVector SegmentNormal(const FlatVector& start, const FlatVector& end);
 };
\ No newline at end of file
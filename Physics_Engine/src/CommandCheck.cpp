@@ -0,0 +1,140 @@
+#include "CommandCheck.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void CommandCheck::Enqueue(FlatWorld& world, const FlatWorld::Command::Type& type, FlatBody* body) {
+	FlatWorld::Command command;
+	command.type = type;
+	command.body = body;
+	command.handle = world.GetHandle(body);
+	world.Enqueue(command);
+}
+
+int CommandCheck::Count(const std::vector<FlatBody*>& bodies, FlatBody* body) {
+	return (int)std::count(bodies.begin(), bodies.end(), body);
+}
+
+int CommandCheck::Run() {
+	using Type = FlatWorld::Command::Type;
+
+	struct Case {
+		const char* name;
+		bool b_InWorldBefore;
+		std::vector<Type> commands;
+		bool b_InWorld;
+		int added;
+		int removed;
+		int stale;
+	};
+
+	const Case cases[] = {
+		{ "remove, add",             true,  { Type::Remove, Type::Add },               true,  0, 0, 0 },
+		{ "remove, add, remove",     true,  { Type::Remove, Type::Add, Type::Remove }, true,  0, 0, 1 },
+		{ "remove, remove",          true,  { Type::Remove, Type::Remove },            false, 0, 1, 0 },
+		{ "add, remove, add",        false, { Type::Add, Type::Remove, Type::Add },    true,  1, 0, 1 },
+		{ "add, remove",             false, { Type::Add, Type::Remove },               true,  1, 0, 1 },
+		{ "add, add",                false, { Type::Add, Type::Add },                  true,  1, 0, 0 },
+	};
+
+	int failures = 0;
+	for (const Case& c : cases) {
+		FlatWorld world;
+
+		FlatBody* body = nullptr;
+		FlatBody::CreateCircleBody(0.5f, 1.0f, false, 0.5f, body);
+		if (c.b_InWorldBefore) world.AddBody(body);
+
+		for (const Type& type : c.commands) {
+			Enqueue(world, type, body);
+		}
+		world.ApplyCommands();
+
+		int id;
+		bool b_InWorld = world.GetBodyIndex(body, id);
+		int added = Count(world.GetAddedBodies(), body);
+		int removed = Count(world.GetRemovedBodies(), body);
+
+		// the world's bodies are the caller's, as are removed ones, once
+		world.Step(4, 1.0f / 60.0f);
+		int stale = (int)world.GetStepStats().staleCommandCount;
+		if (b_InWorld) world.RemoveBody(body);
+		delete body;
+
+		if (b_InWorld != c.b_InWorld || added != c.added || removed != c.removed || stale != c.stale) {
+			std::printf("  %-22s inWorld=%d added=%d removed=%d stale=%d, expected %d %d %d %d\n",
+				c.name, b_InWorld, added, removed, stale, c.b_InWorld, c.added, c.removed, c.stale);
+			failures++;
+		}
+	}
+
+	failures += CheckDeleted();
+	failures += CheckReused();
+
+	int caseCount = (int)(sizeof(cases) / sizeof(cases[0])) + 2;
+	std::printf("check-commands: %d of %d cases failed\n", failures, caseCount);
+	return failures > 0 ? 1 : 0;
+}
+
+int CommandCheck::CheckDeleted() {
+	// the bounds take the body out and its owner deletes it while a move is still queued
+	FlatWorld world;
+	world.SetBounds(FlatAABB(-10.0f, -10.0f, 10.0f, 10.0f));
+
+	FlatBody* body = nullptr;
+	FlatBody::CreateCircleBody(0.5f, 1.0f, false, 0.5f, body);
+	body->MoveTo({ 50.0f, 0.0f });
+	world.AddBody(body);
+
+	FlatWorld::Command command;
+	command.type = FlatWorld::Command::MoveTo;
+	command.handle = world.GetHandle(body);
+
+	world.Step(4, 1.0f / 60.0f);
+	bool b_Removed = Count(world.GetRemovedBodies(), body) == 1;
+	delete body;
+
+	world.Enqueue(command);
+	world.Step(4, 1.0f / 60.0f);
+	int stale = (int)world.GetStepStats().staleCommandCount;
+
+	if (!b_Removed || stale != 1) {
+		std::printf("  %-22s removed=%d stale=%d, expected 1 1\n", "escaped, deleted", b_Removed, stale);
+		return 1;
+	}
+	return 0;
+}
+
+int CommandCheck::CheckReused() {
+	// a handle kept past its body's removal must not reach the body that gets the slot next
+	FlatWorld world;
+
+	FlatBody* first = nullptr;
+	FlatBody::CreateCircleBody(0.5f, 1.0f, false, 0.5f, first);
+	world.AddBody(first);
+	FlatWorld::BodyHandle handle = world.GetHandle(first);
+	world.RemoveBody(first);
+	delete first;
+
+	FlatBody* second = nullptr;
+	FlatBody::CreateCircleBody(0.5f, 1.0f, false, 0.5f, second);
+	world.AddBody(second);
+	bool b_SameSlot = world.GetHandle(second).slot == handle.slot;
+
+	FlatWorld::Command command;
+	command.type = FlatWorld::Command::MoveTo;
+	command.handle = handle;
+	command.vector = { 5.0f, 0.0f };
+	world.Enqueue(command);
+	world.ApplyCommands();
+
+	bool b_Moved = second->GetPosition().x != 0.0f;
+	world.RemoveBody(second);
+	delete second;
+
+	if (!b_SameSlot || b_Moved) {
+		std::printf("  %-22s sameSlot=%d moved=%d, expected 1 0\n", "slot reused", b_SameSlot, b_Moved);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FlatWorld.h"
+
+// Check of FlatWorld's command batches, run by the build's tests as Physics_Engine_Headless
+// --check-commands. Each case queues adds and removes of the same body in one batch and checks
+// where the body ends up: in the world or not, and listed at most once by GetAddedBodies and
+// GetRemovedBodies, so an owner that deletes the removed bodies never frees a live or already
+// freed one. Removes carry the handle the body had when queued, so one outliving the body's stay
+// in the world is skipped, as are commands for a body deleted since or a handle slot reused.
+class CommandCheck {
+public:
+	// Runs every case, prints the failures and returns 1 if there are any
+	static int Run();
+
+private:
+	static void Enqueue(FlatWorld& world, const FlatWorld::Command::Type& type, FlatBody* body);
+	static int CheckDeleted();
+	static int CheckReused();
+	static int Count(const std::vector<FlatBody*>& bodies, FlatBody* body);
+};
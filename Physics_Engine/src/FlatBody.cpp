@@ -2,39 +2,40 @@
 #include "Def.h"
 #include "FlatMath.h"
 #include "FlatWorld.h"
+#include <algorithm>
+#include <cfloat>
 
-FlatBody::FlatBody(const float& _density, const float& _mass, const float& _inertia, const float& _restitution, const float& _area,
-	const bool& _b_IsStatic, const float& _radius, const float& _width, const float& _height,
-	const std::vector<FlatVector>& _vertices, const ShapeType& shape) :
+FlatBody::FlatBody(const std::shared_ptr<const FlatShape>& _shape, const float& _density, const float& _mass,
+	const float& _restitution, const bool& _b_IsStatic) :
 	position(FlatVector()),
+	shape(_shape),
+	shapeType(_shape->type),
 	density(_density),
 	mass(_mass),
 	invMass(!_b_IsStatic ? 1.0f / mass : 0.0f),
 	restitution(_restitution),
-	area(_area),
 	b_IsStatic(_b_IsStatic),
-	radius(_radius),
-	width(_width),
-	height(_height),
-	shapeType(shape),
-	vertices(_vertices),
-	inertia(_inertia),
+	inertia(_mass * _shape->unitInertia),
 	invInertia(!b_IsStatic ? 1.0f / inertia : 0.0f),
 	staticFriction(0.6f),
 	dynamicFriction(0.4f)
 {
 	force = FlatVector();
 
-	if (shape == ShapeType::Box) {
-		transformVertices.resize(vertices.size());
-	}
-	else {
-		transformVertices.resize(0);
+	transformVertices.resize(shape->vertices.size());
+	fixtureCenters.resize(shape->fixtures.size());
+	fixtureVertices.resize(shape->fixtures.size());
+	for (int i = 0; i < shape->fixtures.size(); i++) {
+		fixtureVertices[i].resize(shape->fixtures[i].vertices.size());
 	}
 	angle = 0.0f;
 	angularVelocity = 0.0f;
 	b_TransformUpdateRequired = true;
 	b_AabbUpdateRequired = true;
+	index = -1;
+	proxyId = -1;
+	handleSlot = -1;
+	userData = nullptr;
 }
 
 FlatBody::FlatBody(const FlatBody& other) :
@@ -43,21 +44,25 @@ FlatBody::FlatBody(const FlatBody& other) :
 	mass(other.mass),
 	invMass(other.invMass),
 	restitution(other.restitution),
-	area(other.area),
 	b_IsStatic(other.b_IsStatic),
-	radius(other.radius),
-	width(other.width),
-	height(other.height),
+	shape(other.shape),
 	shapeType(other.shapeType),
-	vertices(other.vertices),
 	inertia(other.inertia),
 	invInertia(other.invInertia),
 	force(other.force),
 	transformVertices(other.transformVertices),
+	fixtureVertices(other.fixtureVertices),
+	fixtureCenters(other.fixtureCenters),
+	aabbMin(other.aabbMin),
+	aabbMax(other.aabbMax),
 	angle(other.angle),
 	angularVelocity(other.angularVelocity),
 	b_TransformUpdateRequired(other.b_TransformUpdateRequired),
 	b_AabbUpdateRequired(other.b_AabbUpdateRequired),
+	index(-1),
+	proxyId(-1),
+	handleSlot(-1),
+	userData(other.userData),
 	staticFriction(other.staticFriction),
 	dynamicFriction(other.dynamicFriction)
 {}
@@ -68,40 +73,29 @@ FlatBody::FlatBody(FlatBody&& other) noexcept :
 	mass(other.mass),
 	invMass(other.invMass),
 	restitution(other.restitution),
-	area(other.area),
 	b_IsStatic(other.b_IsStatic),
-	radius(other.radius),
-	width(other.width),
-	height(other.height),
+	shape(other.shape),
 	shapeType(other.shapeType),
-	vertices(other.vertices),
 	inertia(other.inertia),
 	invInertia(other.invInertia),
 	force(std::move(other.force)),
 	transformVertices(std::move(other.transformVertices)),
+	fixtureVertices(std::move(other.fixtureVertices)),
+	fixtureCenters(std::move(other.fixtureCenters)),
+	aabbMin(other.aabbMin),
+	aabbMax(other.aabbMax),
 	angle(other.angle),
 	angularVelocity(other.angularVelocity),
 	b_TransformUpdateRequired(other.b_TransformUpdateRequired),
 	b_AabbUpdateRequired(other.b_AabbUpdateRequired),
+	index(-1),
+	proxyId(-1),
+	handleSlot(-1),
+	userData(other.userData),
 	staticFriction(other.staticFriction),
 	dynamicFriction(other.dynamicFriction)
 {}
 
-std::vector<FlatVector> FlatBody::CreateBoxVertices(const float& width, const float& height) {
-	float left = -width / 2.0f;
-	float right = left + width;
-	float bottom = height / 2.0f;
-	float top = bottom - height;
-
-	std::vector<FlatVector> vectices(4);
-	vectices[0] = { left, top };
-	vectices[1] = { right, top };
-	vectices[2] = { right, bottom };
-	vectices[3] = { left, bottom };
-
-	return vectices;
-}
-
 FlatVector FlatBody::GetLinearVelocity() const {
 	return linearVelocity;
 }
@@ -142,7 +136,18 @@ void FlatBody::Step(FlatVector& gravity, const int& iterations, float dt) {
 
 	dt /= (float)iterations;
 
+	IntegrateVelocity(gravity, dt);
+	IntegratePosition(dt);
+}
+
+void FlatBody::IntegrateVelocity(const FlatVector& gravity, const float& dt) {
+	if (b_IsStatic) return;
+
 	linearVelocity += gravity * dt;
+}
+
+void FlatBody::IntegratePosition(const float& dt) {
+	if (b_IsStatic) return;
 
 	position += linearVelocity * dt;
 	angle += angularVelocity * dt;
@@ -157,78 +162,147 @@ void FlatBody::AddForce(FlatVector amount) {
 	force = amount;
 }
 
-std::vector<FlatVector> FlatBody::GetTransformVertices() {
+void FlatBody::UpdateTransformVertices() {
 	if (b_TransformUpdateRequired) {
 		FlatTransform transform = FlatTransform(position, angle);
 
+		const std::vector<FlatVector>& vertices = shape->vertices;
 		for (int i = 0; i < vertices.size(); i++) {
 			FlatVector v = vertices[i];
 			transformVertices[i] = FlatVector::Transform(v, transform);
 		}
+
+		for (int i = 0; i < shape->fixtures.size(); i++) {
+			const FlatShape::Fixture& fixture = shape->fixtures[i];
+			fixtureCenters[i] = FlatVector::Transform(fixture.offset, transform);
+			for (int j = 0; j < fixture.vertices.size(); j++) {
+				fixtureVertices[i][j] = FlatVector::Transform(fixture.vertices[j], transform);
+			}
+		}
+
+		b_TransformUpdateRequired = false;
 	}
+}
 
+const std::vector<FlatVector>& FlatBody::GetTransformVertices() {
+	UpdateTransformVertices();
 	return transformVertices;
 }
 
-bool FlatBody::CreateCircleBody(float radius, float density,bool b_IsStatic, float restitution, FlatBody*& body) {
+int FlatBody::FixtureCount() const {
+	if (shapeType == Chain) return shape->SegmentCount();
+	return shapeType == Compound ? (int)shape->fixtures.size() : 1;
+}
+
+FlatBody::FixtureGeometry FlatBody::GetFixture(const int& fixture) {
+	UpdateTransformVertices();
+
+	FixtureGeometry geometry;
+	if (shapeType == Compound) {
+		const FlatShape& fixtureShape = *shape->fixtures[fixture].shape;
+		geometry.type = fixtureShape.type;
+		geometry.center = fixtureCenters[fixture];
+		geometry.radius = fixtureShape.radius;
+		geometry.vertices = &fixtureVertices[fixture];
+	}
+	else if (shapeType == Chain) {
+		int ghost1, start, end, ghost2;
+		shape->GetSegment(fixture, ghost1, start, end, ghost2);
+
+		geometry.type = Segment;
+		geometry.points[0] = transformVertices[ghost1];
+		geometry.points[1] = transformVertices[start];
+		geometry.points[2] = transformVertices[end];
+		geometry.points[3] = transformVertices[ghost2];
+		geometry.center = (geometry.points[1] + geometry.points[2]) * 0.5f;
+		geometry.radius = 0.0f;
+		geometry.vertices = nullptr;
+	}
+	else {
+		geometry.type = shapeType;
+		geometry.center = position;
+		geometry.radius = shape->radius;
+		geometry.vertices = &transformVertices;
+	}
+	return geometry;
+}
+
+FlatAABB FlatBody::GetFixtureAABB(const int& fixture) {
+	if (shapeType != Compound && shapeType != Chain) {
+		return GetAABB();
+	}
+
+	FixtureGeometry geometry = GetFixture(fixture);
+	if (geometry.type == Circle) {
+		FlatVector r(geometry.radius, geometry.radius);
+		return FlatAABB(geometry.center - r, geometry.center + r);
+	}
+	else if (geometry.type == Segment) {
+		const FlatVector& a = geometry.points[1];
+		const FlatVector& b = geometry.points[2];
+		return FlatAABB(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.x, b.x), std::max(a.y, b.y));
+	}
+
+	FlatVector lower(FLT_MAX, FLT_MAX);
+	FlatVector upper(-FLT_MAX, -FLT_MAX);
+	for (auto& v : *geometry.vertices) {
+		lower = FlatVector(std::min(lower.x, v.x), std::min(lower.y, v.y));
+		upper = FlatVector(std::max(upper.x, v.x), std::max(upper.y, v.y));
+	}
+	return FlatAABB(lower, upper);
+}
+
+bool FlatBody::CreateBody(const std::shared_ptr<const FlatShape>& shape, float density, bool b_IsStatic, float restitution, FlatBody*& body) {
 	body = nullptr;
 
-	float area = radius * radius * PI;
+	if (!shape || density < FlatWorld::MIN_DENSITY || density > FlatWorld::MAX_DENSITY) {
+		return false;
+	}
 
-	if (area < FlatWorld::MIN_BODY_SIZE || area > FlatWorld::MAX_BODY_SIZE ||
-		density < FlatWorld::MIN_DENSITY || density > FlatWorld::MAX_DENSITY) {
+	if (shape->type == Chain && !b_IsStatic) {
 		return false;
 	}
 
 	restitution = FlatMath::Clamp(restitution, 0.0f, 1.0f);
 
-	float mass = 0.0f;
-	float inertia = 0.0f;
+	float mass = !b_IsStatic ? shape->area * density : 0.0f;
 
-	if (!b_IsStatic) {
-		mass = area * density;
-		inertia = (1.0f / 2.0f) * mass * radius * radius;
-	}
+	body = new FlatBody(shape, density, mass, restitution, b_IsStatic);
 
-	body = new FlatBody(density, mass, inertia, restitution, area,
-		b_IsStatic, radius, 0.0f, 0.0f, std::vector<FlatVector>{}, ShapeType::Circle);
-
-	return  true;
+	return true;
 }
 
-std::vector<int> FlatBody::CreateBoxTriangles() {
-	std::vector<int> triangles(6);
-	triangles[0] = 0;
-	triangles[1] = 1;
-	triangles[2] = 2;
-	triangles[3] = 0;
-	triangles[4] = 2;
-	triangles[5] = 3;
+bool FlatBody::CreateCircleBody(float radius, float density, bool b_IsStatic, float restitution, FlatBody*& body) {
+	body = nullptr;
 
-	return triangles;
+	std::shared_ptr<const FlatShape> shape;
+	if (!FlatShape::CreateCircle(radius, shape)) {
+		return false;
+	}
+
+	return CreateBody(shape, density, b_IsStatic, restitution, body);
 }
 
-bool FlatBody::CreateBoxBody(float width, float height, float density, bool b_IsStatic, float restitution, FlatBody*& body)
-{
-	float area = width * height;
+bool FlatBody::CreateBoxBody(float width, float height, float density, bool b_IsStatic, float restitution, FlatBody*& body) {
+	body = nullptr;
 
-	if (area < FlatWorld::MIN_BODY_SIZE || area > FlatWorld::MAX_BODY_SIZE ||
-		density < FlatWorld::MIN_DENSITY || density > FlatWorld::MAX_DENSITY)
+	std::shared_ptr<const FlatShape> shape;
+	if (!FlatShape::CreateBox(width, height, shape)) {
 		return false;
+	}
 
-	restitution = FlatMath::Clamp(restitution, 0.0f, 1.0f);
-	float mass = 0.0f;
-	float inertia = 0.0f;
+	return CreateBody(shape, density, b_IsStatic, restitution, body);
+}
 
-	if (!b_IsStatic) {
-		mass = area * density;
-		inertia = (1.0f / 12.0f) * mass * (width * width + height * height);
-	}
+bool FlatBody::CreateChainBody(const std::vector<FlatVector>& points, const bool& b_Loop, float restitution, FlatBody*& body) {
+	body = nullptr;
 
-	std::vector<FlatVector> vertices = CreateBoxVertices(width, height);
-	body = new FlatBody(density, mass, inertia, restitution, area, b_IsStatic, 0.0f, width, height, vertices, ShapeType::Box);
+	std::shared_ptr<const FlatShape> shape;
+	if (!FlatShape::CreateChain(points, b_Loop, shape)) {
+		return false;
+	}
 
-	return true;
+	return CreateBody(shape, 1.0f, true, restitution, body);
 }
 
 FlatAABB FlatBody::GetAABB() {
@@ -239,9 +313,9 @@ FlatAABB FlatBody::GetAABB() {
 		float maxY = -FLT_MAX;
 	
 		if (shapeType == Box) {
-			std::vector<FlatVector> vectices = GetTransformVertices();
-			for (int i = 0; i < vectices.size(); i++) {
-				FlatVector v = vectices[i];
+			UpdateTransformVertices();
+			for (int i = 0; i < transformVertices.size(); i++) {
+				const FlatVector& v = transformVertices[i];
 				if (v.x < minX) minX = v.x;
 				if (v.x > maxX) maxX = v.x;
 				if (v.y < minY) minY = v.y;
@@ -249,24 +323,66 @@ FlatAABB FlatBody::GetAABB() {
 			}
 		}
 		else if (shapeType == Circle) {
+			float radius = shape->radius;
 			minX = position.x - radius;
 			minY = position.y - radius;
 			maxX = position.x + radius;
 			maxY = position.y + radius;
 		}
+		else if (shapeType == Compound) {
+			UpdateTransformVertices();
+			for (int i = 0; i < fixtureCenters.size(); i++) {
+				for (auto& v : fixtureVertices[i]) {
+					if (v.x < minX) minX = v.x;
+					if (v.x > maxX) maxX = v.x;
+					if (v.y < minY) minY = v.y;
+					if (v.y > maxY) maxY = v.y;
+				}
+				if (shape->fixtures[i].shape->type == Circle) {
+					const FlatVector& c = fixtureCenters[i];
+					float radius = shape->fixtures[i].shape->radius;
+					minX = std::min(minX, c.x - radius);
+					minY = std::min(minY, c.y - radius);
+					maxX = std::max(maxX, c.x + radius);
+					maxY = std::max(maxY, c.y + radius);
+				}
+			}
+		}
+		else if (shapeType == Chain) {
+			// an open chain's end points are ghosts, nothing collides with them
+			UpdateTransformVertices();
+			int first = shape->b_Loop ? 0 : 1;
+			int last = shape->b_Loop ? (int)transformVertices.size() : (int)transformVertices.size() - 1;
+			for (int i = first; i < last; i++) {
+				const FlatVector& v = transformVertices[i];
+				if (v.x < minX) minX = v.x;
+				if (v.x > maxX) maxX = v.x;
+				if (v.y < minY) minY = v.y;
+				if (v.y > maxY) maxY = v.y;
+			}
+		}
 		else {
 			__debugbreak();
 		}
-		aabb = std::make_unique<FlatAABB>(FlatAABB(minX, minY, maxX, maxY));
+		aabbMin = FlatVector(minX, minY);
+		aabbMax = FlatVector(maxX, maxY);
 	}
 	b_AabbUpdateRequired = false;
-	return *aabb;
+	return FlatAABB(aabbMin, aabbMax);
 }
 
 FlatVector FlatBody::GetPosition() const {
 	return position;
 }
 
+void* FlatBody::GetUserData() const {
+	return userData;
+}
+
+void FlatBody::SetUserData(void* data) {
+	userData = data;
+}
+
 float FlatBody::GetAngle() const {
 	return angle;
 }
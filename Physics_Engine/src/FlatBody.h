@@ -2,43 +2,65 @@
 
 #include "FlatVector.h"
 #include "FlatAABB.h"
+#include "FlatShape.h"
 #include <vector>
 #include <memory>
+#include <cmath>
 
 class FlatWorld;
 
 class FlatBody {
 public:
-	enum ShapeType {
-		Circle = 0, 
-		Box = 1
+	using ShapeType = FlatShape::ShapeType;
+	static constexpr ShapeType Circle = FlatShape::Circle;
+	static constexpr ShapeType Box = FlatShape::Box;
+	static constexpr ShapeType Compound = FlatShape::Compound;
+	static constexpr ShapeType Chain = FlatShape::Chain;
+	static constexpr ShapeType Segment = FlatShape::Segment;
+
+	// One convex piece of a body in world space: the body's own circle or box, a fixture of a
+	// compound or a segment of a chain
+	struct FixtureGeometry {
+		ShapeType type;
+		FlatVector center;
+		float radius;
+		const std::vector<FlatVector>* vertices; // valid until the body moves, null for segments
+		FlatVector points[4]; // segments only: ghost vertex, start, end, ghost vertex
 	};
-	
+
+	const std::shared_ptr<const FlatShape> shape;
 	const ShapeType shapeType;
 	const float mass;
 	const float invMass;
 	const float density;
 	const float restitution;
-	const float area;
-	const float radius;
-	const float width;
-	const float height;
 	const bool b_IsStatic;
 	const float inertia;
 	const float invInertia;
 	const float staticFriction;
 	const float dynamicFriction;
 
-	const std::vector<FlatVector> vertices;
-
 private:
 	friend class FlatWorld;
-	std::vector<FlatVector> transformVertices;
-	std::unique_ptr<FlatAABB> aabb;
+	friend class FlatScenario;
+	friend class FlatWorldBatch;
+	friend class FlatContactSolver;
+	friend class FlatParticleSystem;
+	std::vector<FlatVector> transformVertices; // world space copy of shape->vertices, empty for circles
+	std::vector<std::vector<FlatVector>> fixtureVertices; // compounds only, world space per fixture
+	std::vector<FlatVector> fixtureCenters;
+	FlatVector aabbMin;
+	FlatVector aabbMax;
 	
 	bool b_TransformUpdateRequired;
 	bool b_AabbUpdateRequired;
 
+	int index;   // position in the world's body list
+	int proxyId; // leaf in the world's static or dynamic broadphase tree
+	int handleSlot; // in the world's handle table, see FlatWorld::BodyHandle
+
+	void* userData;
+
 	float angle;
 	float angularVelocity;
 	FlatVector position;
@@ -46,13 +68,15 @@ private:
 	FlatVector force;
 
 private:
-	static std::vector<FlatVector> CreateBoxVertices(const float& width, const float& height);
-	static std::vector<int> CreateBoxTriangles();
+	void UpdateTransformVertices();
+
+	// the two halves of Step, for solvers that work between them
+	void IntegrateVelocity(const FlatVector& gravity, const float& dt);
+	void IntegratePosition(const float& dt);
 
 public:
-	FlatBody(const float& _density, const float& _mass, const float& inertia, const float& _restitution, const float& _area,
-		const bool& _b_IsStatic, const float& _radius, const float& _width, const float& _height, 
-		const std::vector<FlatVector>& vertices, const ShapeType& shape);
+	FlatBody(const std::shared_ptr<const FlatShape>& _shape, const float& _density, const float& _mass,
+		const float& _restitution, const bool& _b_IsStatic);
 	
 	FlatBody(const FlatBody& other);
 	FlatBody(FlatBody&& other) noexcept;
@@ -66,19 +90,57 @@ public:
 
 	FlatVector GetLinearVelocity() const;
 
-	std::vector<FlatVector> GetTransformVertices();
+	const std::vector<FlatVector>& GetTransformVertices();
+
+	// 1 for circles and boxes, the fixture count for compounds and the segment count for chains
+	int FixtureCount() const;
+	FixtureGeometry GetFixture(const int& fixture);
+	FlatAABB GetFixtureAABB(const int& fixture);
+
+	// callback(fixture) for every fixture whose bounds may overlap a world space AABB, found
+	// through the compound's or chain's local hierarchy; returns false to stop. Other bodies
+	// report fixture 0.
+	template<typename T>
+	void QueryFixtures(const FlatAABB& aabb, T&& callback) const;
 
 	float GetAngle() const;
 	float GetAngularVelocity() const;
 
+	static bool CreateBody(const std::shared_ptr<const FlatShape>& shape, float density, bool b_IsStatic, float restitution, FlatBody*& body);
+
 	static bool CreateCircleBody(float radius, float density, bool b_IsStatic, float restitution, FlatBody*& body);
 
 	static bool CreateBoxBody(float width, float height, float density, bool b_IsStatic,  float restitution, FlatBody*& body);
 
+	// Chains are static only, see FlatShape::CreateChain
+	static bool CreateChainBody(const std::vector<FlatVector>& points, const bool& b_Loop, float restitution, FlatBody*& body);
+
 	FlatAABB GetAABB();
 
 	FlatVector GetPosition() const;
 
+	void* GetUserData() const;
+	void SetUserData(void* data);
+
 protected:
 	void SetLinearVelocity(const FlatVector& value);
-};
\ No newline at end of file
+};
+
+template<typename T>
+void FlatBody::QueryFixtures(const FlatAABB& aabb, T&& callback) const {
+	if (shapeType != Compound && shapeType != Chain) {
+		callback(0);
+		return;
+	}
+
+	// bounds of the AABB rotated into the body's frame
+	float c = std::cos(angle);
+	float s = std::sin(angle);
+	FlatVector center = (aabb.min + aabb.max) * 0.5f - position;
+	FlatVector extents = (aabb.max - aabb.min) * 0.5f;
+
+	FlatVector localCenter(c * center.x + s * center.y, -s * center.x + c * center.y);
+	FlatVector localExtents(std::abs(c) * extents.x + std::abs(s) * extents.y, std::abs(s) * extents.x + std::abs(c) * extents.y);
+
+	shape->QueryFixtures(localCenter - localExtents, localCenter + localExtents, callback);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+// Many producer threads push T without locks; one consumer takes everything pushed so far.
+// Push links a node onto a stack with one compare-exchange, Drain swaps the whole stack out
+// and reverses it, so a producer never waits on the consumer or on another producer.
+// The items of one producer come out in the order it pushed them.
+template<typename T>
+class FlatCommandQueue {
+private:
+	struct Node {
+		T item;
+		Node* next;
+	};
+
+	std::atomic<Node*> head{ nullptr };
+
+public:
+	FlatCommandQueue() = default;
+	~FlatCommandQueue() {
+		Free(head.exchange(nullptr, std::memory_order_acquire));
+	}
+
+	FlatCommandQueue(const FlatCommandQueue&) = delete;
+	FlatCommandQueue& operator=(const FlatCommandQueue&) = delete;
+
+	// Any thread
+	void Push(const T& item) {
+		Node* node = new Node{ item, head.load(std::memory_order_relaxed) };
+		while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+
+	// Consumer only: appends every item pushed so far, oldest first
+	void Drain(std::vector<T>& items) {
+		Node* node = head.exchange(nullptr, std::memory_order_acquire);
+		if (!node) return;
+
+		size_t first = items.size();
+		for (Node* n = node; n; n = n->next) {
+			items.push_back(n->item);
+		}
+		std::reverse(items.begin() + first, items.end());
+
+		Free(node);
+	}
+
+	bool Empty() const {
+		return head.load(std::memory_order_relaxed) == nullptr;
+	}
+
+private:
+	static void Free(Node* node) {
+		while (node) {
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+};
@@ -0,0 +1,554 @@
+#include "FlatContactSolver.h"
+#include "FlatMath.h"
+#include "FlatLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+const int FlatContactSolver::WIDTH = FLAT_WIDE_LANES;
+
+const float FlatContactSolver::MAX_PUSH_VELOCITY = 3.0f;
+const float FlatContactSolver::RESTITUTION_THRESHOLD = 1.0f;
+
+FlatContactSolver::Constraint FlatContactSolver::MakeConstraint(const FlatManifold& contact) {
+	Constraint c;
+	c.bodyA = contact.bodyA;
+	c.bodyB = contact.bodyB;
+	c.normal = contact.normal;
+	c.contactCount = contact.contactCount;
+	c.basePositionA = contact.bodyA->GetPosition();
+	c.basePositionB = contact.bodyB->GetPosition();
+
+	c.restitution = std::min(contact.bodyA->restitution, contact.bodyB->restitution);
+	c.staticFriction = (contact.bodyA->staticFriction + contact.bodyA->staticFriction) / 2.0f;
+	c.dynamicFriction = (contact.bodyA->dynamicFriction + contact.bodyA->dynamicFriction) / 2.0f;
+
+	FlatVector contactList[2] = { contact.contact1, contact.contact2 };
+	for (int i = 0; i < contact.contactCount; i++) {
+		c.ra[i] = contactList[i] - contact.bodyA->GetPosition();
+		c.rb[i] = contactList[i] - contact.bodyB->GetPosition();
+	}
+
+	return c;
+}
+
+void FlatContactSolver::Solve(Constraint* const* constraints, const int& count, const Path& path, std::vector<int>& bodyGroups) {
+	if (path == Scalar || WIDTH == 1 || count < 2) {
+		for (int i = 0; i < count; i++) {
+			SolveScalar(*constraints[i]);
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; i++) {
+		if (!constraints[i]->bodyA->b_IsStatic) bodyGroups[constraints[i]->bodyA->index] = -1;
+		if (!constraints[i]->bodyB->b_IsStatic) bodyGroups[constraints[i]->bodyB->index] = -1;
+	}
+
+	// A constraint goes into the first group with room that comes after every group
+	// already holding one of its dynamic bodies. Constraints on different bodies commute,
+	// so solving group after group equals solving in the original order.
+	std::vector<Constraint*> members;
+	std::vector<int> sizes;
+	int firstOpen = 0;
+
+	auto groupOf = [&bodyGroups](FlatBody* body) {
+		return body->b_IsStatic ? -1 : bodyGroups[body->index];
+	};
+
+	for (int i = 0; i < count; i++) {
+		Constraint& c = *constraints[i];
+
+		int group = std::max(std::max(groupOf(c.bodyA), groupOf(c.bodyB)) + 1, firstOpen);
+		while (group < sizes.size() && sizes[group] == WIDTH) group++;
+
+		if (group == sizes.size()) {
+			sizes.push_back(0);
+			members.resize(members.size() + WIDTH, nullptr);
+		}
+
+		members[group * WIDTH + sizes[group]++] = &c;
+		if (!c.bodyA->b_IsStatic) bodyGroups[c.bodyA->index] = group;
+		if (!c.bodyB->b_IsStatic) bodyGroups[c.bodyB->index] = group;
+
+		while (firstOpen < sizes.size() && sizes[firstOpen] == WIDTH) firstOpen++;
+	}
+
+	for (int group = 0; group < sizes.size(); group++) {
+		if (sizes[group] == 1) {
+			SolveScalar(*members[group * WIDTH]);
+		}
+		else {
+			SolveWide(&members[group * WIDTH], sizes[group]);
+		}
+	}
+}
+
+void FlatContactSolver::SolveIndependent(Constraint* const* constraints, const int& count, const Path& path) {
+	int width = path == Wide ? WIDTH : 1;
+
+	for (int i = 0; i < count; i += width) {
+		int groupSize = std::min(width, count - i);
+
+		if (groupSize == 1) {
+			SolveScalar(*constraints[i]);
+		}
+		else {
+			SolveWide(constraints + i, groupSize);
+		}
+	}
+}
+
+void FlatContactSolver::SolveScalar(Constraint& c) {
+	FlatBody* bodyA = c.bodyA;
+	FlatBody* bodyB = c.bodyB;
+
+	FlatVector impulseList[2] = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+	FlatVector frictionImpulseList[2] = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+	float magnitudeList[2] = { 0.0f, 0.0f };
+
+	for (int i = 0; i < c.contactCount; i++) {
+		FlatVector raPerp(-c.ra[i].y, c.ra[i].x);
+		FlatVector rbPerp(-c.rb[i].y, c.rb[i].x);
+
+		FlatVector angularLinearVelocityA = raPerp * bodyA->angularVelocity;
+		FlatVector angularLinearVelocityB = rbPerp * bodyB->angularVelocity;
+
+		FlatVector relativeVelocity =
+			(bodyB->linearVelocity + angularLinearVelocityB) -
+			(bodyA->linearVelocity + angularLinearVelocityA);
+
+		float contactVelocityMagnitue = FlatMath::Dot(relativeVelocity, c.normal);
+
+		if (contactVelocityMagnitue > 0.0f) {
+			continue;
+		}
+
+		float raPerpDotNormal = FlatMath::Dot(raPerp, c.normal);
+		float rbPerpDotNormal = FlatMath::Dot(rbPerp, c.normal);
+
+		float denominator = bodyA->invMass + bodyB->invMass +
+			(raPerpDotNormal * raPerpDotNormal) * bodyA->invInertia +
+			(rbPerpDotNormal * rbPerpDotNormal) * bodyB->invInertia;
+
+		float magnitude = -(1.0f + c.restitution) * contactVelocityMagnitue;
+		magnitude /= denominator * (float)c.contactCount;
+
+		magnitudeList[i] = magnitude;
+		impulseList[i] = magnitude * c.normal;
+	}
+
+	c.normalImpulse = magnitudeList[0] + magnitudeList[1];
+
+	for (int i = 0; i < c.contactCount; i++) {
+		FlatVector impulse = impulseList[i];
+
+		// static bodies are shared between constraints solved in parallel, never write to them
+		if (!bodyA->b_IsStatic) {
+			bodyA->linearVelocity += -impulse * bodyA->invMass;
+			bodyA->angularVelocity += -FlatMath::Cross(c.ra[i], impulse) * bodyA->invInertia;
+		}
+
+		if (!bodyB->b_IsStatic) {
+			bodyB->linearVelocity += impulse * bodyB->invMass;
+			bodyB->angularVelocity += FlatMath::Cross(c.rb[i], impulse) * bodyB->invInertia;
+		}
+	}
+
+	// Friction
+	for (int i = 0; i < c.contactCount; i++) {
+		FlatVector raPerp(-c.ra[i].y, c.ra[i].x);
+		FlatVector rbPerp(-c.rb[i].y, c.rb[i].x);
+
+		FlatVector angularLinearVelocityA = raPerp * bodyA->angularVelocity;
+		FlatVector angularLinearVelocityB = rbPerp * bodyB->angularVelocity;
+
+		FlatVector relativeVelocity =
+			(bodyB->linearVelocity + angularLinearVelocityB) -
+			(bodyA->linearVelocity + angularLinearVelocityA);
+
+		FlatVector tangent = relativeVelocity - FlatMath::Dot(relativeVelocity, c.normal) * c.normal;
+
+		if (FlatMath::NearlyEqual(tangent, { 0.0f, 0.0f })) continue;
+		tangent = FlatMath::Normalize(tangent);
+
+		float raPerpDotTangent = FlatMath::Dot(raPerp, tangent);
+		float rbPerpDotTangent = FlatMath::Dot(rbPerp, tangent);
+
+		float denominator = bodyA->invMass + bodyB->invMass +
+			(raPerpDotTangent * raPerpDotTangent) * bodyA->invInertia +
+			(rbPerpDotTangent * rbPerpDotTangent) * bodyB->invInertia;
+
+		float tangentMagnitude = -FlatMath::Dot(relativeVelocity, tangent);
+		tangentMagnitude /= denominator * (float)c.contactCount;
+
+		float magnitude = magnitudeList[i];
+
+		if (std::abs(tangentMagnitude) <= magnitude * c.staticFriction) {
+			frictionImpulseList[i] = tangentMagnitude * tangent;
+		}
+		else {
+			frictionImpulseList[i] = -magnitude * tangent * c.dynamicFriction;
+		}
+	}
+
+	for (int i = 0; i < c.contactCount; i++) {
+		FlatVector frictionImpulse = frictionImpulseList[i];
+
+		if (!bodyA->b_IsStatic) {
+			bodyA->linearVelocity += -frictionImpulse * bodyA->invMass;
+			bodyA->angularVelocity += -FlatMath::Cross(c.ra[i], frictionImpulse) * bodyA->invInertia;
+		}
+
+		if (!bodyB->b_IsStatic) {
+			bodyB->linearVelocity += frictionImpulse * bodyB->invMass;
+			bodyB->angularVelocity += FlatMath::Cross(c.rb[i], frictionImpulse) * bodyB->invInertia;
+		}
+	}
+}
+
+FlatContactSolver::Softness FlatContactSolver::Softness::Make(const float& hertz, const float& dampingRatio, const float& h) {
+	Softness softness;
+	if (hertz == 0.0f) return softness;
+
+	float omega = 2.0f * 3.14159265f * hertz;
+	float a1 = 2.0f * dampingRatio + h * omega;
+	float a2 = h * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+
+	softness.biasRate = omega / a1;
+	softness.massScale = a2 * a3;
+	softness.impulseScale = a3;
+	return softness;
+}
+
+void FlatContactSolver::PrepareSoft(Constraint& c, const float* separations, const Softness& softness) {
+	FlatBody* bodyA = c.bodyA;
+	FlatBody* bodyB = c.bodyB;
+	FlatVector tangent(c.normal.y, -c.normal.x);
+
+	c.softness = softness;
+	c.baseAngleA = bodyA->angle;
+	c.baseAngleB = bodyB->angle;
+
+	for (int i = 0; i < c.contactCount; i++) {
+		SoftPoint& point = c.soft[i];
+
+		float rnA = FlatMath::Cross(c.ra[i], c.normal);
+		float rnB = FlatMath::Cross(c.rb[i], c.normal);
+		float kNormal = bodyA->invMass + bodyB->invMass + bodyA->invInertia * rnA * rnA + bodyB->invInertia * rnB * rnB;
+
+		float rtA = FlatMath::Cross(c.ra[i], tangent);
+		float rtB = FlatMath::Cross(c.rb[i], tangent);
+		float kTangent = bodyA->invMass + bodyB->invMass + bodyA->invInertia * rtA * rtA + bodyB->invInertia * rtB * rtB;
+
+		point.normalMass = kNormal > 0.0f ? 1.0f / kNormal : 0.0f;
+		point.tangentMass = kTangent > 0.0f ? 1.0f / kTangent : 0.0f;
+		point.baseSeparation = separations[i] - FlatMath::Dot(c.rb[i] - c.ra[i], c.normal);
+		point.normalImpulse = 0.0f;
+		point.tangentImpulse = 0.0f;
+		point.maxNormalImpulse = 0.0f;
+		point.relativeVelocity = FlatMath::Dot(RelativeVelocity(c, i), c.normal);
+	}
+}
+
+void FlatContactSolver::WarmStart(Constraint& c) {
+	FlatVector tangent(c.normal.y, -c.normal.x);
+
+	for (int i = 0; i < c.contactCount; i++) {
+		ApplyImpulse(c, i, c.soft[i].normalImpulse * c.normal + c.soft[i].tangentImpulse * tangent);
+	}
+}
+
+void FlatContactSolver::SolveSoft(Constraint& c, const float& h, const bool& b_UseBias) {
+	FlatBody* bodyA = c.bodyA;
+	FlatBody* bodyB = c.bodyB;
+
+	// how far the bodies moved and turned since PrepareSoft
+	FlatVector deltaA = bodyA->position - c.basePositionA;
+	FlatVector deltaB = bodyB->position - c.basePositionB;
+	FlatTransform rotationA(0.0f, 0.0f, bodyA->angle - c.baseAngleA);
+	FlatTransform rotationB(0.0f, 0.0f, bodyB->angle - c.baseAngleB);
+
+	for (int i = 0; i < c.contactCount; i++) {
+		SoftPoint& point = c.soft[i];
+
+		FlatVector d = (deltaB - deltaA) + (FlatVector::Transform(c.rb[i], rotationB) - FlatVector::Transform(c.ra[i], rotationA));
+		float separation = FlatMath::Dot(d, c.normal) + point.baseSeparation;
+
+		float bias = 0.0f;
+		float massScale = 1.0f;
+		float impulseScale = 0.0f;
+
+		if (separation > 0.0f) {
+			// not touching yet, only stop the part of the approach that would close the gap
+			bias = separation / h;
+		}
+		else if (b_UseBias) {
+			bias = std::max(c.softness.biasRate * separation, -MAX_PUSH_VELOCITY);
+			massScale = c.softness.massScale;
+			impulseScale = c.softness.impulseScale;
+		}
+
+		float vn = FlatMath::Dot(RelativeVelocity(c, i), c.normal);
+		float impulse = -point.normalMass * massScale * (vn + bias) - impulseScale * point.normalImpulse;
+
+		float newImpulse = std::max(point.normalImpulse + impulse, 0.0f);
+		impulse = newImpulse - point.normalImpulse;
+		point.normalImpulse = newImpulse;
+		point.maxNormalImpulse = std::max(point.maxNormalImpulse, impulse);
+
+		ApplyImpulse(c, i, impulse * c.normal);
+	}
+
+	// Friction
+	FlatVector tangent(c.normal.y, -c.normal.x);
+
+	for (int i = 0; i < c.contactCount; i++) {
+		SoftPoint& point = c.soft[i];
+
+		float vt = FlatMath::Dot(RelativeVelocity(c, i), tangent);
+		float impulse = -point.tangentMass * vt;
+
+		float maxFriction = c.staticFriction * point.normalImpulse;
+		float newImpulse = point.tangentImpulse + impulse;
+		newImpulse = FlatMath::Clamp(newImpulse, -maxFriction, maxFriction);
+		impulse = newImpulse - point.tangentImpulse;
+		point.tangentImpulse = newImpulse;
+
+		ApplyImpulse(c, i, impulse * tangent);
+	}
+}
+
+void FlatContactSolver::ApplyRestitution(Constraint& c) {
+	if (c.restitution == 0.0f) return;
+
+	for (int i = 0; i < c.contactCount; i++) {
+		SoftPoint& point = c.soft[i];
+		if (point.relativeVelocity > -RESTITUTION_THRESHOLD || point.maxNormalImpulse == 0.0f) continue;
+
+		float vn = FlatMath::Dot(RelativeVelocity(c, i), c.normal);
+		float impulse = -point.normalMass * (vn + c.restitution * point.relativeVelocity);
+
+		float newImpulse = std::max(point.normalImpulse + impulse, 0.0f);
+		impulse = newImpulse - point.normalImpulse;
+		point.normalImpulse = newImpulse;
+		point.maxNormalImpulse = std::max(point.maxNormalImpulse, impulse);
+
+		ApplyImpulse(c, i, impulse * c.normal);
+	}
+}
+
+FlatVector FlatContactSolver::RelativeVelocity(const Constraint& c, const int& i) {
+	FlatBody* bodyA = c.bodyA;
+	FlatBody* bodyB = c.bodyB;
+
+	FlatVector angularLinearVelocityA(-c.ra[i].y * bodyA->angularVelocity, c.ra[i].x * bodyA->angularVelocity);
+	FlatVector angularLinearVelocityB(-c.rb[i].y * bodyB->angularVelocity, c.rb[i].x * bodyB->angularVelocity);
+
+	return (bodyB->linearVelocity + angularLinearVelocityB) - (bodyA->linearVelocity + angularLinearVelocityA);
+}
+
+void FlatContactSolver::ApplyImpulse(Constraint& c, const int& i, const FlatVector& impulse) {
+	// static bodies are shared between constraints solved in parallel, never write to them
+	if (!c.bodyA->b_IsStatic) {
+		c.bodyA->linearVelocity -= impulse * c.bodyA->invMass;
+		c.bodyA->angularVelocity -= FlatMath::Cross(c.ra[i], impulse) * c.bodyA->invInertia;
+	}
+
+	if (!c.bodyB->b_IsStatic) {
+		c.bodyB->linearVelocity += impulse * c.bodyB->invMass;
+		c.bodyB->angularVelocity += FlatMath::Cross(c.rb[i], impulse) * c.bodyB->invInertia;
+	}
+}
+
+#if FLAT_WIDE_LANES > 1
+
+namespace {
+
+	// The operations SolveWide needs, one lane per constraint (see FlatLanes.h)
+	using Lanes = FlatLanes;
+
+	struct BodyLanes {
+		Lanes vx, vy, w, invMass, invInertia, dynamic;
+	};
+
+	// Impulse (ix, iy) at ra applied with the given sign, as FlatContactSolver::SolveScalar does
+	inline void ApplyLaneImpulse(BodyLanes& body, const Lanes& rx, const Lanes& ry, const Lanes& ix, const Lanes& iy,
+		const bool& b_Negate, const Lanes& mask)
+	{
+		Lanes cross = rx * iy - ry * ix;
+		Lanes vx = body.vx + (b_Negate ? -ix : ix) * body.invMass;
+		Lanes vy = body.vy + (b_Negate ? -iy : iy) * body.invMass;
+		Lanes w = body.w + (b_Negate ? -cross : cross) * body.invInertia;
+
+		Lanes write = mask & body.dynamic;
+		body.vx = Select(write, vx, body.vx);
+		body.vy = Select(write, vy, body.vy);
+		body.w = Select(write, w, body.w);
+	}
+}
+
+void FlatContactSolver::SolveWide(Constraint* const* group, const int& count) {
+	constexpr int W = FLAT_WIDE_LANES;
+
+	float nx[W], ny[W], restitution[W], staticFriction[W], dynamicFriction[W], contactCount[W];
+	float ra[2][2][W], rb[2][2][W]; // [point][x/y][lane]
+	float body[2][6][W];            // [A/B][vx, vy, w, invMass, invInertia, dynamic][lane]
+
+	// gather; unused lanes repeat the first constraint and are never scattered
+	for (int l = 0; l < W; l++) {
+		const Constraint& c = *group[l < count ? l : 0];
+
+		nx[l] = c.normal.x;
+		ny[l] = c.normal.y;
+		restitution[l] = c.restitution;
+		staticFriction[l] = c.staticFriction;
+		dynamicFriction[l] = c.dynamicFriction;
+		contactCount[l] = (float)c.contactCount;
+
+		for (int p = 0; p < 2; p++) {
+			ra[p][0][l] = c.ra[p].x;
+			ra[p][1][l] = c.ra[p].y;
+			rb[p][0][l] = c.rb[p].x;
+			rb[p][1][l] = c.rb[p].y;
+		}
+
+		FlatBody* bodies[2] = { c.bodyA, c.bodyB };
+		for (int b = 0; b < 2; b++) {
+			body[b][0][l] = bodies[b]->linearVelocity.x;
+			body[b][1][l] = bodies[b]->linearVelocity.y;
+			body[b][2][l] = bodies[b]->angularVelocity;
+			body[b][3][l] = bodies[b]->invMass;
+			body[b][4][l] = bodies[b]->invInertia;
+			body[b][5][l] = bodies[b]->b_IsStatic ? 0.0f : 1.0f;
+		}
+	}
+
+	Lanes zero = Lanes::Set(0.0f);
+	Lanes normalX = Lanes::Load(nx);
+	Lanes normalY = Lanes::Load(ny);
+	Lanes points = Lanes::Load(contactCount);
+	Lanes sf = Lanes::Load(staticFriction);
+	Lanes df = Lanes::Load(dynamicFriction);
+
+	BodyLanes bodies[2];
+	for (int b = 0; b < 2; b++) {
+		bodies[b] = { Lanes::Load(body[b][0]), Lanes::Load(body[b][1]), Lanes::Load(body[b][2]),
+			Lanes::Load(body[b][3]), Lanes::Load(body[b][4]), Greater(Lanes::Load(body[b][5]), zero) };
+	}
+	BodyLanes& a = bodies[0];
+	BodyLanes& b = bodies[1];
+
+	Lanes active[2] = { Greater(points, zero), Greater(points, Lanes::Set(1.0f)) };
+	Lanes rax[2] = { Lanes::Load(ra[0][0]), Lanes::Load(ra[1][0]) };
+	Lanes ray[2] = { Lanes::Load(ra[0][1]), Lanes::Load(ra[1][1]) };
+	Lanes rbx[2] = { Lanes::Load(rb[0][0]), Lanes::Load(rb[1][0]) };
+	Lanes rby[2] = { Lanes::Load(rb[0][1]), Lanes::Load(rb[1][1]) };
+
+	auto relativeVelocity = [&](const int& p, Lanes& x, Lanes& y) {
+		// (vB + rbPerp * wB) - (vA + raPerp * wA), raPerp = (-ra.y, ra.x)
+		x = (b.vx + (-rby[p]) * b.w) - (a.vx + (-ray[p]) * a.w);
+		y = (b.vy + rbx[p] * b.w) - (a.vy + rax[p] * a.w);
+	};
+
+	auto effectiveMass = [&](const int& p, const Lanes& dx, const Lanes& dy) {
+		Lanes raPerpDot = (-ray[p]) * dx + dy * rax[p];
+		Lanes rbPerpDot = (-rby[p]) * dx + dy * rbx[p];
+		return a.invMass + b.invMass + (raPerpDot * raPerpDot) * a.invInertia + (rbPerpDot * rbPerpDot) * b.invInertia;
+	};
+
+	// Normal impulses, both points from the same velocities
+	Lanes magnitude[2], impulseX[2], impulseY[2];
+	Lanes bounce = -(Lanes::Set(1.0f) + Lanes::Load(restitution));
+
+	for (int p = 0; p < 2; p++) {
+		Lanes rx, ry;
+		relativeVelocity(p, rx, ry);
+
+		Lanes contactVelocity = rx * normalX + normalY * ry;
+		Lanes denominator = effectiveMass(p, normalX, normalY);
+		Lanes m = (bounce * contactVelocity) / (denominator * points);
+
+		Lanes skip = Greater(contactVelocity, zero);
+		magnitude[p] = Select(skip, zero, m);
+		impulseX[p] = Select(skip, zero, normalX * m);
+		impulseY[p] = Select(skip, zero, normalY * m);
+	}
+
+	for (int p = 0; p < 2; p++) {
+		ApplyLaneImpulse(a, rax[p], ray[p], impulseX[p], impulseY[p], true, active[p]);
+		ApplyLaneImpulse(b, rbx[p], rby[p], impulseX[p], impulseY[p], false, active[p]);
+	}
+
+	float normalImpulse[W];
+	((magnitude[0] & active[0]) + (magnitude[1] & active[1])).Store(normalImpulse);
+
+	// Friction
+	Lanes smallSquared = Lanes::Set(FlatMath::SMALL_AMOUNT * FlatMath::SMALL_AMOUNT);
+	Lanes tiny = Lanes::Set(FlatScalar<float>::Tiny());
+	Lanes frictionX[2], frictionY[2];
+
+	for (int p = 0; p < 2; p++) {
+		Lanes rx, ry;
+		relativeVelocity(p, rx, ry);
+
+		Lanes normalVelocity = rx * normalX + normalY * ry;
+		Lanes tx = rx - normalX * normalVelocity;
+		Lanes ty = ry - normalY * normalVelocity;
+
+		Lanes lengthSquared = tx * tx + ty * ty;
+		Lanes skip = Less(lengthSquared, smallSquared);
+
+		Lanes length = Sqrt(lengthSquared);
+		Lanes degenerate = Less(length, tiny);
+		tx = Select(degenerate, zero, tx / length);
+		ty = Select(degenerate, zero, ty / length);
+
+		Lanes denominator = effectiveMass(p, tx, ty);
+		Lanes tangentMagnitude = (-(rx * tx + ty * ry)) / (denominator * points);
+
+		Lanes m = magnitude[p];
+		Lanes sticking = LessEqual(Abs(tangentMagnitude), m * sf);
+
+		Lanes fx = Select(sticking, tx * tangentMagnitude, (tx * (-m)) * df);
+		Lanes fy = Select(sticking, ty * tangentMagnitude, (ty * (-m)) * df);
+
+		frictionX[p] = Select(skip, zero, fx);
+		frictionY[p] = Select(skip, zero, fy);
+	}
+
+	for (int p = 0; p < 2; p++) {
+		ApplyLaneImpulse(a, rax[p], ray[p], frictionX[p], frictionY[p], true, active[p]);
+		ApplyLaneImpulse(b, rbx[p], rby[p], frictionX[p], frictionY[p], false, active[p]);
+	}
+
+	// scatter
+	for (int s = 0; s < 2; s++) {
+		bodies[s].vx.Store(body[s][0]);
+		bodies[s].vy.Store(body[s][1]);
+		bodies[s].w.Store(body[s][2]);
+	}
+
+	for (int l = 0; l < count; l++) {
+		FlatBody* scattered[2] = { group[l]->bodyA, group[l]->bodyB };
+		group[l]->normalImpulse = normalImpulse[l];
+
+		for (int s = 0; s < 2; s++) {
+			if (scattered[s]->b_IsStatic) continue;
+
+			scattered[s]->linearVelocity = FlatVector(body[s][0][l], body[s][1][l]);
+			scattered[s]->angularVelocity = body[s][2][l];
+		}
+	}
+}
+
+#else
+
+void FlatContactSolver::SolveWide(Constraint* const* group, const int& count) {
+	for (int i = 0; i < count; i++) {
+		SolveScalar(*group[i]);
+	}
+}
+
+#endif
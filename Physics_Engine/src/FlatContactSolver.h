@@ -0,0 +1,98 @@
+#pragma once
+
+#include "FlatBody.h"
+#include "FlatManifold.h"
+#include "FlatVector.h"
+#include <vector>
+
+// Velocity solver for contact manifolds: a normal impulse with restitution and a
+// Coulomb friction impulse per contact point, applied one manifold after another.
+// The wide path solves SIMD-width groups of manifolds that share no dynamic body
+// and gives the same result as the scalar one.
+//
+// The soft step functions solve the same constraints as soft springs with accumulated
+// impulses over several substeps (FlatWorld::SoftStep), scalar only.
+class FlatContactSolver {
+public:
+	enum Path {
+		Scalar = 0,
+		Wide = 1
+	};
+
+	// Spring and damping of a soft contact turned into solver coefficients for one substep
+	struct Softness {
+		float biasRate = 0.0f;
+		float massScale = 1.0f;
+		float impulseScale = 0.0f;
+
+		static Softness Make(const float& hertz, const float& dampingRatio, const float& h);
+	};
+
+	struct SoftPoint {
+		float baseSeparation = 0.0f; // separation minus the anchor offset along the normal
+		float normalMass = 0.0f;
+		float tangentMass = 0.0f;
+		float normalImpulse = 0.0f;  // accumulated over the step
+		float tangentImpulse = 0.0f;
+		float maxNormalImpulse = 0.0f;
+		float relativeVelocity = 0.0f; // along the normal, before solving
+	};
+
+	// Everything the solver needs from a manifold, taken right after its contact points
+	struct Constraint {
+		FlatBody* bodyA = nullptr;
+		FlatBody* bodyB = nullptr;
+		FlatVector normal;
+		FlatVector ra[2]; // contact points relative to the body centers
+		FlatVector rb[2];
+		int contactCount = 0;
+		float restitution = 0.0f;
+		float staticFriction = 0.0f;
+		float dynamicFriction = 0.0f;
+		FlatVector basePositionA; // body positions when the constraint was made
+		FlatVector basePositionB;
+		float normalImpulse = 0.0f; // summed over the points by the last SolveScalar/SolveWide
+
+		// soft step only
+		SoftPoint soft[2];
+		Softness softness;
+		float baseAngleA = 0.0f;
+		float baseAngleB = 0.0f;
+	};
+
+	// 8 with AVX2, 4 with SSE2, 1 when the wide path isn't compiled in
+	static const int WIDTH;
+
+	static const float MAX_PUSH_VELOCITY;      // m/s, cap on the soft push-out speed
+	static const float RESTITUTION_THRESHOLD;  // m/s, slower approaches don't bounce
+
+public:
+	static Constraint MakeConstraint(const FlatManifold& contact);
+
+	// Solves constraints [0, count) as if one after another. The wide path packs them
+	// into groups without shared dynamic bodies while keeping every body's constraint
+	// order. bodyGroups is scratch indexed by FlatWorld body index; only entries of
+	// the dynamic bodies in these constraints are touched.
+	static void Solve(Constraint* const* constraints, const int& count, const Path& path, std::vector<int>& bodyGroups);
+
+	// Same for constraints known to share no dynamic body, e.g. one graph color
+	static void SolveIndependent(Constraint* const* constraints, const int& count, const Path& path);
+
+	static void SolveScalar(Constraint& constraint);
+
+	// Soft step: PrepareSoft once per step after the contact points, then per substep
+	// WarmStart and SolveSoft with bias, the position update and SolveSoft without bias
+	// (relax); ApplyRestitution once at the end.
+	// separations holds the gap at each contact point, negative when overlapping.
+	// Accumulated impulses start at zero, the caller may seed them from the last step.
+	static void PrepareSoft(Constraint& constraint, const float* separations, const Softness& softness);
+	static void WarmStart(Constraint& constraint);
+	static void SolveSoft(Constraint& constraint, const float& h, const bool& b_UseBias);
+	static void ApplyRestitution(Constraint& constraint);
+
+private:
+	static void ApplyImpulse(Constraint& constraint, const int& point, const FlatVector& impulse);
+	static FlatVector RelativeVelocity(const Constraint& constraint, const int& point);
+
+	static void SolveWide(Constraint* const* group, const int& count);
+};
@@ -0,0 +1,321 @@
+#include "FlatDynamicTree.h"
+
+#include <algorithm>
+
+const float FlatDynamicTree::AABB_MARGIN = 0.1f;
+
+FlatDynamicTree::FlatDynamicTree() :
+	root(NULL_NODE),
+	freeList(NULL_NODE),
+	proxyCount(0)
+{}
+
+int FlatDynamicTree::AllocateNode() {
+	if (freeList == NULL_NODE) {
+		Node node;
+		node.body = nullptr;
+		node.parent = NULL_NODE;
+		node.child1 = NULL_NODE;
+		node.child2 = NULL_NODE;
+		node.height = -1;
+		nodes.push_back(node);
+		return (int)nodes.size() - 1;
+	}
+
+	int nodeId = freeList;
+	Node& node = nodes[nodeId];
+	freeList = node.parent;
+	node.body = nullptr;
+	node.parent = NULL_NODE;
+	node.child1 = NULL_NODE;
+	node.child2 = NULL_NODE;
+	node.height = 0;
+	return nodeId;
+}
+
+void FlatDynamicTree::FreeNode(const int& nodeId) {
+	nodes[nodeId].parent = freeList;
+	nodes[nodeId].height = -1;
+	nodes[nodeId].body = nullptr;
+	freeList = nodeId;
+}
+
+int FlatDynamicTree::CreateProxy(const FlatAABB& aabb, FlatBody* body) {
+	int proxyId = AllocateNode();
+	Node& node = nodes[proxyId];
+
+	node.lowerBound = FlatVector(aabb.min.x - AABB_MARGIN, aabb.min.y - AABB_MARGIN);
+	node.upperBound = FlatVector(aabb.max.x + AABB_MARGIN, aabb.max.y + AABB_MARGIN);
+	node.body = body;
+	node.height = 0;
+
+	InsertLeaf(proxyId);
+	proxyCount++;
+
+	return proxyId;
+}
+
+void FlatDynamicTree::DestroyProxy(const int& proxyId) {
+	if (proxyId < 0 || proxyId >= nodes.size() || !nodes[proxyId].IsLeaf()) {
+		__debugbreak();
+		return;
+	}
+
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+	proxyCount--;
+}
+
+bool FlatDynamicTree::MoveProxy(const int& proxyId, const FlatAABB& aabb) {
+	if (Contains(nodes[proxyId], aabb.min, aabb.max)) {
+		return false;
+	}
+
+	RemoveLeaf(proxyId);
+
+	Node& node = nodes[proxyId];
+	node.lowerBound = FlatVector(aabb.min.x - AABB_MARGIN, aabb.min.y - AABB_MARGIN);
+	node.upperBound = FlatVector(aabb.max.x + AABB_MARGIN, aabb.max.y + AABB_MARGIN);
+
+	InsertLeaf(proxyId);
+	return true;
+}
+
+void FlatDynamicTree::Clear() {
+	nodes.clear();
+	root = NULL_NODE;
+	freeList = NULL_NODE;
+	proxyCount = 0;
+}
+
+FlatBody* FlatDynamicTree::GetBody(const int& proxyId) const {
+	return nodes[proxyId].body;
+}
+
+FlatAABB FlatDynamicTree::GetFatAABB(const int& proxyId) const {
+	return FlatAABB(nodes[proxyId].lowerBound, nodes[proxyId].upperBound);
+}
+
+int FlatDynamicTree::GetHeight() const {
+	return root == NULL_NODE ? 0 : nodes[root].height;
+}
+
+size_t FlatDynamicTree::ProxyCount() const {
+	return proxyCount;
+}
+
+void FlatDynamicTree::InsertLeaf(const int& leaf) {
+	if (root == NULL_NODE) {
+		root = leaf;
+		nodes[root].parent = NULL_NODE;
+		return;
+	}
+
+	FlatVector leafLower = nodes[leaf].lowerBound;
+	FlatVector leafUpper = nodes[leaf].upperBound;
+
+	// Walk down picking the child with the cheapest perimeter growth
+	int index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+		int child1 = node.child1;
+		int child2 = node.child2;
+
+		float area = Perimeter(node.lowerBound, node.upperBound);
+		FlatVector combinedLower(std::min(node.lowerBound.x, leafLower.x), std::min(node.lowerBound.y, leafLower.y));
+		FlatVector combinedUpper(std::max(node.upperBound.x, leafUpper.x), std::max(node.upperBound.y, leafUpper.y));
+		float combinedArea = Perimeter(combinedLower, combinedUpper);
+
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](const int& child) {
+			const Node& c = nodes[child];
+			FlatVector lower(std::min(c.lowerBound.x, leafLower.x), std::min(c.lowerBound.y, leafLower.y));
+			FlatVector upper(std::max(c.upperBound.x, leafUpper.x), std::max(c.upperBound.y, leafUpper.y));
+			float growth = Perimeter(lower, upper);
+			if (!c.IsLeaf()) {
+				growth -= Perimeter(c.lowerBound, c.upperBound);
+			}
+			return growth + inheritanceCost;
+		};
+
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+
+		if (cost < cost1 && cost < cost2) break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+
+	Node& parentNode = nodes[newParent];
+	parentNode.parent = oldParent;
+	parentNode.body = nullptr;
+	parentNode.lowerBound = FlatVector(std::min(leafLower.x, nodes[sibling].lowerBound.x), std::min(leafLower.y, nodes[sibling].lowerBound.y));
+	parentNode.upperBound = FlatVector(std::max(leafUpper.x, nodes[sibling].upperBound.x), std::max(leafUpper.y, nodes[sibling].upperBound.y));
+	parentNode.height = nodes[sibling].height + 1;
+	parentNode.child1 = sibling;
+	parentNode.child2 = leaf;
+
+	if (oldParent != NULL_NODE) {
+		if (nodes[oldParent].child1 == sibling) {
+			nodes[oldParent].child1 = newParent;
+		}
+		else {
+			nodes[oldParent].child2 = newParent;
+		}
+	}
+	else {
+		root = newParent;
+	}
+
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	// Refit and rebalance the ancestors
+	index = nodes[leaf].parent;
+	while (index != NULL_NODE) {
+		index = Balance(index);
+
+		Node& node = nodes[index];
+		const Node& c1 = nodes[node.child1];
+		const Node& c2 = nodes[node.child2];
+
+		node.height = 1 + std::max(c1.height, c2.height);
+		node.lowerBound = FlatVector(std::min(c1.lowerBound.x, c2.lowerBound.x), std::min(c1.lowerBound.y, c2.lowerBound.y));
+		node.upperBound = FlatVector(std::max(c1.upperBound.x, c2.upperBound.x), std::max(c1.upperBound.y, c2.upperBound.y));
+
+		index = node.parent;
+	}
+}
+
+void FlatDynamicTree::RemoveLeaf(const int& leaf) {
+	if (leaf == root) {
+		root = NULL_NODE;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent == NULL_NODE) {
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+		FreeNode(parent);
+		return;
+	}
+
+	if (nodes[grandParent].child1 == parent) {
+		nodes[grandParent].child1 = sibling;
+	}
+	else {
+		nodes[grandParent].child2 = sibling;
+	}
+	nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	int index = grandParent;
+	while (index != NULL_NODE) {
+		index = Balance(index);
+
+		Node& node = nodes[index];
+		const Node& c1 = nodes[node.child1];
+		const Node& c2 = nodes[node.child2];
+
+		node.lowerBound = FlatVector(std::min(c1.lowerBound.x, c2.lowerBound.x), std::min(c1.lowerBound.y, c2.lowerBound.y));
+		node.upperBound = FlatVector(std::max(c1.upperBound.x, c2.upperBound.x), std::max(c1.upperBound.y, c2.upperBound.y));
+		node.height = 1 + std::max(c1.height, c2.height);
+
+		index = node.parent;
+	}
+}
+
+// Rotates A's taller grandchild up when the subtree is out of balance; returns the new subtree root.
+int FlatDynamicTree::Balance(const int& iA) {
+	Node& A = nodes[iA];
+	if (A.IsLeaf() || A.height < 2) {
+		return iA;
+	}
+
+	int iB = A.child1;
+	int iC = A.child2;
+	int balance = nodes[iC].height - nodes[iB].height;
+
+	auto refit = [this](const int& id) {
+		Node& n = nodes[id];
+		const Node& c1 = nodes[n.child1];
+		const Node& c2 = nodes[n.child2];
+		n.lowerBound = FlatVector(std::min(c1.lowerBound.x, c2.lowerBound.x), std::min(c1.lowerBound.y, c2.lowerBound.y));
+		n.upperBound = FlatVector(std::max(c1.upperBound.x, c2.upperBound.x), std::max(c1.upperBound.y, c2.upperBound.y));
+		n.height = 1 + std::max(c1.height, c2.height);
+	};
+
+	// Rotate child (the taller side) up over A
+	auto rotate = [&](const int& iUp, const bool& upIsChild2) {
+		Node& up = nodes[iUp];
+		int iF = up.child1;
+		int iG = up.child2;
+
+		up.child1 = iA;
+		up.parent = nodes[iA].parent;
+		nodes[iA].parent = iUp;
+
+		if (up.parent != NULL_NODE) {
+			if (nodes[up.parent].child1 == iA) {
+				nodes[up.parent].child1 = iUp;
+			}
+			else {
+				nodes[up.parent].child2 = iUp;
+			}
+		}
+		else {
+			root = iUp;
+		}
+
+		// keep the taller grandchild under up, hand the shorter one to A
+		int keep = nodes[iF].height > nodes[iG].height ? iF : iG;
+		int give = keep == iF ? iG : iF;
+
+		up.child2 = keep;
+		if (upIsChild2) {
+			nodes[iA].child2 = give;
+		}
+		else {
+			nodes[iA].child1 = give;
+		}
+		nodes[give].parent = iA;
+
+		refit(iA);
+		refit(iUp);
+		return iUp;
+	};
+
+	if (balance > 1) {
+		return rotate(iC, true);
+	}
+
+	if (balance < -1) {
+		return rotate(iB, false);
+	}
+
+	return iA;
+}
+
+bool FlatDynamicTree::Overlaps(const Node& node, const FlatVector& lower, const FlatVector& upper) {
+	return !(node.upperBound.x < lower.x || upper.x < node.lowerBound.x ||
+		node.upperBound.y < lower.y || upper.y < node.lowerBound.y);
+}
+
+bool FlatDynamicTree::Contains(const Node& node, const FlatVector& lower, const FlatVector& upper) {
+	return node.lowerBound.x <= lower.x && node.lowerBound.y <= lower.y &&
+		upper.x <= node.upperBound.x && upper.y <= node.upperBound.y;
+}
+
+float FlatDynamicTree::Perimeter(const FlatVector& lower, const FlatVector& upper) {
+	return 2.0f * ((upper.x - lower.x) + (upper.y - lower.y));
+}
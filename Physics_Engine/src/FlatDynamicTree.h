@@ -0,0 +1,159 @@
+#pragma once
+
+#include "FlatVector.h"
+#include "FlatAABB.h"
+#include <vector>
+#include <cmath>
+
+class FlatBody;
+
+// Bounding volume hierarchy of fat AABBs, one leaf (proxy) per body.
+// Leaves are only reinserted when a body leaves its fat AABB, so most
+// steps cost a containment check per moving body.
+class FlatDynamicTree {
+public:
+	static const int NULL_NODE = -1;
+	static const float AABB_MARGIN; // m
+
+private:
+	static const int STACK_SIZE = 256;
+
+	struct Node {
+		FlatVector lowerBound;
+		FlatVector upperBound;
+		FlatBody* body;
+		int parent; // next free node while on the free list
+		int child1;
+		int child2;
+		int height; // leaf = 0, free = -1
+
+		bool IsLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	std::vector<Node> nodes;
+	int root;
+	int freeList;
+	size_t proxyCount;
+
+public:
+	FlatDynamicTree();
+
+	int CreateProxy(const FlatAABB& aabb, FlatBody* body);
+	void DestroyProxy(const int& proxyId);
+	bool MoveProxy(const int& proxyId, const FlatAABB& aabb);
+	void Clear();
+
+	FlatBody* GetBody(const int& proxyId) const;
+	FlatAABB GetFatAABB(const int& proxyId) const;
+	int GetHeight() const;
+	size_t ProxyCount() const;
+
+	// callback(proxyId) returns false to stop the query
+	template<typename T>
+	void Query(const FlatAABB& aabb, T&& callback) const;
+
+	// callback(proxyId, maxFraction) returns the new max fraction:
+	// 0 stops the cast, a smaller value clips the ray, maxFraction continues
+	template<typename T>
+	void RayCast(const FlatVector& p1, const FlatVector& p2, T&& callback) const;
+
+private:
+	int AllocateNode();
+	void FreeNode(const int& nodeId);
+	void InsertLeaf(const int& leaf);
+	void RemoveLeaf(const int& leaf);
+	int Balance(const int& iA);
+
+	static bool Overlaps(const Node& node, const FlatVector& lower, const FlatVector& upper);
+	static bool Contains(const Node& node, const FlatVector& lower, const FlatVector& upper);
+	static float Perimeter(const FlatVector& lower, const FlatVector& upper);
+};
+
+template<typename T>
+void FlatDynamicTree::Query(const FlatAABB& aabb, T&& callback) const {
+	if (root == NULL_NODE) return;
+
+	int stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = root;
+
+	while (count > 0) {
+		int nodeId = stack[--count];
+		const Node& node = nodes[nodeId];
+
+		if (!Overlaps(node, aabb.min, aabb.max)) continue;
+
+		if (node.IsLeaf()) {
+			if (!callback(nodeId)) return;
+		}
+		else {
+			if (count + 2 > STACK_SIZE) {
+				__debugbreak();
+				return;
+			}
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
+
+template<typename T>
+void FlatDynamicTree::RayCast(const FlatVector& p1, const FlatVector& p2, T&& callback) const {
+	if (root == NULL_NODE) return;
+
+	FlatVector r = p2 - p1;
+	float length = std::sqrt(r.x * r.x + r.y * r.y);
+	if (length < 1e-6f) return;
+	r = r / length;
+
+	// separating axis of the segment: |dot(v, p1 - c)| > dot(|v|, h)
+	FlatVector v(-r.y, r.x);
+	FlatVector absV(std::abs(v.x), std::abs(v.y));
+
+	float maxFraction = 1.0f;
+
+	auto segmentBounds = [&](FlatVector& lower, FlatVector& upper) {
+		FlatVector t = p1 + maxFraction * (p2 - p1);
+		lower = FlatVector(std::min(p1.x, t.x), std::min(p1.y, t.y));
+		upper = FlatVector(std::max(p1.x, t.x), std::max(p1.y, t.y));
+	};
+
+	FlatVector segLower, segUpper;
+	segmentBounds(segLower, segUpper);
+
+	int stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = root;
+
+	while (count > 0) {
+		int nodeId = stack[--count];
+		const Node& node = nodes[nodeId];
+
+		if (!Overlaps(node, segLower, segUpper)) continue;
+
+		FlatVector c = (node.lowerBound + node.upperBound) * 0.5f;
+		FlatVector h = (node.upperBound - node.lowerBound) * 0.5f;
+		FlatVector d = p1 - c;
+		float separation = std::abs(v.x * d.x + v.y * d.y) - (absV.x * h.x + absV.y * h.y);
+		if (separation > 0.0f) continue;
+
+		if (node.IsLeaf()) {
+			float value = callback(nodeId, maxFraction);
+
+			if (value == 0.0f) return;
+
+			if (value > 0.0f && value < maxFraction) {
+				maxFraction = value;
+				segmentBounds(segLower, segUpper);
+			}
+		}
+		else {
+			if (count + 2 > STACK_SIZE) {
+				__debugbreak();
+				return;
+			}
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
@@ -1,6 +1,7 @@
 #include "FlatEntity.h"
 #include "Graphics.h"
 #include "FlatConverter.h"
+#include "FlatMath.h"
 
 FlatEntity::FlatEntity(FlatBody*& _body) :
     body(_body),
@@ -18,6 +19,7 @@ FlatEntity::FlatEntity(FlatWorld*& world, const float& radius, const bool& isSta
         __debugbreak();
     }
     body->MoveTo(position);
+    body->SetUserData(this);
     color = Graphics::GetRandomColor();
     world->AddBody(body);
 }
@@ -28,6 +30,7 @@ FlatEntity::FlatEntity(FlatWorld*& world, const float& width, const float& heigh
         __debugbreak(); 
     }
     body->MoveTo(position);
+    body->SetUserData(this);
     color = Graphics::GetRandomColor();
     world->AddBody(body);
 }
@@ -36,21 +39,74 @@ FlatEntity::~FlatEntity() {
     delete body;
 }
 
-void FlatEntity::Render(FlatBody::ShapeType shape) {
-    Vector2 pos = FlatConverter::ToVector2(body->GetPosition());
-    
-    if (body->shapeType == FlatBody::Box) {
-        Graphics::DrawBoxFill(pos, body->width, body->height, body->GetAngle(), color);
-        Graphics::DrawPolygonOutline(FlatConverter::ToVector2List(body->GetTransformVertices()), BLUE);
-    }
-    else if(body->shapeType == FlatBody::Circle) {
-        FlatVector va = { 0.0f, 0.0f };
-        FlatVector vb = { body->radius, 0.0f };
-        FlatTransform transform(body->GetPosition(), body->GetAngle());
-        va = FlatVector::Transform(va, transform);
-        vb = FlatVector::Transform(vb, transform);
-
-        Graphics::DrawCircleFull(pos, body->radius, color, BLUE);
+void FlatEntity::Capture(std::vector<RenderSnapshot::Piece>& pieces) const {
+    RenderSnapshot::Piece piece;
+    piece.position = body->GetPosition();
+    piece.angle = body->GetAngle();
+    piece.color = color;
+
+    if (body->shapeType == FlatBody::Chain) {
+        piece.type = FlatBody::Segment;
+        piece.height = 0.0f;
+        piece.radius = 0.0f;
+
+        for (int i = 0; i < body->FixtureCount(); i++) {
+            FlatBody::FixtureGeometry segment = body->GetFixture(i);
+            FlatVector edge = segment.points[2] - segment.points[1];
+
+            piece.position = segment.center;
+            piece.angle = std::atan2(edge.y, edge.x);
+            piece.width = FlatMath::Length(edge);
+            pieces.push_back(piece);
+        }
+        return;
+    }
+
+    if (body->shapeType != FlatBody::Compound) {
+        piece.type = body->shapeType;
+        piece.width = body->shape->width;
+        piece.height = body->shape->height;
+        piece.radius = body->shape->radius;
+        pieces.push_back(piece);
+        return;
+    }
+
+    FlatTransform transform(body->GetPosition(), body->GetAngle());
+    for (auto& fixture : body->shape->fixtures) {
+        piece.type = fixture.shape->type;
+        piece.position = FlatVector::Transform(fixture.offset, transform);
+        piece.angle = body->GetAngle() + fixture.angle;
+        piece.width = fixture.shape->width;
+        piece.height = fixture.shape->height;
+        piece.radius = fixture.shape->radius;
+        pieces.push_back(piece);
+    }
+}
+
+void FlatEntity::Render(const RenderSnapshot::Piece& piece) {
+    Vector2 pos = FlatConverter::ToVector2(piece.position);
+    FlatTransform transform(piece.position, piece.angle);
+
+    if (piece.type == FlatBody::Box) {
+        std::vector<FlatVector> vertices = FlatShape::CreateBoxVertices(piece.width, piece.height);
+        for (auto& v : vertices) {
+            v = FlatVector::Transform(v, transform);
+        }
+
+        Graphics::DrawBoxFill(pos, piece.width, piece.height, piece.angle, piece.color);
+        Graphics::DrawPolygonOutline(FlatConverter::ToVector2List(vertices), BLUE);
+    }
+    else if (piece.type == FlatBody::Circle) {
+        FlatVector va = FlatVector::Transform(FlatVector(0.0f, 0.0f), transform);
+        FlatVector vb = FlatVector::Transform(FlatVector(piece.radius, 0.0f), transform);
+
+        Graphics::DrawCircleFull(pos, piece.radius, piece.color, BLUE);
         DrawLineEx(FlatConverter::ToVector2(va), FlatConverter::ToVector2(vb), 0.1f, RED);
     }
-}
\ No newline at end of file
+    else if (piece.type == FlatBody::Segment) {
+        FlatVector va = FlatVector::Transform(FlatVector(-0.5f * piece.width, 0.0f), transform);
+        FlatVector vb = FlatVector::Transform(FlatVector(0.5f * piece.width, 0.0f), transform);
+
+        DrawLineEx(FlatConverter::ToVector2(va), FlatConverter::ToVector2(vb), RenderSnapshot::Piece::SEGMENT_THICKNESS, piece.color);
+    }
+}
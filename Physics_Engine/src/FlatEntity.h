@@ -4,6 +4,7 @@
 #include "raylib.h"
 #include "FlatBody.h"
 #include "FlatWorld.h"
+#include "RenderSnapshot.h"
 
 class FlatEntity final {
 public:
@@ -19,5 +20,9 @@ public:
 
 	~FlatEntity();
 
-	void Render(FlatBody::ShapeType shape);
+	// Appends the body's pieces at its current transform, on the simulation thread
+	void Capture(std::vector<RenderSnapshot::Piece>& pieces) const;
+
+	// The per-entity draw path: raylib shape calls for one piece
+	static void Render(const RenderSnapshot::Piece& piece);
 };
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "FlatScalar.h"
+#include <cstdint>
+#include <cmath>
+
+// 16.16 fixed point for lockstep games: every operation is integer arithmetic, so
+// results are bit-identical across compilers and CPUs. Range is about +-32767 with
+// a resolution of 1/65536; products of large values (squared lengths over 181) overflow.
+// Use as FlatVectorT<FlatFixed> / FlatMathT<FlatFixed>.
+class FlatFixed {
+public:
+	static constexpr int FRACTION_BITS = 16;
+	static constexpr int32_t ONE = 1 << FRACTION_BITS;
+
+	int32_t raw;
+
+public:
+	constexpr FlatFixed() : raw(0) {}
+	explicit constexpr FlatFixed(int value) : raw(value * ONE) {}
+	explicit FlatFixed(float value) : raw((int32_t)std::lround(value * (float)ONE)) {}
+	explicit FlatFixed(double value) : raw((int32_t)std::lround(value * (double)ONE)) {}
+
+	static constexpr FlatFixed FromRaw(const int32_t& raw) {
+		FlatFixed f;
+		f.raw = raw;
+		return f;
+	}
+
+	float ToFloat() const { return (float)raw / (float)ONE; }
+	double ToDouble() const { return (double)raw / (double)ONE; }
+
+	friend FlatFixed operator +(const FlatFixed& a, const FlatFixed& b) { return FromRaw(a.raw + b.raw); }
+	friend FlatFixed operator -(const FlatFixed& a, const FlatFixed& b) { return FromRaw(a.raw - b.raw); }
+
+	friend FlatFixed operator *(const FlatFixed& a, const FlatFixed& b) {
+		return FromRaw((int32_t)(((int64_t)a.raw * b.raw) >> FRACTION_BITS));
+	}
+
+	friend FlatFixed operator /(const FlatFixed& a, const FlatFixed& b) {
+		if (b.raw == 0) {
+			__debugbreak();
+			return FlatFixed();
+		}
+		return FromRaw((int32_t)(((int64_t)a.raw * ONE) / b.raw));
+	}
+
+	FlatFixed operator -() const { return FromRaw(-raw); }
+
+	FlatFixed& operator +=(const FlatFixed& other) { return *this = *this + other; }
+	FlatFixed& operator -=(const FlatFixed& other) { return *this = *this - other; }
+	FlatFixed& operator *=(const FlatFixed& other) { return *this = *this * other; }
+	FlatFixed& operator /=(const FlatFixed& other) { return *this = *this / other; }
+
+	bool operator ==(const FlatFixed& other) const { return raw == other.raw; }
+	bool operator !=(const FlatFixed& other) const { return raw != other.raw; }
+	bool operator <(const FlatFixed& other) const { return raw < other.raw; }
+	bool operator >(const FlatFixed& other) const { return raw > other.raw; }
+	bool operator <=(const FlatFixed& other) const { return raw <= other.raw; }
+	bool operator >=(const FlatFixed& other) const { return raw >= other.raw; }
+};
+
+template<>
+struct FlatScalar<FlatFixed> {
+	static constexpr int32_t PI_RAW = 205887;       // pi * 65536
+	static constexpr int32_t HALF_PI_RAW = 102944;
+	static constexpr int32_t TWO_PI_RAW = 411775;
+
+	static FlatFixed Sqrt(const FlatFixed& value) {
+		if (value.raw <= 0) return FlatFixed();
+
+		// floor(sqrt(raw << 16)). The double estimate is corrected to the exact
+		// integer root, so the result doesn't depend on the FPU.
+		uint64_t n = (uint64_t)value.raw << FlatFixed::FRACTION_BITS;
+		uint64_t result = (uint64_t)std::sqrt((double)n);
+
+		while (result * result > n) result--;
+		while ((result + 1) * (result + 1) <= n) result++;
+
+		return FlatFixed::FromRaw((int32_t)result);
+	}
+
+	static FlatFixed Sin(const FlatFixed& value) {
+		int32_t a = value.raw % TWO_PI_RAW;
+		if (a > PI_RAW) a -= TWO_PI_RAW;
+		if (a < -PI_RAW) a += TWO_PI_RAW;
+
+		// sin(pi - x) = sin(x) folds the angle into [-pi/2, pi/2]
+		if (a > HALF_PI_RAW) a = PI_RAW - a;
+		if (a < -HALF_PI_RAW) a = -PI_RAW - a;
+
+		// Taylor series to x^9 in Horner form, within a few units of the 16.16 resolution
+		FlatFixed x = FlatFixed::FromRaw(a);
+		FlatFixed x2 = x * x;
+		FlatFixed one(1);
+
+		FlatFixed series = one - x2 / FlatFixed(72);
+		series = one - x2 / FlatFixed(42) * series;
+		series = one - x2 / FlatFixed(20) * series;
+		series = one - x2 / FlatFixed(6) * series;
+		return x * series;
+	}
+
+	static FlatFixed Cos(const FlatFixed& value) {
+		return Sin(FlatFixed::FromRaw(value.raw % TWO_PI_RAW + HALF_PI_RAW));
+	}
+
+	static FlatFixed Abs(const FlatFixed& value) {
+		return value.raw < 0 ? -value : value;
+	}
+
+	static FlatFixed Tiny() {
+		return FlatFixed::FromRaw(1);
+	}
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+// SIMD lanes of floats for the wide kernels: 8 with AVX2, 4 with SSE2. FLAT_WIDE_LANES is 1
+// and FlatLanes doesn't exist when neither is compiled in, callers keep a scalar path for that.
+// Every operation is the IEEE single-precision one scalar code uses, so a lane computes
+// exactly what the scalar expression would.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FLAT_WIDE_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_WIDE_LANES 4
+#else
+#define FLAT_WIDE_LANES 1
+#endif
+
+#if FLAT_WIDE_LANES == 8
+struct FlatLanes {
+	__m256 v;
+
+	static FlatLanes Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+	static FlatLanes Set(const float& f) { return { _mm256_set1_ps(f) }; }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline FlatLanes operator +(const FlatLanes& a, const FlatLanes& b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline FlatLanes operator -(const FlatLanes& a, const FlatLanes& b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline FlatLanes operator *(const FlatLanes& a, const FlatLanes& b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline FlatLanes operator /(const FlatLanes& a, const FlatLanes& b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline FlatLanes operator -(const FlatLanes& a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+inline FlatLanes operator &(const FlatLanes& a, const FlatLanes& b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline FlatLanes operator |(const FlatLanes& a, const FlatLanes& b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline FlatLanes Sqrt(const FlatLanes& a) { return { _mm256_sqrt_ps(a.v) }; }
+inline FlatLanes Abs(const FlatLanes& a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline FlatLanes Less(const FlatLanes& a, const FlatLanes& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline FlatLanes Greater(const FlatLanes& a, const FlatLanes& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline FlatLanes LessEqual(const FlatLanes& a, const FlatLanes& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline FlatLanes Select(const FlatLanes& mask, const FlatLanes& a, const FlatLanes& b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+inline FlatLanes Min(const FlatLanes& a, const FlatLanes& b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline FlatLanes Max(const FlatLanes& a, const FlatLanes& b) { return { _mm256_max_ps(a.v, b.v) }; }
+#elif FLAT_WIDE_LANES == 4
+struct FlatLanes {
+	__m128 v;
+
+	static FlatLanes Load(const float* p) { return { _mm_loadu_ps(p) }; }
+	static FlatLanes Set(const float& f) { return { _mm_set1_ps(f) }; }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline FlatLanes operator +(const FlatLanes& a, const FlatLanes& b) { return { _mm_add_ps(a.v, b.v) }; }
+inline FlatLanes operator -(const FlatLanes& a, const FlatLanes& b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline FlatLanes operator *(const FlatLanes& a, const FlatLanes& b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline FlatLanes operator /(const FlatLanes& a, const FlatLanes& b) { return { _mm_div_ps(a.v, b.v) }; }
+inline FlatLanes operator -(const FlatLanes& a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+inline FlatLanes operator &(const FlatLanes& a, const FlatLanes& b) { return { _mm_and_ps(a.v, b.v) }; }
+inline FlatLanes operator |(const FlatLanes& a, const FlatLanes& b) { return { _mm_or_ps(a.v, b.v) }; }
+inline FlatLanes Sqrt(const FlatLanes& a) { return { _mm_sqrt_ps(a.v) }; }
+inline FlatLanes Abs(const FlatLanes& a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline FlatLanes Less(const FlatLanes& a, const FlatLanes& b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline FlatLanes Greater(const FlatLanes& a, const FlatLanes& b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline FlatLanes LessEqual(const FlatLanes& a, const FlatLanes& b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline FlatLanes Select(const FlatLanes& mask, const FlatLanes& a, const FlatLanes& b) {
+	return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+inline FlatLanes Min(const FlatLanes& a, const FlatLanes& b) { return { _mm_min_ps(a.v, b.v) }; }
+inline FlatLanes Max(const FlatLanes& a, const FlatLanes& b) { return { _mm_max_ps(a.v, b.v) }; }
+#endif
+
+#if FLAT_WIDE_LANES > 1
+// Lanes added up one after another from lane 0, the same order on every run
+inline float Sum(const FlatLanes& a) {
+	float lanes[FLAT_WIDE_LANES];
+	a.Store(lanes);
+
+	float sum = 0.0f;
+	for (int i = 0; i < FLAT_WIDE_LANES; i++) {
+		sum += lanes[i];
+	}
+	return sum;
+}
+#endif
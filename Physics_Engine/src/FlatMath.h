@@ -1,22 +1,67 @@
 #pragma once
 
 #include "FlatVector.h"
+#include "FlatScalar.h"
 
-class FlatMath {
+template<typename T>
+class FlatMathT {
 public:
-	static const float SMALL_AMOUNT; 
+	static inline const T SMALL_AMOUNT = T(0.0005f); // 1/2 of a milimeter
 
 public:
-	static float Clamp(float& value, const float& min, const float& max);
-	static int Clamp(int& value, const int& min, const int& max);
-
-	static float Length(const FlatVector& v);
-	static float LengthSquared(const FlatVector& v);
-	static float Distance(const FlatVector& a, const FlatVector& b);
-	static float DistanceSquared(const FlatVector& a, const FlatVector& b);
-	static FlatVector Normalize(const FlatVector& v);
-	static float Dot(const FlatVector& a, const FlatVector& b);
-	static float Cross(const FlatVector& a, const FlatVector& b);
-	static bool NearlyEqual(const float& a, const float& b);
-	static bool NearlyEqual(const FlatVector& a, const FlatVector& b);
+	static T Clamp(T& value, const T& min, const T& max) {
+		if (min == max) return min;
+		if (min > value) return min;
+		if (max < value) return max;
+		return value;
+	}
+
+	static int Clamp(int& value, const int& min, const int& max) {
+		if (min == max) return min;
+		if (min > value) return min;
+		if (max < value) return max;
+		return value;
+	}
+
+	static T Length(const FlatVectorT<T>& v) {
+		return FlatScalar<T>::Sqrt(v.x * v.x + v.y * v.y);
+	}
+
+	static T LengthSquared(const FlatVectorT<T>& v) {
+		return v.x * v.x + v.y * v.y;
+	}
+
+	static T Distance(const FlatVectorT<T>& a, const FlatVectorT<T>& b) {
+		FlatVectorT<T> d = a - b;
+		return FlatScalar<T>::Sqrt(d.x * d.x + d.y * d.y);
+	}
+
+	static T DistanceSquared(const FlatVectorT<T>& a, const FlatVectorT<T>& b) {
+		FlatVectorT<T> d = a - b;
+		return d.x * d.x + d.y * d.y;
+	}
+
+	static FlatVectorT<T> Normalize(const FlatVectorT<T>& v) {
+		T magnitude = Length(v);
+		if (magnitude < FlatScalar<T>::Tiny()) return FlatVectorT<T>(); // Avoid division by near-zero
+		return FlatVectorT<T>(v.x / magnitude, v.y / magnitude);
+	}
+
+	static T Dot(const FlatVectorT<T>& a, const FlatVectorT<T>& b) {
+		return a.x * b.x + b.y * a.y;
+	}
+
+	static T Cross(const FlatVectorT<T>& a, const FlatVectorT<T>& b) {
+		return a.x * b.y - a.y * b.x;
+	}
+
+	static bool NearlyEqual(const T& a, const T& b) {
+		return FlatScalar<T>::Abs(a - b) < SMALL_AMOUNT;
+	}
+
+	static bool NearlyEqual(const FlatVectorT<T>& a, const FlatVectorT<T>& b) {
+		return DistanceSquared(a, b) < SMALL_AMOUNT * SMALL_AMOUNT;
+	}
 };
+
+using FlatMath = FlatMathT<float>;
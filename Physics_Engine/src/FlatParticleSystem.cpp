@@ -0,0 +1,540 @@
+#include "FlatParticleSystem.h"
+#include "FlatLanes.h"
+#include "Collisions.h"
+#include "FlatMath.h"
+#include "Def.h"
+
+#include <cmath>
+#include <cfloat>
+
+static float ParticleMass(const float& radius, const float& density) {
+	float area = radius * radius * PI;
+	return area * density;
+}
+
+FlatParticleSystem::FlatParticleSystem(const float& _radius, const float& _density) :
+	radius(_radius),
+	density(_density),
+	mass(ParticleMass(_radius, _density)),
+	iterations(DEFAULT_ITERATIONS),
+	count(0),
+	cellSize(2.0f * _radius),
+	gridWidth(0),
+	gridHeight(0),
+	gridChunkCount(1),
+	gridChunkSize(0)
+{}
+
+void FlatParticleSystem::SetRadius(const float& _radius) {
+	if (_radius == radius) return;
+
+	Clear();
+	radius = _radius;
+	mass = ParticleMass(radius, density);
+}
+
+float FlatParticleSystem::GetRadius() const {
+	return radius;
+}
+
+void FlatParticleSystem::SetDensity(const float& _density) {
+	density = _density;
+	mass = ParticleMass(radius, density);
+}
+
+float FlatParticleSystem::GetDensity() const {
+	return density;
+}
+
+void FlatParticleSystem::SetIterations(const int& _iterations) {
+	iterations = std::max(1, _iterations);
+}
+
+int FlatParticleSystem::GetIterations() const {
+	return iterations;
+}
+
+void FlatParticleSystem::AddParticle(const FlatVector& position, const FlatVector& velocity) {
+	int particle = count;
+	Resize(count + 1);
+
+	positionX[particle] = position.x;
+	positionY[particle] = position.y;
+	velocityX[particle] = velocity.x;
+	velocityY[particle] = velocity.y;
+}
+
+void FlatParticleSystem::Clear() {
+	Resize(0);
+}
+
+int FlatParticleSystem::Count() const {
+	return count;
+}
+
+FlatVector FlatParticleSystem::GetPosition(const int& particle) const {
+	return FlatVector(positionX[particle], positionY[particle]);
+}
+
+FlatVector FlatParticleSystem::GetVelocity(const int& particle) const {
+	return FlatVector(velocityX[particle], velocityY[particle]);
+}
+
+const float* FlatParticleSystem::GetPositionsX() const {
+	return positionX.data();
+}
+
+const float* FlatParticleSystem::GetPositionsY() const {
+	return positionY.data();
+}
+
+void FlatParticleSystem::Step(const FlatVector& gravity, const float& dt, const std::vector<FlatBody*>& bodies,
+	FlatThreadPool* pool, const FlatAABB* bounds) {
+	if (count == 0) return;
+
+	float h = dt / iterations;
+
+	for (int it = 0; it < iterations; it++) {
+		ForEach(pool, [&](int begin, int end) { Predict(gravity, h, begin, end); });
+		BuildGrid(pool);
+		ForEach(pool, [&](int begin, int end) { Solve(begin, end); });
+		ForEach(pool, [&](int begin, int end) { Correct(h, begin, end); });
+		CollideBodies(bodies, pool);
+	}
+
+	if (bounds) RemoveEscaped(*bounds);
+}
+
+void FlatParticleSystem::ShiftOrigin(const FlatVector& newOrigin) {
+	for (int i = 0; i < count; i++) {
+		positionX[i] -= newOrigin.x;
+		positionY[i] -= newOrigin.y;
+	}
+}
+
+void FlatParticleSystem::Resize(const int& size) {
+	count = size;
+
+	int padded = size + FLAT_WIDE_LANES - 1;
+	positionX.resize(padded);
+	positionY.resize(padded);
+	velocityX.resize(padded);
+	velocityY.resize(padded);
+	particleCell.resize(size);
+	scratchX.resize(padded);
+	scratchY.resize(padded);
+	scratchVelocityX.resize(padded);
+	scratchVelocityY.resize(padded);
+	deltaX.resize(size);
+	deltaY.resize(size);
+}
+
+void FlatParticleSystem::ForEach(FlatThreadPool* pool, const FlatThreadPool::Task& task) const {
+	if (pool && count > CHUNK_SIZE) {
+		pool->ParallelFor(count, CHUNK_SIZE, task);
+	}
+	else {
+		task(0, count);
+	}
+}
+
+void FlatParticleSystem::Predict(const FlatVector& gravity, const float& dt, const int& begin, const int& end) {
+	for (int i = begin; i < end; i++) {
+		velocityX[i] += gravity.x * dt;
+		velocityY[i] += gravity.y * dt;
+		positionX[i] += velocityX[i] * dt;
+		positionY[i] += velocityY[i] * dt;
+	}
+}
+
+void FlatParticleSystem::BuildGrid(FlatThreadPool* pool) {
+	gridChunkCount = 1;
+	if (pool && count > CHUNK_SIZE) {
+		gridChunkCount = std::min(pool->ThreadCount(), (count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	}
+	gridChunkSize = (count + gridChunkCount - 1) / gridChunkCount;
+
+	chunkMin.resize(gridChunkCount);
+	chunkMax.resize(gridChunkCount);
+	ForEachGridChunk(pool, [&](int chunk) {
+		float minX = FLT_MAX, minY = FLT_MAX;
+		float maxX = -FLT_MAX, maxY = -FLT_MAX;
+		int end = std::min(count, (chunk + 1) * gridChunkSize);
+		for (int i = chunk * gridChunkSize; i < end; i++) {
+			minX = std::min(minX, positionX[i]);
+			minY = std::min(minY, positionY[i]);
+			maxX = std::max(maxX, positionX[i]);
+			maxY = std::max(maxY, positionY[i]);
+		}
+		chunkMin[chunk] = FlatVector(minX, minY);
+		chunkMax[chunk] = FlatVector(maxX, maxY);
+	});
+
+	float minX = FLT_MAX, minY = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int k = 0; k < gridChunkCount; k++) {
+		minX = std::min(minX, chunkMin[k].x);
+		minY = std::min(minY, chunkMin[k].y);
+		maxX = std::max(maxX, chunkMax[k].x);
+		maxY = std::max(maxY, chunkMax[k].y);
+	}
+
+	// one diameter per cell keeps every overlapping neighbour in the 3x3 cells around a particle
+	cellSize = 2.0f * radius;
+	double cells = (std::floor((maxX - minX) / cellSize) + 1.0) * (std::floor((maxY - minY) / cellSize) + 1.0);
+	if (cells > MAX_GRID_CELLS) {
+		cellSize *= (float)std::sqrt(cells / MAX_GRID_CELLS) * 1.01f;
+	}
+
+	gridOrigin = FlatVector(minX, minY);
+	gridWidth = (int)((maxX - minX) / cellSize) + 1;
+	gridHeight = (int)((maxY - minY) / cellSize) + 1;
+
+	float invCellSize = 1.0f / cellSize;
+	int cellCount = gridWidth * gridHeight;
+	cellStart.resize(cellCount + 1);
+
+	// the chunks keep their bounds, but count cells in one array per chunk
+	if (gridChunkCount > 1 && (double)cellCount * gridChunkCount > MAX_GRID_COUNTERS) {
+		int chunks = std::max(1, MAX_GRID_COUNTERS / cellCount);
+		gridChunkSize = (count + chunks - 1) / chunks;
+		gridChunkCount = (count + gridChunkSize - 1) / gridChunkSize;
+	}
+	cellCursor.resize((size_t)gridChunkCount * cellCount);
+
+	ForEachGridChunk(pool, [&](int chunk) {
+		int* counts = &cellCursor[(size_t)chunk * cellCount];
+		std::fill(counts, counts + cellCount, 0);
+
+		int end = std::min(count, (chunk + 1) * gridChunkSize);
+		for (int i = chunk * gridChunkSize; i < end; i++) {
+			int cx = std::min((int)((positionX[i] - minX) * invCellSize), gridWidth - 1);
+			int cy = std::min((int)((positionY[i] - minY) * invCellSize), gridHeight - 1);
+			particleCell[i] = cy * gridWidth + cx;
+			counts[particleCell[i]]++;
+		}
+	});
+
+	// exclusive prefix sum over (cell, chunk), in one block of cells per chunk: block totals,
+	// their offsets, then each block turns its counts into where the chunks' particles go
+	int blockSize = (cellCount + gridChunkCount - 1) / gridChunkCount;
+	blockStart.resize(gridChunkCount + 1);
+	ForEachGridChunk(pool, [&](int block) {
+		int total = 0;
+		int end = std::min(cellCount, (block + 1) * blockSize);
+		for (int c = block * blockSize; c < end; c++) {
+			for (int k = 0; k < gridChunkCount; k++) {
+				total += cellCursor[(size_t)k * cellCount + c];
+			}
+		}
+		blockStart[block + 1] = total;
+	});
+
+	blockStart[0] = 0;
+	for (int b = 0; b < gridChunkCount; b++) {
+		blockStart[b + 1] += blockStart[b];
+	}
+
+	ForEachGridChunk(pool, [&](int block) {
+		int offset = blockStart[block];
+		int end = std::min(cellCount, (block + 1) * blockSize);
+		for (int c = block * blockSize; c < end; c++) {
+			cellStart[c] = offset;
+			for (int k = 0; k < gridChunkCount; k++) {
+				int& cursor = cellCursor[(size_t)k * cellCount + c];
+				int particles = cursor;
+				cursor = offset;
+				offset += particles;
+			}
+		}
+	});
+	cellStart[cellCount] = count;
+
+	// stable counting sort: row-major cells, particles of a cell in their previous order, as the
+	// chunks are in particle order
+	ForEachGridChunk(pool, [&](int chunk) {
+		int* cursors = &cellCursor[(size_t)chunk * cellCount];
+		int end = std::min(count, (chunk + 1) * gridChunkSize);
+		for (int i = chunk * gridChunkSize; i < end; i++) {
+			int k = cursors[particleCell[i]]++;
+			scratchX[k] = positionX[i];
+			scratchY[k] = positionY[i];
+			scratchVelocityX[k] = velocityX[i];
+			scratchVelocityY[k] = velocityY[i];
+		}
+	});
+
+	positionX.swap(scratchX);
+	positionY.swap(scratchY);
+	velocityX.swap(scratchVelocityX);
+	velocityY.swap(scratchVelocityY);
+}
+
+void FlatParticleSystem::ForEachGridChunk(FlatThreadPool* pool, const std::function<void(int chunk)>& task) const {
+	if (gridChunkCount == 1) {
+		task(0);
+		return;
+	}
+
+	pool->ParallelFor(gridChunkCount, 1, [&](int begin, int end) {
+		for (int chunk = begin; chunk < end; chunk++) {
+			task(chunk);
+		}
+	});
+}
+
+void FlatParticleSystem::Solve(const int& begin, const int& end) {
+	const float diameter = 2.0f * radius;
+	const float diameterSquared = diameter * diameter;
+
+#if FLAT_WIDE_LANES > 1
+	static const float laneIndex[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+	const FlatLanes lanes = FlatLanes::Load(laneIndex);
+	const FlatLanes zero = FlatLanes::Set(0.0f);
+	const FlatLanes wideDiameter = FlatLanes::Set(diameter);
+	const FlatLanes wideDiameterSquared = FlatLanes::Set(diameterSquared);
+#endif
+
+	float invCellSize = 1.0f / cellSize;
+
+	for (int i = begin; i < end; i++) {
+		float x = positionX[i];
+		float y = positionY[i];
+
+		// the same cell BuildGrid found, without an integer division
+		int cx = std::min((int)((x - gridOrigin.x) * invCellSize), gridWidth - 1);
+		int cy = std::min((int)((y - gridOrigin.y) * invCellSize), gridHeight - 1);
+		int x0 = std::max(cx - 1, 0);
+		int x1 = std::min(cx + 1, gridWidth - 1);
+		int y0 = std::max(cy - 1, 0);
+		int y1 = std::min(cy + 1, gridHeight - 1);
+
+		float sumX = 0.0f;
+		float sumY = 0.0f;
+
+#if FLAT_WIDE_LANES > 1
+		FlatLanes wideX = FlatLanes::Set(x);
+		FlatLanes wideY = FlatLanes::Set(y);
+		FlatLanes wideSumX = zero;
+		FlatLanes wideSumY = zero;
+#endif
+
+		// the three cells of a row are contiguous in the sorted arrays
+		for (int row = y0; row <= y1; row++) {
+			int first = cellStart[row * gridWidth + x0];
+			int last = cellStart[row * gridWidth + x1 + 1];
+
+#if FLAT_WIDE_LANES > 1
+			for (int j = first; j < last; j += FLAT_WIDE_LANES) {
+				FlatLanes dx = wideX - FlatLanes::Load(&positionX[j]);
+				FlatLanes dy = wideY - FlatLanes::Load(&positionY[j]);
+				FlatLanes distanceSquared = dx * dx + dy * dy;
+
+				// lanes past the row, the particle itself and exact duplicates drop out
+				FlatLanes mask = Less(lanes, FlatLanes::Set((float)(last - j))) &
+					Less(distanceSquared, wideDiameterSquared) & Greater(distanceSquared, zero);
+
+				FlatLanes distance = Sqrt(distanceSquared);
+				FlatLanes push = (wideDiameter - distance) / distance;
+				wideSumX = wideSumX + Select(mask, dx * push, zero);
+				wideSumY = wideSumY + Select(mask, dy * push, zero);
+			}
+#else
+			for (int j = first; j < last; j++) {
+				float dx = x - positionX[j];
+				float dy = y - positionY[j];
+				float distanceSquared = dx * dx + dy * dy;
+
+				if (distanceSquared < diameterSquared && distanceSquared > 0.0f) {
+					float distance = std::sqrt(distanceSquared);
+					float push = (diameter - distance) / distance;
+					sumX += dx * push;
+					sumY += dy * push;
+				}
+			}
+#endif
+		}
+
+#if FLAT_WIDE_LANES > 1
+		sumX = Sum(wideSumX);
+		sumY = Sum(wideSumY);
+#endif
+
+		deltaX[i] = sumX * RELAXATION;
+		deltaY[i] = sumY * RELAXATION;
+	}
+}
+
+void FlatParticleSystem::Correct(const float& dt, const int& begin, const int& end) {
+	float invDt = 1.0f / dt;
+	float maxSpeedSquared = MAX_SEPARATION_SPEED * MAX_SEPARATION_SPEED;
+
+	for (int i = begin; i < end; i++) {
+		positionX[i] += deltaX[i];
+		positionY[i] += deltaY[i];
+
+		// a particle squeezed against a body can be corrected far in one substep; only part
+		// of that may turn into velocity, or it's shot out of the pile
+		FlatVector velocity(deltaX[i] * invDt, deltaY[i] * invDt);
+		float speedSquared = FlatMath::LengthSquared(velocity);
+		if (speedSquared > maxSpeedSquared) {
+			velocity = velocity * (MAX_SEPARATION_SPEED / std::sqrt(speedSquared));
+		}
+
+		velocityX[i] += velocity.x;
+		velocityY[i] += velocity.y;
+	}
+}
+
+void FlatParticleSystem::CollideBodies(const std::vector<FlatBody*>& bodies, FlatThreadPool* pool) {
+	float invCellSize = 1.0f / cellSize;
+
+	contactBodies.clear();
+	for (auto& body : bodies) {
+		FlatAABB aabb = body->GetAABB();
+		ContactBody contact;
+		contact.body = body;
+		contact.boxMin = FlatVector(aabb.min.x - radius, aabb.min.y - radius);
+		contact.boxMax = FlatVector(aabb.max.x + radius, aabb.max.y + radius);
+
+		int x0 = (int)std::floor((contact.boxMin.x - gridOrigin.x) * invCellSize);
+		int x1 = (int)std::floor((contact.boxMax.x - gridOrigin.x) * invCellSize);
+		int y0 = (int)std::floor((contact.boxMin.y - gridOrigin.y) * invCellSize);
+		int y1 = (int)std::floor((contact.boxMax.y - gridOrigin.y) * invCellSize);
+
+		if (x1 < 0 || y1 < 0 || x0 >= gridWidth || y0 >= gridHeight) continue;
+
+		contact.x0 = std::max(x0, 0);
+		contact.y0 = std::max(y0, 0);
+		contact.x1 = std::min(x1, gridWidth - 1);
+		contact.y1 = std::min(y1, gridHeight - 1);
+
+		// the chunks only read the body, its transformed fixtures have to be ready
+		body->UpdateTransformVertices();
+		contactBodies.push_back(contact);
+	}
+
+	if (contactBodies.empty()) return;
+
+	// chunks of CHUNK_SIZE however many threads there are, so the sums below add up the same
+	chunkImpulses.resize((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	ForEach(pool, [&](int begin, int end) {
+		// chunks must start on a multiple of the chunk size, the pool may hand out larger ranges
+		for (int k = begin; k < end; k += CHUNK_SIZE) {
+			CollideChunk(k / CHUNK_SIZE, k, std::min(end, k + CHUNK_SIZE));
+		}
+	});
+
+	for (auto& impulses : chunkImpulses) {
+		for (const BodyImpulse& impulse : impulses) {
+			FlatBody* body = contactBodies[impulse.body].body;
+			body->linearVelocity -= impulse.linear * body->invMass;
+			body->angularVelocity -= impulse.angular * body->invInertia;
+		}
+	}
+}
+
+void FlatParticleSystem::CollideChunk(const int& chunk, const int& begin, const int& end) {
+	std::vector<BodyImpulse>& impulses = chunkImpulses[chunk];
+	impulses.clear();
+
+	for (int b = 0; b < contactBodies.size(); b++) {
+		const ContactBody& contact = contactBodies[b];
+		FlatBody* body = contact.body;
+		BodyImpulse bodyImpulse = { b, FlatVector(), 0.0f };
+
+		for (int row = contact.y0; row <= contact.y1; row++) {
+			int first = std::max(cellStart[row * gridWidth + contact.x0], begin);
+			int last = std::min(cellStart[row * gridWidth + contact.x1 + 1], end);
+
+			for (int i = first; i < last; i++) {
+				float x = positionX[i];
+				float y = positionY[i];
+				if (x < contact.boxMin.x || x > contact.boxMax.x || y < contact.boxMin.y || y > contact.boxMax.y) continue;
+
+				FlatAABB particleBox(x - radius, y - radius, x + radius, y + radius);
+				body->QueryFixtures(particleBox, [&](int fixture) {
+					CollideFixture(body, fixture, i, bodyImpulse);
+					return true;
+				});
+			}
+		}
+
+		if (!body->b_IsStatic && (bodyImpulse.linear.x != 0.0f || bodyImpulse.linear.y != 0.0f || bodyImpulse.angular != 0.0f)) {
+			impulses.push_back(bodyImpulse);
+		}
+	}
+}
+
+void FlatParticleSystem::CollideFixture(FlatBody* body, const int& fixture, const int& particle, BodyImpulse& bodyImpulse) {
+	FlatBody::FixtureGeometry geometry = body->GetFixture(fixture);
+	FlatVector position(positionX[particle], positionY[particle]);
+
+	// normal points from the particle into the fixture
+	FlatVector normal;
+	float depth = 0.0f;
+	bool b_Hit = false;
+	if (geometry.type == FlatBody::Circle) {
+		b_Hit = Collisions::IntersectCircles(position, radius, geometry.center, geometry.radius, normal, depth);
+	}
+	else if (geometry.type == FlatBody::Segment) {
+		b_Hit = Collisions::IntersectCircleSegment(position, radius,
+			geometry.points[0], geometry.points[1], geometry.points[2], geometry.points[3], normal, depth);
+		normal = -normal;
+	}
+	else {
+		b_Hit = Collisions::IntersectCirclePolygon(position, radius, geometry.center, *geometry.vertices, normal, depth);
+	}
+
+	if (!b_Hit) return;
+
+	// bodies are far heavier, the particle takes the whole correction
+	position -= normal * depth;
+	positionX[particle] = position.x;
+	positionY[particle] = position.y;
+
+	FlatVector r = position + normal * radius - body->position;
+	FlatVector bodyVelocity = body->linearVelocity + FlatVector(-body->angularVelocity * r.y, body->angularVelocity * r.x);
+	FlatVector velocity(velocityX[particle], velocityY[particle]);
+	FlatVector relative = velocity - bodyVelocity;
+
+	float normalSpeed = FlatMath::Dot(relative, normal);
+	if (normalSpeed <= 0.0f) return;
+
+	float invMass = 1.0f / mass;
+	float rn = FlatMath::Cross(r, normal);
+	float normalImpulse = normalSpeed / (invMass + body->invMass + rn * rn * body->invInertia);
+	FlatVector impulse = -normalImpulse * normal;
+
+	FlatVector tangent = relative - normalSpeed * normal;
+	if (FlatMath::LengthSquared(tangent) > 1e-12f) {
+		tangent = FlatMath::Normalize(tangent);
+		float rt = FlatMath::Cross(r, tangent);
+		float tangentImpulse = FlatMath::Dot(relative, tangent) / (invMass + body->invMass + rt * rt * body->invInertia);
+		impulse -= std::min(tangentImpulse, BODY_FRICTION * normalImpulse) * tangent;
+	}
+
+	velocityX[particle] += impulse.x * invMass;
+	velocityY[particle] += impulse.y * invMass;
+
+	bodyImpulse.linear += impulse;
+	bodyImpulse.angular += FlatMath::Cross(r, impulse);
+}
+
+void FlatParticleSystem::RemoveEscaped(const FlatAABB& bounds) {
+	int kept = 0;
+	for (int i = 0; i < count; i++) {
+		if (positionX[i] < bounds.min.x || positionX[i] > bounds.max.x ||
+			positionY[i] < bounds.min.y || positionY[i] > bounds.max.y) {
+			continue;
+		}
+
+		positionX[kept] = positionX[i];
+		positionY[kept] = positionY[i];
+		velocityX[kept] = velocityX[i];
+		velocityY[kept] = velocityY[i];
+		kept++;
+	}
+
+	Resize(kept);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "FlatVector.h"
+#include "FlatAABB.h"
+#include "FlatBody.h"
+#include "FlatThreadPool.h"
+#include <vector>
+#include <functional>
+
+// Equal frictionless circles simulated apart from the rigid bodies, for fluid-like fill.
+// Particles are kept as structure-of-arrays and have no identity: every substep re-sorts them
+// into a uniform grid of one-diameter cells, so their order changes from step to step.
+//
+// A substep predicts positions, counting-sorts the particles by cell, pushes overlapping
+// neighbours apart (Jacobi, the neighbours of a row of cells are contiguous and are tested in
+// SIMD lanes), turns the correction into velocity and then pushes particles out of the bodies.
+// Contacts with dynamic bodies exchange impulses both ways, but particles are light: they
+// push bodies around and flow past them rather than holding them up. Each chunk of particles
+// sums its impulses per body against the velocities the bodies had at the start of the pass,
+// and the sums are added to the bodies after, in chunk order.
+class FlatParticleSystem {
+public:
+	static constexpr float DEFAULT_RADIUS = 0.1f;   // m
+	static constexpr float DEFAULT_DENSITY = 1.6f;  // g/cm^3
+	static constexpr int DEFAULT_ITERATIONS = 4;    // substeps per Step
+
+	static constexpr int CHUNK_SIZE = 4096;         // particles per pool task
+	static constexpr int MAX_GRID_CELLS = 1 << 22;  // wider spreads get coarser cells
+	static constexpr int MAX_GRID_COUNTERS = 1 << 24; // cells times grid chunks, fewer chunks past it
+
+	// share of an overlap each neighbour corrects per substep; below 1/2 so a particle
+	// squeezed from several sides doesn't overshoot
+	static constexpr float RELAXATION = 0.15f;
+	static constexpr float BODY_FRICTION = 0.4f;
+
+	// m/s, the most velocity one substep's overlap correction adds to a particle
+	static constexpr float MAX_SEPARATION_SPEED = 2.0f;
+
+private:
+	// a body whose box, grown by the radius, reaches the grid, and the cells the box covers
+	struct ContactBody {
+		FlatBody* body;
+		FlatVector boxMin;
+		FlatVector boxMax;
+		int x0, y0, x1, y1;
+	};
+
+	// what one chunk's particles did to contactBodies[body]
+	struct BodyImpulse {
+		int body;
+		FlatVector linear;
+		float angular;
+	};
+
+	float radius;
+	float density;
+	float mass;
+	int iterations;
+	int count;
+
+	// padded by FLAT_WIDE_LANES - 1 floats, so lane loads may run past the last particle
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> velocityX;
+	std::vector<float> velocityY;
+
+	// grid of the current substep; the particles of cell c are [cellStart[c], cellStart[c + 1])
+	FlatVector gridOrigin;
+	float cellSize;
+	int gridWidth;
+	int gridHeight;
+	std::vector<int> cellStart;
+
+	// the grid is sorted in one chunk of particles per thread: chunkMin[k] and chunkMax[k] bound
+	// chunk k and cellCursor[k * cellCount + c] first counts, then places its particles in cell c
+	int gridChunkCount;
+	int gridChunkSize;
+	std::vector<FlatVector> chunkMin;
+	std::vector<FlatVector> chunkMax;
+	std::vector<int> cellCursor;
+	std::vector<int> blockStart;
+
+	// sort and solve scratch
+	std::vector<int> particleCell;
+	std::vector<float> scratchX;
+	std::vector<float> scratchY;
+	std::vector<float> scratchVelocityX;
+	std::vector<float> scratchVelocityY;
+	std::vector<float> deltaX;
+	std::vector<float> deltaY;
+
+	// body collision scratch, chunkImpulses[k] is filled by the particles of chunk k
+	std::vector<ContactBody> contactBodies;
+	std::vector<std::vector<BodyImpulse>> chunkImpulses;
+
+public:
+	FlatParticleSystem(const float& radius = DEFAULT_RADIUS, const float& density = DEFAULT_DENSITY);
+
+	// Removes every particle when the radius changes
+	void SetRadius(const float& radius);
+	float GetRadius() const;
+
+	void SetDensity(const float& density);
+	float GetDensity() const;
+
+	void SetIterations(const int& iterations);
+	int GetIterations() const;
+
+	void AddParticle(const FlatVector& position, const FlatVector& velocity = FlatVector());
+	void Clear();
+	int Count() const;
+
+	FlatVector GetPosition(const int& particle) const;
+	FlatVector GetVelocity(const int& particle) const;
+
+	// Count() positions each, for drawing
+	const float* GetPositionsX() const;
+	const float* GetPositionsY() const;
+
+	// Called by FlatWorld::Step after the bodies moved. Particles that leave bounds are removed.
+	void Step(const FlatVector& gravity, const float& dt, const std::vector<FlatBody*>& bodies,
+		FlatThreadPool* pool, const FlatAABB* bounds);
+
+	void ShiftOrigin(const FlatVector& newOrigin);
+
+private:
+	void Resize(const int& size);
+	void ForEach(FlatThreadPool* pool, const FlatThreadPool::Task& task) const;
+
+	void Predict(const FlatVector& gravity, const float& dt, const int& begin, const int& end);
+	void BuildGrid(FlatThreadPool* pool);
+	void ForEachGridChunk(FlatThreadPool* pool, const std::function<void(int chunk)>& task) const;
+	void Solve(const int& begin, const int& end);
+	void Correct(const float& dt, const int& begin, const int& end);
+	void CollideBodies(const std::vector<FlatBody*>& bodies, FlatThreadPool* pool);
+	void CollideChunk(const int& chunk, const int& begin, const int& end);
+	void CollideFixture(FlatBody* body, const int& fixture, const int& particle, BodyImpulse& bodyImpulse);
+	void RemoveEscaped(const FlatAABB& bounds);
+};
@@ -0,0 +1,256 @@
+#include "FlatRegionStreamer.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <map>
+#include <cmath>
+
+static const char* REGION_MAGIC = "FLATREGION";
+static const int REGION_VERSION = 1;
+
+FlatRegionStreamer::FlatRegionStreamer(FlatWorld* _world, const std::string& _directory,
+	const float& _regionSize, const int& _loadRadius) :
+	world(_world),
+	directory(_directory),
+	regionSize(_regionSize),
+	loadRadius(std::max(0, _loadRadius)),
+	origin(0, 0)
+{}
+
+void FlatRegionStreamer::SetObservers(const std::vector<FlatVector>& positions) {
+	observers = positions;
+}
+
+const std::vector<FlatVector>& FlatRegionStreamer::GetObservers() const {
+	return observers;
+}
+
+bool FlatRegionStreamer::Update() {
+	loadedBodies.clear();
+	unloadedBodies.clear();
+
+	if (observers.empty()) return true;
+
+	Region center = RegionOf(observers[0]);
+	if (center != origin) {
+		FlatVector shift = RegionCorner(center);
+		world->ShiftOrigin(shift);
+		for (auto& observer : observers) {
+			observer -= shift;
+		}
+		origin = center;
+	}
+
+	// loaded within loadRadius, kept within one more
+	std::set<Region> needed;
+	std::set<Region> target;
+	for (auto& observer : observers) {
+		Region region = RegionOf(observer);
+
+		for (int y = -loadRadius - 1; y <= loadRadius + 1; y++) {
+			for (int x = -loadRadius - 1; x <= loadRadius + 1; x++) {
+				Region r(region.first + x, region.second + y);
+				bool b_Near = std::abs(x) <= loadRadius && std::abs(y) <= loadRadius;
+
+				if (b_Near) needed.insert(r);
+				if (b_Near || loadedRegions.count(r)) target.insert(r);
+			}
+		}
+	}
+
+	// everything outside the target regions goes to disk, unloading regions even when empty
+	std::map<Region, std::vector<FlatBody*>> outgoing;
+	for (auto& region : loadedRegions) {
+		if (!target.count(region)) outgoing[region];
+	}
+
+	FlatBody* body = nullptr;
+	for (int i = 0; world->GetBody(i, body); i++) {
+		Region region = RegionOf(body->GetPosition());
+		if (!target.count(region)) outgoing[region].push_back(body);
+	}
+
+	bool b_Ok = true;
+	for (auto& [region, bodies] : outgoing) {
+		// a loaded region's file is stale; bodies migrating into an unloaded one join its file
+		std::vector<FlatScenario::BodyDef> defs;
+		if (!loadedRegions.count(region) && !ReadRegion(region, defs)) {
+			b_Ok = false;
+			continue;
+		}
+
+		for (auto& b : bodies) {
+			defs.push_back(DescribeLocal(b, region));
+		}
+
+		if (!WriteRegion(region, defs)) {
+			b_Ok = false;
+			continue;
+		}
+
+		unloadedBodies.insert(unloadedBodies.end(), bodies.begin(), bodies.end());
+		loadedRegions.erase(region);
+	}
+
+	world->RemoveBodies(unloadedBodies);
+
+	for (auto& region : needed) {
+		if (loadedRegions.count(region)) continue;
+
+		std::vector<FlatScenario::BodyDef> defs;
+		if (!ReadRegion(region, defs)) {
+			b_Ok = false;
+			continue;
+		}
+
+		FlatVector corner = RegionCorner(region);
+		for (auto& def : defs) {
+			def.position += corner;
+
+			FlatBody* loaded = nullptr;
+			if (!FlatScenario::CreateBody(def, loaded)) {
+				b_Ok = false;
+				continue;
+			}
+
+			world->AddBody(loaded);
+			loadedBodies.push_back(loaded);
+		}
+
+		loadedRegions.insert(region);
+	}
+
+	return b_Ok;
+}
+
+bool FlatRegionStreamer::Flush() {
+	std::map<Region, std::vector<FlatScenario::BodyDef>> regions;
+	for (auto& region : loadedRegions) {
+		regions[region];
+	}
+
+	FlatBody* body = nullptr;
+	for (int i = 0; world->GetBody(i, body); i++) {
+		Region region = RegionOf(body->GetPosition());
+		if (loadedRegions.count(region)) {
+			regions[region].push_back(DescribeLocal(body, region));
+		}
+	}
+
+	bool b_Ok = true;
+	for (auto& [region, defs] : regions) {
+		b_Ok &= WriteRegion(region, defs);
+	}
+	return b_Ok;
+}
+
+bool FlatRegionStreamer::AddBody(FlatBody* body, const Region& region, const FlatVector& localPosition) {
+	if (IsLoaded(region)) {
+		body->MoveTo(RegionCorner(region) + localPosition);
+		world->AddBody(body);
+		return true;
+	}
+
+	// described in place, the world position of a far region would lose the local precision
+	FlatScenario::BodyDef def = FlatScenario::Describe(body);
+	def.position = localPosition;
+	delete body;
+
+	std::vector<FlatScenario::BodyDef> defs;
+	if (!ReadRegion(region, defs)) return false;
+
+	defs.push_back(def);
+	return WriteRegion(region, defs);
+}
+
+FlatRegionStreamer::Region FlatRegionStreamer::GetOrigin() const {
+	return origin;
+}
+
+FlatRegionStreamer::Region FlatRegionStreamer::RegionOf(const FlatVector& position) const {
+	return Region(origin.first + (int)std::floor(position.x / regionSize),
+		origin.second + (int)std::floor(position.y / regionSize));
+}
+
+FlatVector FlatRegionStreamer::RegionCorner(const Region& region) const {
+	return FlatVector((float)(region.first - origin.first) * regionSize,
+		(float)(region.second - origin.second) * regionSize);
+}
+
+bool FlatRegionStreamer::IsLoaded(const Region& region) const {
+	return loadedRegions.count(region) > 0;
+}
+
+size_t FlatRegionStreamer::LoadedRegionCount() const {
+	return loadedRegions.size();
+}
+
+const std::vector<FlatBody*>& FlatRegionStreamer::GetLoadedBodies() const {
+	return loadedBodies;
+}
+
+const std::vector<FlatBody*>& FlatRegionStreamer::GetUnloadedBodies() const {
+	return unloadedBodies;
+}
+
+std::string FlatRegionStreamer::RegionPath(const Region& region) const {
+	return directory + "/region_" + std::to_string(region.first) + "_" + std::to_string(region.second) + ".txt";
+}
+
+bool FlatRegionStreamer::ReadRegion(const Region& region, std::vector<FlatScenario::BodyDef>& bodies) const {
+	bodies.clear();
+
+	// a region that was never written is empty
+	std::string path = RegionPath(region);
+	if (!std::filesystem::exists(path)) return true;
+
+	std::ifstream in(path);
+	if (!in) return false;
+
+	std::string magic;
+	int version = 0;
+	in >> magic >> version;
+	if (magic != REGION_MAGIC || version != REGION_VERSION) return false;
+
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty()) continue;
+
+		std::istringstream ls(line);
+		std::string tag;
+		ls >> tag;
+
+		if (tag != "body") return false;
+
+		FlatScenario::BodyDef def;
+		if (!FlatScenario::ReadBodyDef(ls, def)) return false;
+		bodies.push_back(def);
+	}
+
+	return true;
+}
+
+bool FlatRegionStreamer::WriteRegion(const Region& region, const std::vector<FlatScenario::BodyDef>& bodies) const {
+	std::ofstream out(RegionPath(region));
+	if (!out) return false;
+
+	// 9 significant digits round-trip a float exactly
+	out << std::setprecision(9);
+	out << REGION_MAGIC << ' ' << REGION_VERSION << '\n';
+
+	for (auto& def : bodies) {
+		out << "body ";
+		FlatScenario::WriteBodyDef(out, def);
+		out << '\n';
+	}
+
+	return (bool)out;
+}
+
+FlatScenario::BodyDef FlatRegionStreamer::DescribeLocal(FlatBody* body, const Region& region) const {
+	FlatScenario::BodyDef def = FlatScenario::Describe(body);
+	def.position -= RegionCorner(region);
+	return def;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FlatWorld.h"
+#include "FlatScenario.h"
+#include <vector>
+#include <set>
+#include <string>
+#include <utility>
+
+// Splits an unbounded map into square regions around one FlatWorld. Only the regions near an
+// observer are in the world; the others are stored on disk, one text file per region with
+// positions relative to the region's corner. The world origin stays on the corner of the first
+// observer's region, so simulated coordinates stay small however large the map is.
+//
+// A body belongs to the region under its center. Bodies that move into a region that isn't
+// loaded are written to that region's file; regions are loaded within loadRadius of an
+// observer and unloaded beyond loadRadius + 1, so a body on a border doesn't thrash.
+class FlatRegionStreamer {
+public:
+	using Region = std::pair<int, int>; // absolute region coordinates
+
+	static constexpr float DEFAULT_REGION_SIZE = 64.0f; // m
+
+private:
+	FlatWorld* world;
+	std::string directory;
+	float regionSize;
+	int loadRadius;
+
+	Region origin;
+	std::vector<FlatVector> observers;
+	std::set<Region> loadedRegions;
+
+	std::vector<FlatBody*> loadedBodies;
+	std::vector<FlatBody*> unloadedBodies;
+
+public:
+	// Region files go to directory, which must exist
+	FlatRegionStreamer(FlatWorld* world, const std::string& directory,
+		const float& regionSize = DEFAULT_REGION_SIZE, const int& loadRadius = 1);
+
+	FlatRegionStreamer(const FlatRegionStreamer&) = delete;
+	FlatRegionStreamer& operator=(const FlatRegionStreamer&) = delete;
+
+	// Observer positions in world coordinates, e.g. the camera target. Update shifts them with the origin.
+	void SetObservers(const std::vector<FlatVector>& positions);
+	const std::vector<FlatVector>& GetObservers() const;
+
+	// Call between Steps: moves the origin to the first observer's region, writes out the bodies
+	// of regions that went out of range and reads in the regions that came into range.
+	// Returns false when a region file could not be read or written; those regions stay as they were.
+	bool Update();
+
+	// Writes every loaded region to disk without unloading it, e.g. to save the whole map
+	bool Flush();
+
+	// Takes ownership of a body placed at localPosition in a region. It goes into the world when
+	// the region is loaded and into the region's file (and is deleted) otherwise.
+	bool AddBody(FlatBody* body, const Region& region, const FlatVector& localPosition);
+
+	Region GetOrigin() const;
+	Region RegionOf(const FlatVector& position) const;
+	FlatVector RegionCorner(const Region& region) const; // in world coordinates
+	bool IsLoaded(const Region& region) const;
+	size_t LoadedRegionCount() const;
+
+	// Bodies the last Update created from region files (owned by the world) and bodies it took
+	// out of the world. The latter are no longer in the world; deleting them is up to the owner.
+	const std::vector<FlatBody*>& GetLoadedBodies() const;
+	const std::vector<FlatBody*>& GetUnloadedBodies() const;
+
+private:
+	std::string RegionPath(const Region& region) const;
+	bool ReadRegion(const Region& region, std::vector<FlatScenario::BodyDef>& bodies) const;
+	bool WriteRegion(const Region& region, const std::vector<FlatScenario::BodyDef>& bodies) const;
+	FlatScenario::BodyDef DescribeLocal(FlatBody* body, const Region& region) const;
+};
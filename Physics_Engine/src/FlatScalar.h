@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cmath>
+
+// The functions the math templates need from a scalar type. float and double use
+// the standard library; other scalar types (see FlatFixed.h) specialize this.
+template<typename T>
+struct FlatScalar {
+	static T Sqrt(const T& value) { return std::sqrt(value); }
+	static T Sin(const T& value) { return std::sin(value); }
+	static T Cos(const T& value) { return std::cos(value); }
+	static T Abs(const T& value) { return std::abs(value); }
+
+	// Smallest length that can still be normalized
+	static T Tiny() { return T(1e-6f); }
+};
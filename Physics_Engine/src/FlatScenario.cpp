@@ -0,0 +1,339 @@
+#include "FlatScenario.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+static const char* SCENARIO_MAGIC = "FLATSCENARIO";
+static const int SCENARIO_VERSION = 1;
+
+void FlatScenario::WriteBodyDef(std::ostream& out, const BodyDef& def) {
+	out << (int)def.shapeType << ' ' << def.radius << ' ' << def.width << ' ' << def.height << ' '
+		<< def.density << ' ' << def.restitution << ' ' << (def.b_IsStatic ? 1 : 0) << ' '
+		<< def.position.x << ' ' << def.position.y << ' ' << def.angle << ' '
+		<< def.linearVelocity.x << ' ' << def.linearVelocity.y << ' ' << def.angularVelocity;
+
+	if (def.shapeType == FlatBody::Compound) {
+		out << ' ' << def.fixtures.size();
+		for (auto& fixture : def.fixtures) {
+			out << ' ' << (int)fixture.shapeType << ' ' << fixture.radius << ' ' << fixture.width << ' ' << fixture.height << ' '
+				<< fixture.offset.x << ' ' << fixture.offset.y << ' ' << fixture.angle;
+		}
+	}
+	else if (def.shapeType == FlatBody::Chain) {
+		out << ' ' << (def.b_Loop ? 1 : 0) << ' ' << def.points.size();
+		for (auto& point : def.points) {
+			out << ' ' << point.x << ' ' << point.y;
+		}
+	}
+}
+
+bool FlatScenario::ReadBodyDef(std::istream& in, BodyDef& def) {
+	int shape, isStatic;
+	in >> shape >> def.radius >> def.width >> def.height >> def.density >> def.restitution >> isStatic
+		>> def.position.x >> def.position.y >> def.angle
+		>> def.linearVelocity.x >> def.linearVelocity.y >> def.angularVelocity;
+
+	if (!in) return false;
+
+	def.shapeType = (FlatBody::ShapeType)shape;
+	def.b_IsStatic = isStatic != 0;
+	def.fixtures.clear();
+	def.points.clear();
+
+	if (def.shapeType == FlatBody::Compound) {
+		size_t count;
+		in >> count;
+		def.fixtures.resize(in ? count : 0);
+
+		for (auto& fixture : def.fixtures) {
+			in >> shape >> fixture.radius >> fixture.width >> fixture.height
+				>> fixture.offset.x >> fixture.offset.y >> fixture.angle;
+			fixture.shapeType = (FlatBody::ShapeType)shape;
+		}
+	}
+	else if (def.shapeType == FlatBody::Chain) {
+		int loop;
+		size_t count;
+		in >> loop >> count;
+		def.b_Loop = loop != 0;
+		def.points.resize(in ? count : 0);
+
+		for (auto& point : def.points) {
+			in >> point.x >> point.y;
+		}
+	}
+
+	return (bool)in;
+}
+
+FlatScenario::FlatScenario() :
+	iterations(FlatWorld::MIN_ITERATIONS),
+	dt(1.0f / 60.0f),
+	stepMode(FlatWorld::Substep),
+	b_AdaptiveSubsteps(false),
+	minSubsteps(FlatWorld::DEFAULT_MIN_SUBSTEPS),
+	contactHertz(FlatWorld::DEFAULT_CONTACT_HERTZ),
+	contactDampingRatio(FlatWorld::DEFAULT_CONTACT_DAMPING_RATIO)
+{}
+
+void FlatScenario::CaptureScene(FlatWorld* world, const int& _iterations, const float& _dt) {
+	iterations = _iterations;
+	dt = _dt;
+	stepMode = world->GetStepMode();
+	b_AdaptiveSubsteps = world->IsAdaptiveSubsteps();
+	minSubsteps = world->GetMinSubsteps();
+	contactHertz = world->GetContactHertz();
+	contactDampingRatio = world->GetContactDampingRatio();
+	scene.clear();
+	events.clear();
+	checksums.clear();
+
+	FlatBody* body = nullptr;
+	for (int i = 0; world->GetBody(i, body); i++) {
+		scene.push_back(Describe(body));
+	}
+}
+
+void FlatScenario::RecordSpawn(const int& frame, FlatBody* body) {
+	Event e;
+	e.type = Event::Spawn;
+	e.frame = frame;
+	e.body = Describe(body);
+	events.push_back(e);
+}
+
+void FlatScenario::RecordRemove(const int& frame, const int& bodyIndex) {
+	Event e;
+	e.type = Event::Remove;
+	e.frame = frame;
+	e.bodyIndex = bodyIndex;
+	events.push_back(e);
+}
+
+void FlatScenario::RecordBounds(const int& frame, const FlatVector& min, const FlatVector& max) {
+	// only changes are stored, the last bounds stay in effect
+	for (auto it = events.rbegin(); it != events.rend(); ++it) {
+		if (it->type != Event::Bounds) continue;
+		if (it->boundsMin == min && it->boundsMax == max) return;
+		break;
+	}
+
+	Event e;
+	e.type = Event::Bounds;
+	e.frame = frame;
+	e.boundsMin = min;
+	e.boundsMax = max;
+	events.push_back(e);
+}
+
+void FlatScenario::RecordChecksum(const uint64_t& checksum) {
+	checksums.push_back(checksum);
+}
+
+int FlatScenario::FrameCount() const {
+	return (int)checksums.size();
+}
+
+bool FlatScenario::Save(const std::string& path) const {
+	std::ofstream out(path);
+	if (!out) return false;
+
+	// 9 significant digits round-trip a float exactly
+	out << std::setprecision(9);
+	out << SCENARIO_MAGIC << ' ' << SCENARIO_VERSION << '\n';
+	out << "iterations " << iterations << '\n';
+	out << "dt " << dt << '\n';
+	out << "mode " << (int)stepMode << ' ' << contactHertz << ' ' << contactDampingRatio << '\n';
+	out << "adaptive " << (int)b_AdaptiveSubsteps << ' ' << minSubsteps << '\n';
+
+	for (auto& def : scene) {
+		out << "body ";
+		WriteBodyDef(out, def);
+		out << '\n';
+	}
+
+	for (auto& e : events) {
+		if (e.type == Event::Spawn) {
+			out << "spawn " << e.frame << ' ';
+			WriteBodyDef(out, e.body);
+			out << '\n';
+		}
+		else if (e.type == Event::Remove) {
+			out << "remove " << e.frame << ' ' << e.bodyIndex << '\n';
+		}
+		else if (e.type == Event::Bounds) {
+			out << "bounds " << e.frame << ' ' << e.boundsMin.x << ' ' << e.boundsMin.y << ' '
+				<< e.boundsMax.x << ' ' << e.boundsMax.y << '\n';
+		}
+	}
+
+	for (int i = 0; i < checksums.size(); i++) {
+		out << "checksum " << i << ' ' << std::hex << checksums[i] << std::dec << '\n';
+	}
+
+	return (bool)out;
+}
+
+bool FlatScenario::Load(const std::string& path) {
+	std::ifstream in(path);
+	if (!in) return false;
+
+	std::string magic;
+	int version = 0;
+	in >> magic >> version;
+	if (magic != SCENARIO_MAGIC || version != SCENARIO_VERSION) return false;
+
+	stepMode = FlatWorld::Substep;
+	b_AdaptiveSubsteps = false;
+	minSubsteps = FlatWorld::DEFAULT_MIN_SUBSTEPS;
+	contactHertz = FlatWorld::DEFAULT_CONTACT_HERTZ;
+	contactDampingRatio = FlatWorld::DEFAULT_CONTACT_DAMPING_RATIO;
+	scene.clear();
+	events.clear();
+	checksums.clear();
+
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty()) continue;
+
+		std::istringstream ls(line);
+		std::string tag;
+		ls >> tag;
+
+		if (tag == "iterations") {
+			ls >> iterations;
+		}
+		else if (tag == "dt") {
+			ls >> dt;
+		}
+		else if (tag == "mode") {
+			// absent in older files, which were all recorded with substeps
+			int mode;
+			ls >> mode >> contactHertz >> contactDampingRatio;
+			if (!ls) return false;
+			stepMode = (FlatWorld::StepMode)mode;
+		}
+		else if (tag == "adaptive") {
+			// absent in older files, which all used a fixed count
+			int enabled;
+			ls >> enabled >> minSubsteps;
+			if (!ls) return false;
+			b_AdaptiveSubsteps = enabled != 0;
+		}
+		else if (tag == "body") {
+			BodyDef def;
+			if (!ReadBodyDef(ls, def)) return false;
+			scene.push_back(def);
+		}
+		else if (tag == "spawn") {
+			Event e;
+			e.type = Event::Spawn;
+			ls >> e.frame;
+			if (!ReadBodyDef(ls, e.body)) return false;
+			events.push_back(e);
+		}
+		else if (tag == "remove") {
+			Event e;
+			e.type = Event::Remove;
+			ls >> e.frame >> e.bodyIndex;
+			if (!ls) return false;
+			events.push_back(e);
+		}
+		else if (tag == "bounds") {
+			Event e;
+			e.type = Event::Bounds;
+			ls >> e.frame >> e.boundsMin.x >> e.boundsMin.y >> e.boundsMax.x >> e.boundsMax.y;
+			if (!ls) return false;
+			events.push_back(e);
+		}
+		else if (tag == "checksum") {
+			int frame;
+			uint64_t checksum;
+			ls >> frame >> std::hex >> checksum;
+			if (!ls || frame != checksums.size()) return false;
+			checksums.push_back(checksum);
+		}
+		else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+FlatScenario::BodyDef FlatScenario::Describe(FlatBody* body) {
+	BodyDef def;
+	def.shapeType = body->shapeType;
+	def.radius = body->shape->radius;
+	def.width = body->shape->width;
+	def.height = body->shape->height;
+	def.density = body->density;
+	def.restitution = body->restitution;
+	def.b_IsStatic = body->b_IsStatic;
+	def.position = body->position;
+	def.angle = body->angle;
+	def.linearVelocity = body->linearVelocity;
+	def.angularVelocity = body->angularVelocity;
+
+	for (auto& fixture : body->shape->fixtures) {
+		FixtureDef fixtureDef;
+		fixtureDef.shapeType = fixture.shape->type;
+		fixtureDef.radius = fixture.shape->radius;
+		fixtureDef.width = fixture.shape->width;
+		fixtureDef.height = fixture.shape->height;
+		fixtureDef.offset = fixture.offset;
+		fixtureDef.angle = fixture.angle;
+		def.fixtures.push_back(fixtureDef);
+	}
+
+	if (body->shapeType == FlatBody::Chain) {
+		def.points = body->shape->vertices;
+		def.b_Loop = body->shape->b_Loop;
+	}
+	return def;
+}
+
+bool FlatScenario::CreateBody(const BodyDef& def, FlatBody*& body) {
+	bool created = false;
+
+	if (def.shapeType == FlatBody::Circle) {
+		created = FlatBody::CreateCircleBody(def.radius, def.density, def.b_IsStatic, def.restitution, body);
+	}
+	else if (def.shapeType == FlatBody::Box) {
+		created = FlatBody::CreateBoxBody(def.width, def.height, def.density, def.b_IsStatic, def.restitution, body);
+	}
+	else if (def.shapeType == FlatBody::Compound) {
+		std::vector<FlatShape::Fixture> fixtures(def.fixtures.size());
+		bool b_Valid = true;
+
+		for (int i = 0; i < fixtures.size(); i++) {
+			const FixtureDef& fixtureDef = def.fixtures[i];
+			fixtures[i].offset = fixtureDef.offset;
+			fixtures[i].angle = fixtureDef.angle;
+
+			if (fixtureDef.shapeType == FlatBody::Circle) b_Valid &= FlatShape::CreateCircle(fixtureDef.radius, fixtures[i].shape);
+			else if (fixtureDef.shapeType == FlatBody::Box) b_Valid &= FlatShape::CreateBox(fixtureDef.width, fixtureDef.height, fixtures[i].shape);
+			else b_Valid = false;
+		}
+
+		std::shared_ptr<const FlatShape> shape;
+		created = b_Valid && FlatShape::CreateCompound(fixtures, shape) &&
+			FlatBody::CreateBody(shape, def.density, def.b_IsStatic, def.restitution, body);
+	}
+
+	else if (def.shapeType == FlatBody::Chain) {
+		created = FlatBody::CreateChainBody(def.points, def.b_Loop, def.restitution, body);
+	}
+
+	if (!created) {
+		body = nullptr;
+		return false;
+	}
+
+	body->MoveTo(def.position);
+	body->RotateTo(def.angle);
+	body->linearVelocity = def.linearVelocity;
+	body->angularVelocity = def.angularVelocity;
+	return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "FlatBody.h"
+#include "FlatWorld.h"
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <cstdint>
+
+// A recorded run: the scene at the moment recording started, the spawn/remove
+// events applied on top of it and the world checksum after every frame.
+class FlatScenario {
+public:
+	// a circle or box of a compound, offset from the compound's centroid
+	struct FixtureDef {
+		FlatBody::ShapeType shapeType = FlatBody::Circle;
+		float radius = 0.0f;
+		float width = 0.0f;
+		float height = 0.0f;
+		FlatVector offset;
+		float angle = 0.0f;
+	};
+
+	struct BodyDef {
+		FlatBody::ShapeType shapeType = FlatBody::Circle;
+		float radius = 0.0f;
+		float width = 0.0f;
+		float height = 0.0f;
+		float density = 1.0f;
+		float restitution = 0.0f;
+		bool b_IsStatic = false;
+		FlatVector position;
+		float angle = 0.0f;
+		FlatVector linearVelocity;
+		float angularVelocity = 0.0f;
+		std::vector<FixtureDef> fixtures; // compounds only
+		std::vector<FlatVector> points;   // chains only, in the body's frame
+		bool b_Loop = false;
+	};
+
+	struct Event {
+		enum Type {
+			Spawn = 0,   // applied before the frame's Step
+			Remove = 1,  // applied after the frame's Step, by world index
+			Bounds = 2   // applied before the frame's Step, see FlatWorld::SetBounds
+		};
+
+		Type type = Spawn;
+		int frame = 0;
+		BodyDef body;
+		int bodyIndex = -1;
+		FlatVector boundsMin;
+		FlatVector boundsMax;
+	};
+
+	int iterations;
+	float dt;
+	FlatWorld::StepMode stepMode;
+	bool b_AdaptiveSubsteps; // then iterations is the cap, see FlatWorld::SetAdaptiveSubsteps
+	int minSubsteps;
+	float contactHertz;
+	float contactDampingRatio;
+	std::vector<BodyDef> scene;
+	std::vector<Event> events;
+	std::vector<uint64_t> checksums;
+
+public:
+	FlatScenario();
+
+	void CaptureScene(FlatWorld* world, const int& iterations, const float& dt);
+	void RecordSpawn(const int& frame, FlatBody* body);
+	void RecordRemove(const int& frame, const int& bodyIndex);
+	void RecordBounds(const int& frame, const FlatVector& min, const FlatVector& max);
+	void RecordChecksum(const uint64_t& checksum);
+	int FrameCount() const;
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	static BodyDef Describe(FlatBody* body);
+	static bool CreateBody(const BodyDef& def, FlatBody*& body);
+
+	// one body as a line of text, as Save writes it
+	static void WriteBodyDef(std::ostream& out, const BodyDef& def);
+	static bool ReadBodyDef(std::istream& in, BodyDef& def);
+};
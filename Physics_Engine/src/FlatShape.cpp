@@ -0,0 +1,304 @@
+#include "FlatShape.h"
+#include "Def.h"
+#include "FlatMath.h"
+#include "FlatWorld.h"
+#include <algorithm>
+#include <cfloat>
+
+FlatShape::FlatShape(const ShapeType& _type, const float& _radius, const float& _width, const float& _height,
+	const float& _area, const float& _unitInertia, const std::vector<FlatVector>& _vertices) :
+	type(_type),
+	radius(_radius),
+	width(_width),
+	height(_height),
+	area(_area),
+	unitInertia(_unitInertia),
+	vertices(_vertices),
+	normals(CreateNormals(_vertices)),
+	b_Loop(false)
+{}
+
+FlatShape::FlatShape(const float& _area, const float& _unitInertia, const std::vector<Fixture>& _fixtures) :
+	type(Compound),
+	radius(0.0f),
+	width(0.0f),
+	height(0.0f),
+	area(_area),
+	unitInertia(_unitInertia),
+	fixtures(_fixtures),
+	b_Loop(false),
+	nodes(CreateNodes(_fixtures))
+{}
+
+FlatShape::FlatShape(const std::vector<FlatVector>& points, const bool& _b_Loop) :
+	type(Chain),
+	radius(0.0f),
+	width(0.0f),
+	height(0.0f),
+	area(0.0f),
+	unitInertia(0.0f),
+	vertices(points),
+	b_Loop(_b_Loop),
+	nodes(CreateNodes(points, _b_Loop))
+{}
+
+std::vector<FlatVector> FlatShape::CreateNormals(const std::vector<FlatVector>& vertices) {
+	std::vector<FlatVector> normals(vertices.size());
+
+	for (int i = 0; i < vertices.size(); i++) {
+		const FlatVector& va = vertices[i];
+		const FlatVector& vb = vertices[(i + 1) % vertices.size()];
+
+		FlatVector edge = vb - va;
+		normals[i] = FlatMath::Normalize(FlatVector(-edge.y, edge.x));
+	}
+
+	return normals;
+}
+
+std::vector<FlatVector> FlatShape::CreateBoxVertices(const float& width, const float& height) {
+	float left = -width / 2.0f;
+	float right = left + width;
+	float bottom = height / 2.0f;
+	float top = bottom - height;
+
+	std::vector<FlatVector> vectices(4);
+	vectices[0] = { left, top };
+	vectices[1] = { right, top };
+	vectices[2] = { right, bottom };
+	vectices[3] = { left, bottom };
+
+	return vectices;
+}
+
+std::vector<int> FlatShape::CreateBoxTriangles() {
+	std::vector<int> triangles(6);
+	triangles[0] = 0;
+	triangles[1] = 1;
+	triangles[2] = 2;
+	triangles[3] = 0;
+	triangles[4] = 2;
+	triangles[5] = 3;
+
+	return triangles;
+}
+
+bool FlatShape::CreateCircle(float radius, std::shared_ptr<const FlatShape>& shape) {
+	shape = nullptr;
+
+	float area = radius * radius * PI;
+
+	if (area < FlatWorld::MIN_BODY_SIZE || area > FlatWorld::MAX_BODY_SIZE) {
+		return false;
+	}
+
+	float unitInertia = (1.0f / 2.0f) * radius * radius;
+
+	shape = std::shared_ptr<const FlatShape>(new FlatShape(Circle, radius, 0.0f, 0.0f, area, unitInertia, std::vector<FlatVector>{}));
+
+	return true;
+}
+
+bool FlatShape::CreateBox(float width, float height, std::shared_ptr<const FlatShape>& shape) {
+	shape = nullptr;
+
+	float area = width * height;
+
+	if (area < FlatWorld::MIN_BODY_SIZE || area > FlatWorld::MAX_BODY_SIZE) {
+		return false;
+	}
+
+	float unitInertia = (1.0f / 12.0f) * (width * width + height * height);
+
+	shape = std::shared_ptr<const FlatShape>(new FlatShape(Box, 0.0f, width, height, area, unitInertia, CreateBoxVertices(width, height)));
+
+	return true;
+}
+
+bool FlatShape::CreateCompound(const std::vector<Fixture>& fixtures, std::shared_ptr<const FlatShape>& shape) {
+	shape = nullptr;
+
+	if (fixtures.empty()) {
+		return false;
+	}
+
+	float area = 0.0f;
+	FlatVector centroid;
+
+	for (auto& fixture : fixtures) {
+		if (!fixture.shape || fixture.shape->type == Compound) {
+			return false;
+		}
+
+		area += fixture.shape->area;
+		centroid += fixture.shape->area * fixture.offset;
+	}
+
+	if (area > FlatWorld::MAX_BODY_SIZE) {
+		return false;
+	}
+
+	centroid = centroid / area;
+
+	// offsets already about the centroid are kept as given, so a compound rebuilt from them is identical
+	if (FlatMath::LengthSquared(centroid) < 1e-12f) {
+		centroid = FlatVector();
+	}
+
+	// parallel axis theorem about the common centroid, per unit mass of the whole compound
+	float unitInertia = 0.0f;
+	std::vector<Fixture> placed(fixtures);
+
+	for (auto& fixture : placed) {
+		fixture.offset -= centroid;
+		unitInertia += fixture.shape->area * (fixture.shape->unitInertia + FlatMath::Dot(fixture.offset, fixture.offset));
+
+		FlatTransform transform(fixture.offset, fixture.angle);
+		fixture.vertices.resize(fixture.shape->vertices.size());
+		for (int i = 0; i < fixture.vertices.size(); i++) {
+			fixture.vertices[i] = FlatVector::Transform(fixture.shape->vertices[i], transform);
+		}
+
+		if (fixture.shape->type == Circle) {
+			FlatVector r(fixture.shape->radius, fixture.shape->radius);
+			fixture.lowerBound = fixture.offset - r;
+			fixture.upperBound = fixture.offset + r;
+		}
+		else {
+			fixture.lowerBound = FlatVector(FLT_MAX, FLT_MAX);
+			fixture.upperBound = FlatVector(-FLT_MAX, -FLT_MAX);
+			for (auto& v : fixture.vertices) {
+				fixture.lowerBound = FlatVector(std::min(fixture.lowerBound.x, v.x), std::min(fixture.lowerBound.y, v.y));
+				fixture.upperBound = FlatVector(std::max(fixture.upperBound.x, v.x), std::max(fixture.upperBound.y, v.y));
+			}
+		}
+	}
+
+	unitInertia /= area;
+
+	shape = std::shared_ptr<const FlatShape>(new FlatShape(area, unitInertia, placed));
+
+	return true;
+}
+
+bool FlatShape::CreateChain(const std::vector<FlatVector>& points, const bool& b_Loop, std::shared_ptr<const FlatShape>& shape) {
+	shape = nullptr;
+
+	if (points.size() < (b_Loop ? 3 : 4)) {
+		return false;
+	}
+
+	// every edge, ghost ones included, needs a direction for its normal
+	for (int i = 0; i < points.size(); i++) {
+		if (!b_Loop && i + 1 == points.size()) break;
+
+		const FlatVector& next = points[(i + 1) % points.size()];
+		if (FlatMath::DistanceSquared(points[i], next) < FlatWorld::MIN_BODY_SIZE) {
+			return false;
+		}
+	}
+
+	shape = std::shared_ptr<const FlatShape>(new FlatShape(points, b_Loop));
+
+	return true;
+}
+
+int FlatShape::SegmentCount() const {
+	if (type != Chain) return 0;
+	return b_Loop ? (int)vertices.size() : (int)vertices.size() - 3;
+}
+
+void FlatShape::GetSegment(const int& segment, int& ghost1, int& start, int& end, int& ghost2) const {
+	int count = (int)vertices.size();
+	int first = b_Loop ? segment : segment + 1;
+
+	ghost1 = (first + count - 1) % count;
+	start = first;
+	end = (first + 1) % count;
+	ghost2 = (first + 2) % count;
+}
+
+std::vector<FlatShape::Node> FlatShape::CreateNodes(const std::vector<Fixture>& fixtures) {
+	std::vector<FlatVector> lowerBounds(fixtures.size());
+	std::vector<FlatVector> upperBounds(fixtures.size());
+	for (int i = 0; i < fixtures.size(); i++) {
+		lowerBounds[i] = fixtures[i].lowerBound;
+		upperBounds[i] = fixtures[i].upperBound;
+	}
+
+	return CreateNodes(lowerBounds, upperBounds);
+}
+
+std::vector<FlatShape::Node> FlatShape::CreateNodes(const std::vector<FlatVector>& points, const bool& b_Loop) {
+	int count = b_Loop ? (int)points.size() : (int)points.size() - 3;
+	std::vector<FlatVector> lowerBounds(count);
+	std::vector<FlatVector> upperBounds(count);
+
+	for (int i = 0; i < count; i++) {
+		const FlatVector& a = points[b_Loop ? i : i + 1];
+		const FlatVector& b = points[b_Loop ? (i + 1) % points.size() : i + 2];
+		lowerBounds[i] = FlatVector(std::min(a.x, b.x), std::min(a.y, b.y));
+		upperBounds[i] = FlatVector(std::max(a.x, b.x), std::max(a.y, b.y));
+	}
+
+	return CreateNodes(lowerBounds, upperBounds);
+}
+
+std::vector<FlatShape::Node> FlatShape::CreateNodes(const std::vector<FlatVector>& lowerBounds, const std::vector<FlatVector>& upperBounds) {
+	std::vector<Node> nodes;
+	if (lowerBounds.empty()) return nodes;
+
+	std::vector<int> indices(lowerBounds.size());
+	for (int i = 0; i < indices.size(); i++) {
+		indices[i] = i;
+	}
+
+	nodes.reserve(2 * lowerBounds.size() - 1);
+	BuildNodes(nodes, lowerBounds, upperBounds, indices.data(), (int)indices.size());
+	return nodes;
+}
+
+int FlatShape::BuildNodes(std::vector<Node>& nodes, const std::vector<FlatVector>& lowerBounds,
+	const std::vector<FlatVector>& upperBounds, int* indices, const int& count)
+{
+	// top down, halving along the longer axis of the bounds at the median center
+	int nodeId = (int)nodes.size();
+	nodes.push_back(Node());
+
+	FlatVector lower(FLT_MAX, FLT_MAX);
+	FlatVector upper(-FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < count; i++) {
+		const FlatVector& leafLower = lowerBounds[indices[i]];
+		const FlatVector& leafUpper = upperBounds[indices[i]];
+		lower = FlatVector(std::min(lower.x, leafLower.x), std::min(lower.y, leafLower.y));
+		upper = FlatVector(std::max(upper.x, leafUpper.x), std::max(upper.y, leafUpper.y));
+	}
+
+	Node node;
+	node.lowerBound = lower;
+	node.upperBound = upper;
+	node.child1 = -1;
+	node.child2 = -1;
+	node.fixture = -1;
+
+	if (count == 1) {
+		node.fixture = indices[0];
+		nodes[nodeId] = node;
+		return nodeId;
+	}
+
+	bool b_SplitX = upper.x - lower.x >= upper.y - lower.y;
+	auto center = [&](const int& i) {
+		return b_SplitX ? lowerBounds[i].x + upperBounds[i].x : lowerBounds[i].y + upperBounds[i].y;
+	};
+
+	int half = count / 2;
+	std::nth_element(indices, indices + half, indices + count, [&](const int& a, const int& b) {
+		return center(a) < center(b) || (center(a) == center(b) && a < b);
+	});
+
+	node.child1 = BuildNodes(nodes, lowerBounds, upperBounds, indices, half);
+	node.child2 = BuildNodes(nodes, lowerBounds, upperBounds, indices + half, count - half);
+	nodes[nodeId] = node;
+	return nodeId;
+}
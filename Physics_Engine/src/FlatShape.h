@@ -0,0 +1,128 @@
+#pragma once
+
+#include "FlatVector.h"
+#include <vector>
+#include <memory>
+
+// Immutable shape definition in local space. Made once through CreateCircle/CreateBox/
+// CreateCompound/CreateChain and shared by any number of bodies; a body only adds mass properties
+// and its pose.
+class FlatShape {
+public:
+	enum ShapeType {
+		Circle = 0,
+		Box = 1,
+		Compound = 2,
+		Chain = 3,
+		Segment = 4 // one edge of a chain, only seen as a fixture
+	};
+
+	// A circle or box placed in a compound. CreateCompound takes offsets from the body origin
+	// and moves them so the compound's centroid is at its local origin.
+	struct Fixture {
+		std::shared_ptr<const FlatShape> shape;
+		FlatVector offset;
+		float angle = 0.0f;
+
+		std::vector<FlatVector> vertices; // in the compound's local space, filled by CreateCompound
+		FlatVector lowerBound;
+		FlatVector upperBound;
+	};
+
+	const ShapeType type;
+	const float radius;
+	const float width;
+	const float height;
+	const float area;
+	const float unitInertia; // rotational inertia per unit mass about the centroid
+
+	const std::vector<FlatVector> vertices; // local space, empty for circles and compounds; a chain's points
+	const std::vector<FlatVector> normals;  // unit edge normals, normals[i] belongs to edge i -> i + 1; empty for chains
+
+	const std::vector<Fixture> fixtures;    // compounds only
+	const bool b_Loop;                      // chains only
+
+private:
+	// Bounding volume hierarchy over a compound's fixtures or a chain's segments, built once, root at 0
+	struct Node {
+		FlatVector lowerBound;
+		FlatVector upperBound;
+		int child1;
+		int child2;
+		int fixture; // leaf only, -1 for inner nodes; the segment for chains
+	};
+
+	static constexpr int STACK_SIZE = 64;
+
+	const std::vector<Node> nodes;
+
+	FlatShape(const ShapeType& type, const float& radius, const float& width, const float& height,
+		const float& area, const float& unitInertia, const std::vector<FlatVector>& vertices);
+	FlatShape(const float& area, const float& unitInertia, const std::vector<Fixture>& fixtures);
+	FlatShape(const std::vector<FlatVector>& points, const bool& b_Loop);
+
+	static std::vector<FlatVector> CreateNormals(const std::vector<FlatVector>& vertices);
+	static std::vector<Node> CreateNodes(const std::vector<Fixture>& fixtures);
+	static std::vector<Node> CreateNodes(const std::vector<FlatVector>& points, const bool& b_Loop);
+	static std::vector<Node> CreateNodes(const std::vector<FlatVector>& lowerBounds, const std::vector<FlatVector>& upperBounds);
+	static int BuildNodes(std::vector<Node>& nodes, const std::vector<FlatVector>& lowerBounds,
+		const std::vector<FlatVector>& upperBounds, int* indices, const int& count);
+
+public:
+	FlatShape(const FlatShape&) = delete;
+	FlatShape& operator=(const FlatShape&) = delete;
+
+	static bool CreateCircle(float radius, std::shared_ptr<const FlatShape>& shape);
+	static bool CreateBox(float width, float height, std::shared_ptr<const FlatShape>& shape);
+
+	// Fixtures must be circles or boxes; the body's density applies to all of them
+	static bool CreateCompound(const std::vector<Fixture>& fixtures, std::shared_ptr<const FlatShape>& shape);
+
+	// Static terrain: a polyline of one-sided segments. A body collides with a segment from the side
+	// its normal (edge.y, -edge.x) faces, which is up for a chain running left to right in the
+	// y-down world, and out of a loop running clockwise on screen. A loop's segments join every
+	// point; an open chain's first and last points are only ghost vertices that shape its ends, so
+	// it needs four points for one segment. Bodies slide over the joints without catching on them.
+	static bool CreateChain(const std::vector<FlatVector>& points, const bool& b_Loop, std::shared_ptr<const FlatShape>& shape);
+
+	// Chains only: the segments and the point indices of one, with the ghost vertex on either side
+	int SegmentCount() const;
+	void GetSegment(const int& segment, int& ghost1, int& start, int& end, int& ghost2) const;
+
+	static std::vector<FlatVector> CreateBoxVertices(const float& width, const float& height);
+	static std::vector<int> CreateBoxTriangles();
+
+	// callback(fixture) for every fixture whose local bounds overlap [lower, upper]; returns false to stop
+	template<typename T>
+	void QueryFixtures(const FlatVector& lower, const FlatVector& upper, T&& callback) const;
+};
+
+template<typename T>
+void FlatShape::QueryFixtures(const FlatVector& lower, const FlatVector& upper, T&& callback) const {
+	if (nodes.empty()) return;
+
+	int stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = 0;
+
+	while (count > 0) {
+		const Node& node = nodes[stack[--count]];
+
+		if (node.upperBound.x < lower.x || node.lowerBound.x > upper.x ||
+			node.upperBound.y < lower.y || node.lowerBound.y > upper.y) {
+			continue;
+		}
+
+		if (node.fixture >= 0) {
+			if (!callback(node.fixture)) return;
+		}
+		else {
+			if (count + 2 > STACK_SIZE) {
+				__debugbreak();
+				return;
+			}
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
@@ -0,0 +1,224 @@
+#include "FlatTaskGraph.h"
+#include "FlatThreadPool.h"
+
+#include <thread>
+#include <algorithm>
+
+void FlatTaskGraph::WorkDeque::Push(const WorkItem& item) {
+	std::lock_guard<std::mutex> lock(mutex);
+	items.push_back(item);
+}
+
+bool FlatTaskGraph::WorkDeque::Pop(WorkItem& item) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (items.empty()) return false;
+
+	item = items.back();
+	items.pop_back();
+	return true;
+}
+
+bool FlatTaskGraph::WorkDeque::Steal(WorkItem& item) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (items.empty()) return false;
+
+	item = items.front();
+	items.pop_front();
+	return true;
+}
+
+FlatTaskGraph::FlatTaskGraph() :
+	remainingTasks(0),
+	criticalPath(0.0)
+{}
+
+int FlatTaskGraph::AddTask(const char* name, const Function& function) {
+	std::unique_ptr<Task> task = std::make_unique<Task>();
+	task->name = name;
+	task->function = function;
+	task->chunkSize = 1;
+	task->dependencyCount = 0;
+	task->itemCount = 1;
+	task->timing = { name, 0.0, 0.0, 0.0, 0.0, 0 };
+
+	tasks.push_back(std::move(task));
+	return (int)tasks.size() - 1;
+}
+
+int FlatTaskGraph::AddParallelTask(const char* name, const Prepare& prepare, const int& chunkSize, const RangeFunction& function) {
+	int id = AddTask(name, Function());
+	tasks[id]->prepare = prepare;
+	tasks[id]->rangeFunction = function;
+	tasks[id]->chunkSize = std::max(1, chunkSize);
+	return id;
+}
+
+void FlatTaskGraph::AddDependency(const int& before, const int& after) {
+	// tasks are added in dependency order, which keeps End's critical path a single pass
+	if (before >= after) {
+		__debugbreak();
+		return;
+	}
+
+	tasks[before]->successors.push_back(after);
+	tasks[after]->dependencyCount++;
+}
+
+void FlatTaskGraph::Clear() {
+	tasks.clear();
+	criticalPath = 0.0;
+}
+
+size_t FlatTaskGraph::TaskCount() const {
+	return tasks.size();
+}
+
+void FlatTaskGraph::Run(FlatThreadPool* pool) {
+	if (tasks.empty()) return;
+
+	if (pool && pool->ThreadCount() > 1) {
+		pool->Run(*this);
+		return;
+	}
+
+	Begin(1);
+	Work(0);
+	End();
+}
+
+const FlatTaskGraph::TaskTiming& FlatTaskGraph::GetTiming(const int& task) const {
+	return tasks[task]->timing;
+}
+
+void FlatTaskGraph::ResetTimings() {
+	for (auto& task : tasks) {
+		task->timing.totalTime = 0.0;
+	}
+	criticalPath = 0.0;
+}
+
+double FlatTaskGraph::CriticalPathLength() const {
+	return criticalPath;
+}
+
+void FlatTaskGraph::Begin(const int& threadCount) {
+	while (deques.size() < threadCount) {
+		deques.push_back(std::make_unique<WorkDeque>());
+	}
+
+	runStart = std::chrono::steady_clock::now();
+	remainingTasks.store((int)tasks.size());
+
+	for (auto& task : tasks) {
+		task->remainingDependencies.store(task->dependencyCount);
+		task->workNanos.store(0);
+	}
+
+	for (int i = 0; i < tasks.size(); i++) {
+		if (tasks[i]->dependencyCount == 0) {
+			MakeReady(i, 0);
+		}
+	}
+}
+
+void FlatTaskGraph::Work(const int& thread) {
+	int threadCount = (int)deques.size();
+	WorkItem item;
+
+	while (!IsDone()) {
+		bool found = deques[thread]->Pop(item);
+
+		for (int i = 1; !found && i < threadCount; i++) {
+			found = deques[(thread + i) % threadCount]->Steal(item);
+		}
+
+		if (found) {
+			Execute(item, thread);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool FlatTaskGraph::IsDone() const {
+	return remainingTasks.load(std::memory_order_acquire) == 0;
+}
+
+void FlatTaskGraph::End() {
+	// longest chain of spans; tasks were added after the tasks they depend on
+	std::vector<double> finish(tasks.size(), 0.0);
+	criticalPath = 0.0;
+
+	for (int i = 0; i < tasks.size(); i++) {
+		Task& task = *tasks[i];
+		task.timing.workTime = task.workNanos.load() / 1.0e6;
+		task.timing.totalTime += task.timing.end - task.timing.start;
+
+		finish[i] += task.timing.end - task.timing.start;
+		for (int next : task.successors) {
+			finish[next] = std::max(finish[next], finish[i]);
+		}
+		criticalPath = std::max(criticalPath, finish[i]);
+	}
+}
+
+void FlatTaskGraph::MakeReady(const int& id, const int& thread) {
+	Task& task = *tasks[id];
+	task.timing.start = Now();
+
+	if (task.prepare) {
+		task.itemCount = task.prepare();
+	}
+
+	int chunks = (task.itemCount + task.chunkSize - 1) / task.chunkSize;
+	task.timing.chunkCount = chunks;
+
+	if (chunks <= 0) {
+		Complete(id, thread);
+		return;
+	}
+
+	task.remainingChunks.store(chunks);
+	for (int chunk = chunks - 1; chunk >= 0; chunk--) {
+		deques[thread]->Push({ id, chunk });
+	}
+}
+
+void FlatTaskGraph::Execute(const WorkItem& item, const int& thread) {
+	Task& task = *tasks[item.task];
+	auto start = std::chrono::steady_clock::now();
+
+	if (task.rangeFunction) {
+		int begin = item.chunk * task.chunkSize;
+		int end = std::min(begin + task.chunkSize, task.itemCount);
+		task.rangeFunction(begin, end);
+	}
+	else {
+		task.function();
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	task.workNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+	if (task.remainingChunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		Complete(item.task, thread);
+	}
+}
+
+void FlatTaskGraph::Complete(const int& id, const int& thread) {
+	Task& task = *tasks[id];
+	task.timing.end = Now();
+
+	for (int next : task.successors) {
+		if (tasks[next]->remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			MakeReady(next, thread);
+		}
+	}
+
+	remainingTasks.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+double FlatTaskGraph::Now() const {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+}
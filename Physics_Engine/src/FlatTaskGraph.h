@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <chrono>
+
+class FlatThreadPool;
+
+// A small dependency graph of tasks that is built once and run many times.
+// Serial tasks run as one work item; parallel tasks are split into chunks
+// when they become ready. Each thread pushes new work onto its own deque
+// and idle threads steal from the others.
+class FlatTaskGraph {
+public:
+	using Function = std::function<void()>;
+	using Prepare = std::function<int()>; // runs when the task becomes ready, returns the item count
+	using RangeFunction = std::function<void(int begin, int end)>;
+
+	struct TaskTiming {
+		const char* name;
+		double start;     // ms since the run started, when the task became ready
+		double end;       // ms since the run started, when its last chunk finished
+		double workTime;  // ms summed over all chunks and threads
+		double totalTime; // span summed over runs since ResetTimings
+		int chunkCount;
+	};
+
+private:
+	struct WorkItem {
+		int task;
+		int chunk;
+	};
+
+	// Owner pushes and pops at the back, thieves take from the front.
+	class WorkDeque {
+	private:
+		std::mutex mutex;
+		std::deque<WorkItem> items;
+
+	public:
+		void Push(const WorkItem& item);
+		bool Pop(WorkItem& item);
+		bool Steal(WorkItem& item);
+	};
+
+	struct Task {
+		const char* name;
+		Function function;
+		Prepare prepare;
+		RangeFunction rangeFunction;
+		int chunkSize;
+		int dependencyCount;
+		std::vector<int> successors;
+
+		int itemCount;
+		std::atomic<int> remainingDependencies;
+		std::atomic<int> remainingChunks;
+		std::atomic<long long> workNanos;
+		TaskTiming timing;
+	};
+
+	std::vector<std::unique_ptr<Task>> tasks;
+	std::vector<std::unique_ptr<WorkDeque>> deques;
+	std::atomic<int> remainingTasks;
+	std::chrono::steady_clock::time_point runStart;
+	double criticalPath;
+
+public:
+	FlatTaskGraph();
+
+	int AddTask(const char* name, const Function& function);
+	int AddParallelTask(const char* name, const Prepare& prepare, const int& chunkSize, const RangeFunction& function);
+	void AddDependency(const int& before, const int& after);
+	void Clear();
+	size_t TaskCount() const;
+
+	// Runs the graph to completion on the pool, or on the calling thread when pool is null.
+	void Run(FlatThreadPool* pool);
+
+	const TaskTiming& GetTiming(const int& task) const;
+	void ResetTimings();
+
+	// Longest dependency chain of the last run, by task span (ms).
+	double CriticalPathLength() const;
+
+private:
+	friend class FlatThreadPool;
+
+	void Begin(const int& threadCount);
+	void Work(const int& thread);
+	bool IsDone() const;
+	void End();
+
+	void MakeReady(const int& task, const int& thread);
+	void Complete(const int& task, const int& thread);
+	void Execute(const WorkItem& item, const int& thread);
+	double Now() const;
+};
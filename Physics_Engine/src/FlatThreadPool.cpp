@@ -0,0 +1,101 @@
+#include "FlatThreadPool.h"
+
+#include <algorithm>
+
+FlatThreadPool::FlatThreadPool(const int& threadCount) :
+	graph(nullptr),
+	busyWorkers(0),
+	generation(0),
+	b_Quit(false)
+{
+	// the caller works as thread 0, so spawn one fewer
+	for (int i = 1; i < threadCount; i++) {
+		workers.emplace_back(&FlatThreadPool::WorkerLoop, this, i);
+	}
+}
+
+FlatThreadPool::~FlatThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		b_Quit = true;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+int FlatThreadPool::ThreadCount() const {
+	return (int)workers.size() + 1;
+}
+
+int FlatThreadPool::HardwareThreadCount() {
+	return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+void FlatThreadPool::Run(FlatTaskGraph& taskGraph) {
+	taskGraph.Begin(ThreadCount());
+
+	if (workers.empty()) {
+		taskGraph.Work(0);
+		taskGraph.End();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		graph = &taskGraph;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	wakeCondition.notify_all();
+
+	taskGraph.Work(0);
+
+	// workers may still be leaving Work; the graph must outlive that
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+	graph = nullptr;
+	lock.unlock();
+
+	taskGraph.End();
+}
+
+void FlatThreadPool::ParallelFor(const int& count, const int& chunkSize, const Task& task) {
+	if (count <= 0) return;
+
+	if (workers.empty() || count <= chunkSize) {
+		task(0, count);
+		return;
+	}
+
+	parallelForGraph.Clear();
+	parallelForGraph.AddParallelTask("parallel for", [count] { return count; }, chunkSize, task);
+	Run(parallelForGraph);
+}
+
+void FlatThreadPool::WorkerLoop(const int& thread) {
+	uint64_t seenGeneration = 0;
+
+	while (true) {
+		FlatTaskGraph* taskGraph;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [&] { return b_Quit || generation != seenGeneration; });
+			if (b_Quit) return;
+
+			seenGeneration = generation;
+			taskGraph = graph;
+		}
+
+		taskGraph->Work(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyWorkers--;
+		}
+		doneCondition.notify_one();
+	}
+}
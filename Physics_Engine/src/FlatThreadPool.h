@@ -0,0 +1,49 @@
+#pragma once
+
+#include "FlatTaskGraph.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+// Persistent worker threads that run FlatTaskGraphs with work stealing.
+// Workers sleep between runs, so a step never creates threads; the calling
+// thread works as thread 0.
+class FlatThreadPool {
+public:
+	using Task = std::function<void(int begin, int end)>;
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+
+	FlatTaskGraph* graph;
+	int busyWorkers;
+	uint64_t generation;
+	bool b_Quit;
+
+	FlatTaskGraph parallelForGraph;
+
+public:
+	explicit FlatThreadPool(const int& threadCount);
+	~FlatThreadPool();
+
+	FlatThreadPool(const FlatThreadPool&) = delete;
+	FlatThreadPool& operator=(const FlatThreadPool&) = delete;
+
+	int ThreadCount() const;
+
+	void Run(FlatTaskGraph& graph);
+
+	// Calls task(begin, end) over [0, count) in chunks of chunkSize and returns when all are done.
+	void ParallelFor(const int& count, const int& chunkSize, const Task& task);
+
+	static int HardwareThreadCount();
+
+private:
+	void WorkerLoop(const int& thread);
+};
@@ -1,17 +1,38 @@
 #pragma once
 
-class FlatVector;
-#include <cmath>
+#include "FlatScalar.h"
 
-class FlatTransform {
+template<typename T> class FlatVectorT;
+
+template<typename T>
+class FlatTransformT {
 public:
-	const float positionX;
-	const float positionY;
-	const float sin;
-	const float cos;
+	const T positionX;
+	const T positionY;
+	const T sin;
+	const T cos;
 
 public:
-	FlatTransform(FlatVector position, float angle);
-	FlatTransform(float x, float y, float angle);
-	FlatTransform();
-};
\ No newline at end of file
+	FlatTransformT(const FlatVectorT<T>& position, const T& angle) :
+		positionX(position.x),
+		positionY(position.y),
+		sin(FlatScalar<T>::Sin(angle)),
+		cos(FlatScalar<T>::Cos(angle)) {
+	}
+
+	FlatTransformT(const T& x, const T& y, const T& angle) :
+		positionX(x),
+		positionY(y),
+		sin(FlatScalar<T>::Sin(angle)),
+		cos(FlatScalar<T>::Cos(angle)) {
+	}
+
+	FlatTransformT() :
+		positionX(0),
+		positionY(0),
+		sin(0),
+		cos(1) {
+	}
+};
+
+using FlatTransform = FlatTransformT<float>;
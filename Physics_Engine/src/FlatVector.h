@@ -2,42 +2,107 @@
 
 #include "FlatTransform.h"
 
-class FlatVector {
+template<typename T>
+class FlatVectorT {
 public:
-	float x;
-	float y;
+	T x;
+	T y;
 
-	FlatVector();
+	FlatVectorT() : x(0), y(0) {}
 
-	FlatVector(float x, float y);
+	FlatVectorT(const T& x, const T& y) : x(x), y(y) {}
 
-	FlatVector& Add(const FlatVector& vec);
-	FlatVector& Subtract(const FlatVector& vec);
-	FlatVector& Multipliy(const FlatVector& vec);
-	FlatVector& Divide(const FlatVector& vec);
+	FlatVectorT& Add(const FlatVectorT& vec) {
+		x += vec.x;
+		y += vec.y;
+		return *this;
+	}
 
-	friend FlatVector operator +(const FlatVector& v1, const FlatVector& v2);
-	friend FlatVector operator -(const FlatVector& v1, const FlatVector& v2);
-	friend FlatVector operator *(const FlatVector& v1, const FlatVector& v2);
-	friend FlatVector operator /(const FlatVector& v1, const FlatVector& v2);
+	FlatVectorT& Subtract(const FlatVectorT& vec) {
+		x -= vec.x;
+		y -= vec.y;
+		return *this;
+	}
 
-	FlatVector& operator +=(const FlatVector& vec);
-	FlatVector& operator -=(const FlatVector& vec);
-	FlatVector& operator *=(const FlatVector& vec);
-	FlatVector& operator /=(const FlatVector& vec);
+	FlatVectorT& Multipliy(const FlatVectorT& vec) {
+		x *= vec.x;
+		y *= vec.y;
+		return *this;
+	}
 
-	FlatVector operator -() const;
-	FlatVector operator -();
+	FlatVectorT& Divide(const FlatVectorT& vec) {
+		if (vec.x == T(0) || vec.y == T(0)) {
+			__debugbreak();
+			return *this;
+		}
+		x /= vec.x;
+		y /= vec.y;
+		return *this;
+	}
 
-	FlatVector operator *(const float& scalar);
-	FlatVector operator *(const float& scalar) const;
-	FlatVector operator /(const float& scalar);
-    friend FlatVector operator *(float scalar, const FlatVector& vec);
+	friend FlatVectorT operator +(const FlatVectorT& v1, const FlatVectorT& v2) {
+		return FlatVectorT(v1.x + v2.x, v1.y + v2.y);
+	}
 
-	bool Equals(const FlatVector& other) const;
-	bool operator==(const FlatVector& other) const;
+	friend FlatVectorT operator -(const FlatVectorT& v1, const FlatVectorT& v2) {
+		return FlatVectorT(v1.x - v2.x, v1.y - v2.y);
+	}
 
-	FlatVector& Zero();
+	friend FlatVectorT operator *(const FlatVectorT& v1, const FlatVectorT& v2) {
+		return FlatVectorT(v1.x * v2.x, v1.y * v2.y);
+	}
 
-	static FlatVector Transform(FlatVector v, FlatTransform transform);
-};
\ No newline at end of file
+	friend FlatVectorT operator /(const FlatVectorT& v1, const FlatVectorT& v2) {
+		if (v2.x == T(0) || v2.y == T(0)) {
+			__debugbreak();
+			return FlatVectorT();
+		}
+		return FlatVectorT(v1.x / v2.x, v1.y / v2.y);
+	}
+
+	FlatVectorT& operator +=(const FlatVectorT& vec) { return Add(vec); }
+	FlatVectorT& operator -=(const FlatVectorT& vec) { return Subtract(vec); }
+	FlatVectorT& operator *=(const FlatVectorT& vec) { return Multipliy(vec); }
+	FlatVectorT& operator /=(const FlatVectorT& vec) { return Divide(vec); }
+
+	FlatVectorT operator -() const {
+		return FlatVectorT(-x, -y);
+	}
+
+	FlatVectorT operator *(const T& scalar) const {
+		return FlatVectorT(x * scalar, y * scalar);
+	}
+
+	FlatVectorT operator /(const T& scalar) const {
+		if (scalar == T(0)) {
+			__debugbreak();
+			return *this;
+		}
+		return FlatVectorT(x / scalar, y / scalar);
+	}
+
+	friend FlatVectorT operator *(const T& scalar, const FlatVectorT& vec) {
+		return FlatVectorT(vec.x * scalar, vec.y * scalar);
+	}
+
+	bool Equals(const FlatVectorT& other) const {
+		return x == other.x && y == other.y;
+	}
+
+	bool operator==(const FlatVectorT& other) const {
+		return Equals(other);
+	}
+
+	FlatVectorT& Zero() {
+		x = T(0);
+		y = T(0);
+		return *this;
+	}
+
+	static FlatVectorT Transform(const FlatVectorT& v, const FlatTransformT<T>& transform) {
+		return FlatVectorT(transform.cos * v.x - transform.sin * v.y + transform.positionX,
+			transform.sin * v.x + transform.cos * v.y + transform.positionY);
+	}
+};
+
+using FlatVector = FlatVectorT<float>;
@@ -2,6 +2,10 @@
 #include "Collisions.h"
 #include "FlatMath.h"
 
+#include <chrono>
+#include <cstring>
+#include <cfloat>
+
 const float FlatWorld::MIN_BODY_SIZE = 0.01f * 0.01f;
 const float FlatWorld::MAX_BODY_SIZE = 64.0f * 64.0f;
 
@@ -10,6 +14,21 @@ const float FlatWorld::MAX_DENSITY = 21.4f;
 
 FlatWorld::FlatWorld() {
 	gravity = { 0.0f, 9.81f };
+	threadCount = FlatThreadPool::HardwareThreadCount();
+	solverPath = FlatContactSolver::Wide;
+	stepMode = Substep;
+	b_AdaptiveSubsteps = false;
+	minSubsteps = DEFAULT_MIN_SUBSTEPS;
+	lastSubsteps = 0;
+	graphMode = Substep;
+	graphSubsteps = 0;
+	contactHertz = DEFAULT_CONTACT_HERTZ;
+	contactDampingRatio = DEFAULT_CONTACT_DAMPING_RATIO;
+	b_StaticTreeDirty = false;
+	cachedSubstepDt = 0.0f;
+	appliedCommandCount = 0;
+	staleCommandCount = 0;
+	b_CommandsApplied = false;
 }
 
 FlatWorld::~FlatWorld() {
@@ -21,14 +40,137 @@ FlatWorld::~FlatWorld() {
 }
 
 void FlatWorld::AddBody(FlatBody*& body) {
+    body->index = (int)bodyList.size();
+    IssueHandle(body);
+
+    if (body->b_IsStatic) {
+        b_StaticTreeDirty = true;
+    }
+    else {
+        body->proxyId = dynamicTree.CreateProxy(body->GetAABB(), body);
+        dynamicBodies.push_back(body);
+    }
+
     bodyList.push_back(std::move(body));
 }
 
 void FlatWorld::RemoveBody(FlatBody*& body) {
-    bodyList.erase(
-        std::remove(bodyList.begin(), bodyList.end(), body), bodyList.end()
-    );
+    if (body->index < 0 || body->index >= bodyList.size() || bodyList[body->index] != body) {
+        return;
+    }
+
+    if (body->b_IsStatic) {
+        b_StaticTreeDirty = true;
+    }
+    else {
+        dynamicTree.DestroyProxy(body->proxyId);
+        dynamicBodies.erase(std::find(dynamicBodies.begin(), dynamicBodies.end(), body));
+    }
+
+    bodyList.erase(bodyList.begin() + body->index);
+
+    for (int i = body->index; i < bodyList.size(); i++) {
+        bodyList[i]->index = i;
+    }
+
+    body->index = -1;
+    body->proxyId = -1;
+    ReleaseHandle(body);
+
+    cachedPairs.clear();
+    pairAxes.clear();
+    touchingPairs.erase(std::remove_if(touchingPairs.begin(), touchingPairs.end(),
+        [body](const std::pair<FlatBody*, FlatBody*>& pair) { return pair.first == body || pair.second == body; }),
+        touchingPairs.end());
+}
+
+void FlatWorld::RemoveBodies(const std::vector<FlatBody*>& bodies) {
+    int id;
+    for (auto& body : bodies) {
+        if (!GetBodyIndex(body, id)) continue;
+
+        if (body->b_IsStatic) {
+            b_StaticTreeDirty = true;
+        }
+        else {
+            dynamicTree.DestroyProxy(body->proxyId);
+        }
+
+        body->index = -1;
+        body->proxyId = -1;
+        ReleaseHandle(body);
+    }
+
+    // one compaction pass instead of an erase per body
+    int count = 0;
+    int dynamicCount = 0;
+    for (int i = 0; i < bodyList.size(); i++) {
+        FlatBody* body = bodyList[i];
+        if (body->index < 0) continue;
+
+        if (!body->b_IsStatic) {
+            dynamicBodies[dynamicCount++] = body;
+        }
+
+        body->index = count;
+        bodyList[count++] = body;
+    }
 
+    if (count == bodyList.size()) return;
+
+    cachedPairs.clear();
+    pairAxes.clear();
+    bodyList.resize(count);
+    dynamicBodies.resize(dynamicCount);
+
+    touchingPairs.erase(std::remove_if(touchingPairs.begin(), touchingPairs.end(),
+        [](const std::pair<FlatBody*, FlatBody*>& pair) { return pair.first->index < 0 || pair.second->index < 0; }),
+        touchingPairs.end());
+}
+
+void FlatWorld::MarkStaticsChanged() {
+    b_StaticTreeDirty = true;
+}
+
+void FlatWorld::ShiftOrigin(const FlatVector& newOrigin) {
+    for (auto& body : bodyList) {
+        body->Move(-newOrigin);
+    }
+
+    // dynamic proxies follow on the next Step, as for any move
+    b_StaticTreeDirty = true;
+
+    for (auto& impulse : cachedImpulses) {
+        for (int i = 0; i < impulse.contactCount; i++) {
+            impulse.contacts[i] -= newOrigin;
+        }
+    }
+
+    if (bounds) {
+        bounds = std::make_unique<FlatAABB>(bounds->min - newOrigin, bounds->max - newOrigin);
+    }
+
+    particles.ShiftOrigin(newOrigin);
+}
+
+void FlatWorld::ResetCaches() {
+    cachedPairs.clear();
+    cachedImpulses.clear();
+    contactPair.clear();
+    pairResults.clear();
+    pairAxes.clear();
+    axisPairs.clear();
+    cachedAxes.clear();
+
+    touchingPairs.clear();
+    previousTouchingPairs.clear();
+    beginEvents.clear();
+    persistEvents.clear();
+    endEvents.clear();
+
+    removedBodies.clear();
+    addedBodies.clear();
+    lastSubsteps = 0;
 }
 
 bool FlatWorld::GetBody(const int& id, FlatBody*& body) {
@@ -41,71 +183,1222 @@ bool FlatWorld::GetBody(const int& id, FlatBody*& body) {
     return true;
 }
 
+bool FlatWorld::GetBodyIndex(FlatBody* body, int& id) const {
+    id = body->index;
+    return id >= 0 && id < bodyList.size() && bodyList[id] == body;
+}
+
+FlatWorld::BodyHandle FlatWorld::GetHandle(FlatBody* body) const {
+    BodyHandle handle;
+    int id;
+    if (!GetBodyIndex(body, id)) return handle;
+
+    handle.slot = body->handleSlot;
+    handle.generation = handleGenerations[body->handleSlot];
+    return handle;
+}
+
+bool FlatWorld::GetBody(const BodyHandle& handle, FlatBody*& body) const {
+    if (handle.slot < 0 || handle.slot >= handleBodies.size() ||
+        handleGenerations[handle.slot] != handle.generation || !handleBodies[handle.slot]) {
+        return false;
+    }
+
+    body = handleBodies[handle.slot];
+    return true;
+}
+
+void FlatWorld::IssueHandle(FlatBody* body) {
+    if (freeHandles.empty()) {
+        body->handleSlot = (int)handleBodies.size();
+        handleBodies.push_back(body);
+        handleGenerations.push_back(0);
+        return;
+    }
+
+    body->handleSlot = freeHandles.back();
+    freeHandles.pop_back();
+    handleBodies[body->handleSlot] = body;
+}
+
+void FlatWorld::ReleaseHandle(FlatBody* body) {
+    // the generation moves on so handles to the slot's last body stay dead once it is reused
+    handleBodies[body->handleSlot] = nullptr;
+    handleGenerations[body->handleSlot]++;
+    freeHandles.push_back(body->handleSlot);
+    body->handleSlot = -1;
+}
+
 size_t FlatWorld::BodyCount() const {
     return bodyList.size();
 }
 
+void FlatWorld::SetBounds(const FlatAABB& aabb) {
+    bounds = std::make_unique<FlatAABB>(aabb);
+}
+
+void FlatWorld::ClearBounds() {
+    bounds.reset();
+}
+
+const std::vector<FlatBody*>& FlatWorld::GetRemovedBodies() const {
+    return removedBodies;
+}
+
+void FlatWorld::SetThreadCount(const int& count) {
+    int clamped = std::max(1, count);
+    if (clamped == threadCount) return;
+
+    threadCount = clamped;
+    threadPool.reset();
+}
+
+int FlatWorld::GetThreadCount() const {
+    return threadCount;
+}
+
+const FlatWorld::StepStats& FlatWorld::GetStepStats() const {
+    return stepStats;
+}
+
+FlatParticleSystem& FlatWorld::GetParticles() {
+    return particles;
+}
+
+uint64_t FlatWorld::Checksum() const {
+    // FNV-1a over the raw bits of every body's state, so any divergence shows up
+    uint64_t hash = 14695981039346656037ull;
+
+    auto mix = [&hash](float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 4; i++) {
+            hash ^= (bits >> (i * 8)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    for (auto& body : bodyList) {
+        mix(body->position.x);
+        mix(body->position.y);
+        mix(body->angle);
+        mix(body->linearVelocity.x);
+        mix(body->linearVelocity.y);
+        mix(body->angularVelocity);
+    }
+
+    for (int i = 0; i < particles.Count(); i++) {
+        FlatVector position = particles.GetPosition(i);
+        FlatVector velocity = particles.GetVelocity(i);
+        mix(position.x);
+        mix(position.y);
+        mix(velocity.x);
+        mix(velocity.y);
+    }
+
+    return hash;
+}
+
 void FlatWorld::Step(int totalIterations, float dt) { 
+    // once per Step, before anything reads the bodies
+    if (!b_CommandsApplied) ApplyCommands();
+    b_CommandsApplied = false;
+
     totalIterations = FlatMath::Clamp(totalIterations, MIN_ITERATIONS, MAX_ITERATIONS);
+    if (b_AdaptiveSubsteps) {
+        totalIterations = ChooseSubsteps(totalIterations, dt);
+    }
+
+    stepStats = StepStats();
+    stepStats.substepCount = totalIterations;
+    stepStats.commandCount = appliedCommandCount;
+    stepStats.staleCommandCount = staleCommandCount;
+    beginEvents.clear();
+    persistEvents.clear();
+    endEvents.clear();
 
-    for (int currentItertation = 0; currentItertation  < totalIterations; currentItertation++) {
-        contactPair.clear();
+    if (threadCount > 1 && !threadPool) {
+        threadPool = std::make_unique<FlatThreadPool>(threadCount);
+    }
+
+    bool b_Rebuild = stepGraph.TaskCount() == 0 || graphMode != stepMode ||
+        (stepMode == SoftStep && graphSubsteps != totalIterations);
 
-        StepBodies(totalIterations, dt);
+    if (b_Rebuild) {
+        // a new substep count keeps the warm start impulses, they are rescaled
+        if (graphMode != stepMode) cachedPairs.clear();
 
-        if (BodyCount() > 1) { // only do collisions when there more than one body
-            BroadPhase();
-            NarrowPhase();
+        stepGraph.Clear();
+        graphMode = stepMode;
+        graphSubsteps = totalIterations;
+
+        if (stepMode == SoftStep) BuildSoftStepGraph(totalIterations);
+        else BuildStepGraph();
+    }
+
+    stepIterations = totalIterations;
+    stepDt = dt;
+    stepGraph.ResetTimings();
+
+    // soft step runs its substeps inside the graph
+    int runs = stepMode == SoftStep ? 1 : totalIterations;
+
+    for (int run = 0; run < runs; run++) {
+        stepGraph.Run(threadPool.get());
+
+        auto span = [this](const int& task) {
+            const FlatTaskGraph::TaskTiming& timing = stepGraph.GetTiming(task);
+            return timing.end - timing.start;
+        };
+
+        double integrateTime = 0.0;
+        for (int task : integrateTasks) {
+            integrateTime += span(task);
+        }
+
+        double narrowPhaseTime = stepGraph.GetTiming(writeBackTask).end - stepGraph.GetTiming(collideTask).start;
+        if (stepMode == SoftStep) narrowPhaseTime -= integrateTime;
+
+        stepStats.integrateTime += integrateTime;
+        stepStats.broadPhaseTime += span(updateBroadPhaseTask) + span(findPairsTask);
+        stepStats.narrowPhaseTime += narrowPhaseTime;
+        stepStats.criticalPathTime += stepGraph.CriticalPathLength();
+        stepStats.pairCount += contactPair.size();
+        stepStats.islandCount += islandOffsets.empty() ? 0 : islandOffsets.size() - 1;
+        stepStats.overflowCount += colorOffsets[COLOR_COUNT + 1] - colorOffsets[COLOR_COUNT];
+
+        for (int color = 0; color < COLOR_COUNT; color++) {
+            if (colorOffsets[color + 1] > colorOffsets[color]) stepStats.colorCount++;
         }
     }
+
+    BuildContactEvents();
+    RemoveEscapedBodies();
+
+    auto st = std::chrono::high_resolution_clock::now();
+    particles.Step(gravity, dt, bodyList, threadPool.get(), bounds.get());
+    auto ed = std::chrono::high_resolution_clock::now();
+    stepStats.particleTime = std::chrono::duration<double, std::milli>(ed - st).count();
+
+    // separation moved bodies after the last broad phase; keep queries exact until the next step
+    UpdateProxies();
 }
 
-void FlatWorld::StepBodies(const int& totalIterations, const float& dt) {
-    for (auto& body : bodyList) {
-        body->Step(gravity, totalIterations, dt);
+void FlatWorld::Enqueue(const Command& command) {
+    commandQueue.Push(command);
+}
+
+void FlatWorld::ApplyCommands() {
+    b_CommandsApplied = true;
+    removedBodies.clear();
+    addedBodies.clear();
+
+    commands.clear();
+    commandQueue.Drain(commands);
+    appliedCommandCount = commands.size();
+    staleCommandCount = 0;
+    if (commands.empty()) return;
+
+    // arrival order between producers is a race, only each source's own order is kept
+    std::stable_sort(commands.begin(), commands.end(),
+        [](const Command& a, const Command& b) { return a.source < b.source; });
+
+    for (auto& command : commands) {
+        ApplyCommand(command);
     }
+    FlushRemovals();
+    commands.clear();
 }
 
-void FlatWorld::BroadPhase() {
-    for (int i = 0; i < bodyList.size() - 1; i++) {
-        FlatBody*& bodyA = bodyList[i];
-        FlatAABB bodyA_aabb = bodyA->GetAABB();
+const std::vector<FlatBody*>& FlatWorld::GetAddedBodies() const {
+    return addedBodies;
+}
 
-        for (int j = i + 1; j < bodyList.size(); j++) {
-            FlatBody*& bodyB = bodyList[j];
-            FlatAABB bodyB_aabb = bodyB->GetAABB();
+void FlatWorld::ApplyCommand(const Command& command) {
+    FlatBody* body = command.body;
+    int id;
 
-            if (bodyA->b_IsStatic && bodyB->b_IsStatic) {
-                continue;
+    // the handle is checked here, on the stepping thread; the body may be gone since it was queued
+    if (command.type != Command::Add && !GetBody(command.handle, body)) {
+        staleCommandCount++;
+        return;
+    }
+
+    switch (command.type) {
+    case Command::Add:
+        // a body removed earlier in the batch may come back; then it is no longer removed, and
+        // only added if the batch added it before that
+        FlushRemovals();
+        if (GetBodyIndex(body, id)) break;
+
+        AddBody(body);
+        if (auto removed = std::find(removedBodies.begin(), removedBodies.end(), body); removed != removedBodies.end()) {
+            removedBodies.erase(removed);
+        }
+        else {
+            addedBodies.push_back(body);
+        }
+        break;
+
+    case Command::Remove:
+        // removals are gathered into one compaction pass
+        commandRemovals.push_back(body);
+        break;
+
+    case Command::MoveTo:
+        body->MoveTo(command.vector);
+        if (body->b_IsStatic) b_StaticTreeDirty = true;
+        break;
+
+    case Command::RotateTo:
+        body->RotateTo(command.value);
+        if (body->b_IsStatic) b_StaticTreeDirty = true;
+        break;
+
+    case Command::SetLinearVelocity:
+        if (!body->b_IsStatic) body->linearVelocity = command.vector;
+        break;
+
+    case Command::SetAngularVelocity:
+        if (!body->b_IsStatic) body->angularVelocity = command.value;
+        break;
+
+    case Command::ApplyImpulse:
+        if (body->b_IsStatic) break;
+        body->linearVelocity += command.vector * body->invMass;
+        body->angularVelocity += FlatMath::Cross(command.point - body->position, command.vector) * body->invInertia;
+        break;
+
+    case Command::AddForce:
+        if (!body->b_IsStatic) body->AddForce(command.vector);
+        break;
+    }
+}
+
+void FlatWorld::FlushRemovals() {
+    if (commandRemovals.empty()) return;
+
+    // listed once per batch, however often it was removed and added back
+    int id;
+    for (auto& body : commandRemovals) {
+        if (!GetBodyIndex(body, id)) continue;
+        if (std::find(removedBodies.begin(), removedBodies.end(), body) != removedBodies.end()) continue;
+        removedBodies.push_back(body);
+    }
+
+    RemoveBodies(commandRemovals);
+    commandRemovals.clear();
+}
+
+void FlatWorld::SetStepMode(const StepMode& mode) {
+    stepMode = mode;
+}
+
+void FlatWorld::SetAdaptiveSubsteps(const bool& b_Enabled, const int& _minSubsteps) {
+    b_AdaptiveSubsteps = b_Enabled;
+    minSubsteps = std::min(std::max(_minSubsteps, MIN_ITERATIONS), MAX_ITERATIONS);
+    lastSubsteps = 0;
+}
+
+bool FlatWorld::IsAdaptiveSubsteps() const {
+    return b_AdaptiveSubsteps;
+}
+
+int FlatWorld::GetMinSubsteps() const {
+    return minSubsteps;
+}
+
+int FlatWorld::ChooseSubsteps(const int& maxSubsteps, const float& dt) {
+    // the farthest any point of a moving body gets this Step, against the smallest moving body
+    float maxDisplacement = 0.0f;
+    float minExtent = FLT_MAX;
+
+    for (auto& body : dynamicBodies) {
+        float speed = FlatMath::Length(body->linearVelocity);
+        FlatAABB aabb = body->GetAABB();
+        float reach = 0.5f * FlatMath::Length(aabb.max - aabb.min);
+        float pointSpeed = speed + std::abs(body->angularVelocity) * reach;
+
+        if (pointSpeed < ADAPTIVE_REST_SPEED) continue;
+
+        maxDisplacement = std::max(maxDisplacement, pointSpeed * dt);
+
+        const FlatShape& shape = *body->shape;
+        if (shape.type == FlatShape::Circle) {
+            minExtent = std::min(minExtent, 2.0f * shape.radius);
+        }
+        else if (shape.type == FlatShape::Box) {
+            minExtent = std::min(minExtent, std::min(shape.width, shape.height));
+        }
+        else {
+            for (auto& fixture : shape.fixtures) {
+                const FlatShape& piece = *fixture.shape;
+                float extent = piece.type == FlatShape::Circle ? 2.0f * piece.radius : std::min(piece.width, piece.height);
+                minExtent = std::min(minExtent, extent);
             }
+        }
+    }
+
+    int target = minSubsteps;
+    if (maxDisplacement > 0.0f) {
+        float needed = std::ceil(maxDisplacement / (ADAPTIVE_DISPLACEMENT * minExtent));
+        target = (int)std::min(needed, (float)MAX_ITERATIONS);
+    }
+
+    // at most halved per Step, so a pile coming to rest isn't cut to the minimum the moment it slows
+    if (target < lastSubsteps) {
+        target = std::max(target, lastSubsteps / 2);
+    }
+
+    lastSubsteps = FlatMath::Clamp(target, std::min(minSubsteps, maxSubsteps), maxSubsteps);
+    return lastSubsteps;
+}
+
+const std::vector<FlatWorld::ContactEvent>& FlatWorld::GetContactBeginEvents() const {
+    return beginEvents;
+}
+
+const std::vector<FlatWorld::ContactEvent>& FlatWorld::GetContactPersistEvents() const {
+    return persistEvents;
+}
+
+const std::vector<FlatWorld::ContactEvent>& FlatWorld::GetContactEndEvents() const {
+    return endEvents;
+}
+
+FlatWorld::StepMode FlatWorld::GetStepMode() const {
+    return stepMode;
+}
+
+void FlatWorld::SetContactSoftness(const float& hertz, const float& dampingRatio) {
+    contactHertz = std::max(0.0f, hertz);
+    contactDampingRatio = std::max(0.0f, dampingRatio);
+}
+
+float FlatWorld::GetContactHertz() const {
+    return contactHertz;
+}
+
+float FlatWorld::GetContactDampingRatio() const {
+    return contactDampingRatio;
+}
+
+void FlatWorld::SetSolverPath(const FlatContactSolver::Path& path) {
+    solverPath = path;
+}
+
+FlatContactSolver::Path FlatWorld::GetSolverPath() const {
+    return solverPath;
+}
+
+const FlatTaskGraph& FlatWorld::GetStepGraph() const {
+    return stepGraph;
+}
+
+// update broadphase -> find pairs -> collide, as in Step but run directly without the step graph
+size_t FlatWorld::DetectCollisions(std::vector<CollisionRecord>& records) {
+    stepStats = StepStats();
+    records.clear();
+
+    if (threadCount > 1 && !threadPool) {
+        threadPool = std::make_unique<FlatThreadPool>(threadCount);
+    }
+
+    auto forEach = [this](const int& count, const int& chunkSize, const FlatThreadPool::Task& task) {
+        if (threadPool) threadPool->ParallelFor(count, chunkSize, task);
+        else if (count > 0) task(0, count);
+    };
+
+    auto st = std::chrono::high_resolution_clock::now();
+    UpdateProxies();
+
+    int bodyCount = (int)dynamicBodies.size();
+    pairChunks.resize((bodyCount + FIND_PAIRS_CHUNK_SIZE - 1) / FIND_PAIRS_CHUNK_SIZE);
+    forEach(bodyCount, FIND_PAIRS_CHUNK_SIZE, [this](int begin, int end) {
+        // chunks must start on a multiple of the chunk size, the pool may hand out larger ranges
+        for (int k = begin; k < end; k += FIND_PAIRS_CHUNK_SIZE) {
+            FindPairs(k, std::min(end, k + FIND_PAIRS_CHUNK_SIZE));
+        }
+    });
+
+    int pairCount = PreparePairs();
+    auto md = std::chrono::high_resolution_clock::now();
+
+    records.resize(pairCount);
+    forEach(pairCount, COLLIDE_CHUNK_SIZE, [this, &records](int begin, int end) {
+        CollidePairs(begin, end);
+
+        for (int p = begin; p < end; p++) {
+            CollisionRecord& record = records[p];
+            record.bodyA = bodyList[std::get<0>(contactPair[p])];
+            record.bodyB = bodyList[std::get<1>(contactPair[p])];
+            record.fixtureA = std::get<2>(contactPair[p]);
+            record.fixtureB = std::get<3>(contactPair[p]);
+            record.b_Colliding = pairResults[p].b_Colliding;
+            if (!record.b_Colliding) continue;
+
+            record.normal = pairResults[p].normal;
+            record.depth = pairResults[p].depth;
+
+            float separation1, separation2;
+            Collisions::FindContactPoints(record.bodyA, record.fixtureA, record.bodyB, record.fixtureB,
+                record.normal, record.depth, record.contacts[0], record.contacts[1], separation1, separation2, record.contactCount);
+        }
+    });
+    auto ed = std::chrono::high_resolution_clock::now();
+
+    stepStats.broadPhaseTime = std::chrono::duration<double, std::milli>(md - st).count();
+    stepStats.narrowPhaseTime = std::chrono::duration<double, std::milli>(ed - md).count();
+    stepStats.pairCount = pairCount;
+    for (auto& record : records) {
+        stepStats.contactCount += record.contactCount;
+    }
+    for (int p = 0; p < pairCount; p++) {
+        CountAxisCache(p);
+    }
+
+    return records.size();
+}
+
+// integrate -> update broadphase -> find pairs -> collide -> build islands -> prepare contacts
+// and color constraints -> solve color 0 .. COLOR_COUNT - 1 -> solve overflow -> write back.
+// Each stage is split into chunks that idle threads steal. Islands share no dynamic body, so
+// positional correction runs per island; constraints of one color share no dynamic body, so
+// each color is solved in parallel.
+void FlatWorld::BuildStepGraph() {
+    auto dynamicCount = [this] { return (int)dynamicBodies.size(); };
+
+    int integrateTask = stepGraph.AddParallelTask("integrate", dynamicCount, INTEGRATION_CHUNK_SIZE,
+        [this](int begin, int end) { StepBodies(begin, end); });
+    integrateTasks.assign(1, integrateTask);
+
+    updateBroadPhaseTask = stepGraph.AddTask("update broadphase", [this] { UpdateProxies(); });
+
+    findPairsTask = stepGraph.AddParallelTask("find pairs", [this] {
+            int chunks = ((int)dynamicBodies.size() + FIND_PAIRS_CHUNK_SIZE - 1) / FIND_PAIRS_CHUNK_SIZE;
+            pairChunks.resize(chunks);
+            return (int)dynamicBodies.size();
+        }, FIND_PAIRS_CHUNK_SIZE,
+        [this](int begin, int end) { FindPairs(begin, end); });
+
+    collideTask = stepGraph.AddParallelTask("collide", [this] { return PreparePairs(); }, COLLIDE_CHUNK_SIZE,
+        [this](int begin, int end) { CollidePairs(begin, end); });
+
+    buildIslandsTask = stepGraph.AddTask("build islands", [this] { BuildIslands(); });
+
+    prepareContactsTask = stepGraph.AddParallelTask("prepare contacts", [this] { return (int)islandOffsets.size() - 1; },
+        PREPARE_CHUNK_SIZE, [this](int begin, int end) { PrepareContacts(begin, end); });
+
+    colorTask = stepGraph.AddTask("color constraints", [this] { ColorConstraints(); });
+
+    stepGraph.AddDependency(integrateTask, updateBroadPhaseTask);
+    stepGraph.AddDependency(updateBroadPhaseTask, findPairsTask);
+    stepGraph.AddDependency(findPairsTask, collideTask);
+    stepGraph.AddDependency(collideTask, buildIslandsTask);
+    stepGraph.AddDependency(buildIslandsTask, prepareContactsTask);
+    stepGraph.AddDependency(buildIslandsTask, colorTask);
+
+    int solved = AddColorStage("solve color", "solve overflow", { prepareContactsTask, colorTask },
+        [this](FlatContactSolver::Constraint* const* constraints, int count) {
+            FlatContactSolver::SolveIndependent(constraints, count, solverPath);
+        },
+        [this](FlatContactSolver::Constraint* const* constraints, int count) {
+            FlatContactSolver::Solve(constraints, count, solverPath, bodyGroups);
+        });
+
+    writeBackTask = stepGraph.AddParallelTask("write back", dynamicCount, INTEGRATION_CHUNK_SIZE,
+        [this](int begin, int end) { WriteBack(begin, end); });
+
+    stepGraph.AddDependency(solved, writeBackTask);
+}
+
+// update broadphase -> find pairs -> collide -> build islands -> prepare soft contacts and color
+// constraints, then per substep: integrate velocities -> solve colors with bias -> integrate
+// positions -> relax colors; restitution colors -> write back. Bodies stay where collision
+// detection left them until the substeps move them, overlap is pushed out by the soft bias.
+void FlatWorld::BuildSoftStepGraph(const int& substeps) {
+    auto dynamicCount = [this] { return (int)dynamicBodies.size(); };
+
+    updateBroadPhaseTask = stepGraph.AddTask("update broadphase", [this] { UpdateProxies(); });
+
+    findPairsTask = stepGraph.AddParallelTask("find pairs", [this] {
+            int chunks = ((int)dynamicBodies.size() + FIND_PAIRS_CHUNK_SIZE - 1) / FIND_PAIRS_CHUNK_SIZE;
+            pairChunks.resize(chunks);
+            return (int)dynamicBodies.size();
+        }, FIND_PAIRS_CHUNK_SIZE,
+        [this](int begin, int end) { FindPairs(begin, end); });
+
+    collideTask = stepGraph.AddParallelTask("collide", [this] { return PreparePairs(); }, COLLIDE_CHUNK_SIZE,
+        [this](int begin, int end) { CollidePairs(begin, end); });
+
+    buildIslandsTask = stepGraph.AddTask("build islands", [this] { BuildIslands(); });
+
+    prepareContactsTask = stepGraph.AddParallelTask("prepare contacts", [this] { return (int)islandOffsets.size() - 1; },
+        PREPARE_CHUNK_SIZE, [this](int begin, int end) { PrepareSoftContacts(begin, end); });
+
+    colorTask = stepGraph.AddTask("color constraints", [this] { ColorConstraints(); });
+
+    stepGraph.AddDependency(updateBroadPhaseTask, findPairsTask);
+    stepGraph.AddDependency(findPairsTask, collideTask);
+    stepGraph.AddDependency(collideTask, buildIslandsTask);
+    stepGraph.AddDependency(buildIslandsTask, prepareContactsTask);
+    stepGraph.AddDependency(buildIslandsTask, colorTask);
+
+    auto warmStart = [](FlatContactSolver::Constraint* const* constraints, int count) {
+        for (int i = 0; i < count; i++) {
+            FlatContactSolver::WarmStart(*constraints[i]);
+        }
+    };
+
+    auto solve = [this](FlatContactSolver::Constraint* const* constraints, int count) {
+        float h = stepDt / stepIterations;
+        for (int i = 0; i < count; i++) {
+            FlatContactSolver::SolveSoft(*constraints[i], h, true);
+        }
+    };
+
+    auto relax = [this](FlatContactSolver::Constraint* const* constraints, int count) {
+        float h = stepDt / stepIterations;
+        for (int i = 0; i < count; i++) {
+            FlatContactSolver::SolveSoft(*constraints[i], h, false);
+        }
+    };
+
+    auto restitution = [](FlatContactSolver::Constraint* const* constraints, int count) {
+        for (int i = 0; i < count; i++) {
+            FlatContactSolver::ApplyRestitution(*constraints[i]);
+        }
+    };
+
+    integrateTasks.clear();
+    std::vector<int> previous = { prepareContactsTask, colorTask };
+
+    for (int substep = 0; substep < substeps; substep++) {
+        int velocities = stepGraph.AddParallelTask("integrate velocities", dynamicCount, INTEGRATION_CHUNK_SIZE,
+            [this](int begin, int end) { IntegrateVelocities(begin, end); });
+        for (int task : previous) {
+            stepGraph.AddDependency(task, velocities);
+        }
+
+        int warmStarted = AddColorStage("warm start color", "warm start overflow", { velocities }, warmStart, warmStart);
+        int solved = AddColorStage("solve color", "solve overflow", { warmStarted }, solve, solve);
+
+        int positions = stepGraph.AddParallelTask("integrate positions", dynamicCount, INTEGRATION_CHUNK_SIZE,
+            [this](int begin, int end) { IntegratePositions(begin, end); });
+        stepGraph.AddDependency(solved, positions);
+
+        int relaxed = AddColorStage("relax color", "relax overflow", { positions }, relax, relax);
+
+        integrateTasks.push_back(velocities);
+        integrateTasks.push_back(positions);
+        previous = { relaxed };
+    }
+
+    int restituted = AddColorStage("restitution color", "restitution overflow", previous, restitution, restitution);
+
+    storeImpulsesTask = stepGraph.AddParallelTask("store impulses", [this] {
+            cachedPairs = contactPair;
+            cachedImpulses.assign(contactPair.size(), CachedImpulse());
+            cachedSubstepDt = stepDt / stepIterations;
+            return (int)islandPairs.size();
+        }, COLLIDE_CHUNK_SIZE,
+        [this](int begin, int end) { StoreImpulses(begin, end); });
+
+    writeBackTask = stepGraph.AddParallelTask("write back", dynamicCount, INTEGRATION_CHUNK_SIZE,
+        [this](int begin, int end) { WriteBack(begin, end); });
+
+    stepGraph.AddDependency(restituted, storeImpulsesTask);
+    stepGraph.AddDependency(restituted, writeBackTask);
+}
+
+// One parallel task per color, each waiting for the previous one, then the overflow on one
+// thread. Returns the overflow task.
+int FlatWorld::AddColorStage(const char* name, const char* overflowName, const std::vector<int>& after,
+    const ConstraintRange& color, const ConstraintRange& overflow)
+{
+    std::vector<int> previous = after;
+
+    for (int c = 0; c < COLOR_COUNT; c++) {
+        int task = stepGraph.AddParallelTask(name,
+            [this, c] { return colorOffsets[c + 1] - colorOffsets[c]; }, COLOR_CHUNK_SIZE,
+            [this, c, color](int begin, int end) { color(colorConstraints.data() + colorOffsets[c] + begin, end - begin); });
+
+        for (int task_ : previous) {
+            stepGraph.AddDependency(task_, task);
+        }
+        previous = { task };
+    }
+
+    int overflowTask = stepGraph.AddTask(overflowName, [this, overflow] {
+        int first = colorOffsets[COLOR_COUNT];
+        overflow(colorConstraints.data() + first, colorOffsets[COLOR_COUNT + 1] - first);
+    });
+
+    stepGraph.AddDependency(previous[0], overflowTask);
+    return overflowTask;
+}
 
-            if (!Collisions::IntersectAABB(bodyB_aabb, bodyA_aabb)) {
+void FlatWorld::RemoveEscapedBodies() {
+    if (!bounds) return;
+
+    // one compaction pass instead of an erase per body
+    int count = 0;
+    int dynamicCount = 0;
+    for (int i = 0; i < bodyList.size(); i++) {
+        FlatBody* body = bodyList[i];
+
+        if (!body->b_IsStatic) {
+            FlatAABB box = body->GetAABB();
+            if (box.max.x < bounds->min.x || box.min.x > bounds->max.x ||
+                box.max.y < bounds->min.y || box.min.y > bounds->max.y) {
+                dynamicTree.DestroyProxy(body->proxyId);
+                body->index = -1;
+                body->proxyId = -1;
+                ReleaseHandle(body);
+                removedBodies.push_back(body);
                 continue;
             }
 
-            contactPair.emplace_back(i, j);
+            dynamicBodies[dynamicCount++] = body;
+        }
+
+        body->index = count;
+        bodyList[count++] = body;
+    }
+
+    if (count == bodyList.size()) return;
+
+    cachedPairs.clear();
+    pairAxes.clear();
+    bodyList.resize(count);
+    dynamicBodies.resize(dynamicCount);
+
+    // removed bodies stay valid until the next Step, so their contacts end now
+    int touching = 0;
+    for (auto& pair : touchingPairs) {
+        if (pair.first->index < 0 || pair.second->index < 0) {
+            ContactEvent e;
+            e.bodyA = pair.first;
+            e.bodyB = pair.second;
+            endEvents.push_back(e);
+            continue;
         }
+        touchingPairs[touching++] = pair;
     }
+    touchingPairs.resize(touching);
 }
 
-void FlatWorld::NarrowPhase() {
-    for (auto& pair : contactPair) {
-        FlatVector normal;
-        float depth;
-        FlatBody*& bodyA = bodyList[get<0>(pair)];
-        FlatBody*& bodyB = bodyList[get<1>(pair)];
+void FlatWorld::BuildContactEvents() {
+    // the last collision pass's touching pairs, merged with the previous Step's; both
+    // lists are in index order since removals keep the order of the remaining bodies
+    pairConstraints.assign(contactPair.size(), -1);
+    for (int k = 0; k < islandPairs.size(); k++) {
+        pairConstraints[islandPairs[k]] = k;
+    }
+
+    std::vector<std::pair<FlatBody*, FlatBody*>>& previous = previousTouchingPairs;
+    previous.swap(touchingPairs);
+    touchingPairs.clear();
+    size_t next = 0;
+    std::vector<ContactEvent>* lastEvents = nullptr;
 
-        if (Collisions::Collide(bodyA, bodyB, normal, depth)) {
-            SeparateBodies(bodyA, bodyB, normal * depth);
+    for (int p = 0; p < contactPair.size(); p++) {
+        if (!pairResults[p].b_Colliding || pairConstraints[p] < 0) continue;
 
-            FlatVector contact1, contact2;
-            int contactCount;
+        int i = std::get<0>(contactPair[p]);
+        int j = std::get<1>(contactPair[p]);
+        const FlatContactSolver::Constraint& c = constraints[pairConstraints[p]];
+        float normalImpulse = stepMode == SoftStep ? c.soft[0].normalImpulse + c.soft[1].normalImpulse : c.normalImpulse;
 
-            Collisions::FindContactPoints(bodyA, bodyB, contact1, contact2, contactCount);
-            FlatManifold contact(bodyA, bodyB, normal, depth, contact1, contact2, contactCount);
-            ResolveCollisionWithRotationAndFriction(contact);
+        // the fixture pairs of two bodies are adjacent and make one event with the first one's point
+        if (lastEvents && touchingPairs.back().first == bodyList[i] && touchingPairs.back().second == bodyList[j]) {
+            lastEvents->back().normalImpulse += normalImpulse;
+            continue;
+        }
+
+        for (; next < previous.size() && std::make_tuple(previous[next].first->index, previous[next].second->index) < std::make_tuple(i, j); next++) {
+            ContactEvent e;
+            e.bodyA = previous[next].first;
+            e.bodyB = previous[next].second;
+            endEvents.push_back(e);
         }
 
+        bool b_Persisting = next < previous.size() && previous[next].first->index == i && previous[next].second->index == j;
+        if (b_Persisting) next++;
+
+        ContactEvent e;
+        e.bodyA = bodyList[i];
+        e.bodyB = bodyList[j];
+        e.point = c.basePositionA + c.ra[0];
+        e.normal = c.bodyA == e.bodyA ? c.normal : -c.normal;
+        e.normalImpulse = normalImpulse;
+
+        lastEvents = b_Persisting ? &persistEvents : &beginEvents;
+        lastEvents->push_back(e);
+        touchingPairs.emplace_back(e.bodyA, e.bodyB);
+    }
+
+    for (; next < previous.size(); next++) {
+        ContactEvent e;
+        e.bodyA = previous[next].first;
+        e.bodyB = previous[next].second;
+        endEvents.push_back(e);
+    }
+}
+
+bool FlatWorld::RayCast(const FlatVector& p1, const FlatVector& p2, RayCastHit& hit) {
+    hit = RayCastHit();
+    if (b_StaticTreeDirty) RebuildStaticTree();
+
+    // the dynamic tree starts from the closest static hit
+    float closest = 1.0f;
+
+    for (FlatDynamicTree* tree : { &staticTree, &dynamicTree }) {
+        tree->RayCast(p1, p2, [&](const int& proxyId, const float& maxFraction) {
+            FlatBody* body = tree->GetBody(proxyId);
+            float fraction;
+            FlatVector normal;
+
+            if (!Collisions::RayCastBody(p1, p2, body, fraction, normal) || fraction > std::min(maxFraction, closest)) {
+                return maxFraction;
+            }
+
+            closest = fraction;
+            hit.body = body;
+            hit.fraction = fraction;
+            hit.normal = normal;
+            hit.point = p1 + fraction * (p2 - p1);
+            return fraction;
+        });
+    }
+
+    return hit.body != nullptr;
+}
+
+size_t FlatWorld::RayCastAll(const FlatVector& p1, const FlatVector& p2, std::vector<RayCastHit>& hits) {
+    hits.clear();
+    if (b_StaticTreeDirty) RebuildStaticTree();
+
+    for (FlatDynamicTree* tree : { &staticTree, &dynamicTree }) {
+        tree->RayCast(p1, p2, [&](const int& proxyId, const float& maxFraction) {
+            RayCastHit hit;
+            hit.body = tree->GetBody(proxyId);
+
+            if (Collisions::RayCastBody(p1, p2, hit.body, hit.fraction, hit.normal)) {
+                hit.point = p1 + hit.fraction * (p2 - p1);
+                hits.push_back(hit);
+            }
+            return maxFraction;
+        });
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const RayCastHit& a, const RayCastHit& b) {
+        return a.fraction < b.fraction;
+    });
+
+    return hits.size();
+}
+
+size_t FlatWorld::QueryAABB(const FlatAABB& aabb, std::vector<FlatBody*>& bodies, const bool& b_Exact) {
+    bodies.clear();
+    if (b_StaticTreeDirty) RebuildStaticTree();
+
+    for (FlatDynamicTree* tree : { &staticTree, &dynamicTree }) {
+        tree->Query(aabb, [&](const int& proxyId) {
+            FlatBody* body = tree->GetBody(proxyId);
+
+            if (b_Exact ? Collisions::IntersectBodyAABB(body, aabb) : Collisions::IntersectAABB(body->GetAABB(), aabb)) {
+                bodies.push_back(body);
+            }
+            return true;
+        });
+    }
+
+    return bodies.size();
+}
+
+size_t FlatWorld::QueryPoint(const FlatVector& point, std::vector<FlatBody*>& bodies) {
+    bodies.clear();
+    if (b_StaticTreeDirty) RebuildStaticTree();
+
+    for (FlatDynamicTree* tree : { &staticTree, &dynamicTree }) {
+        tree->Query(FlatAABB(point, point), [&](const int& proxyId) {
+            FlatBody* body = tree->GetBody(proxyId);
+
+            if (Collisions::PointInBody(point, body)) {
+                bodies.push_back(body);
+            }
+            return true;
+        });
+    }
+
+    return bodies.size();
+}
+
+void FlatWorld::StepBodies(const int& begin, const int& end) {
+    // integrate and refresh the AABB while the body is still in cache
+    for (int i = begin; i < end; i++) {
+        FlatBody* body = dynamicBodies[i];
+        body->Step(gravity, stepIterations, stepDt);
+        body->GetAABB();
+    }
+}
+
+void FlatWorld::UpdateProxies() {
+    if (b_StaticTreeDirty) RebuildStaticTree();
+
+    for (auto& body : dynamicBodies) {
+        dynamicTree.MoveProxy(body->proxyId, body->GetAABB());
+    }
+}
+
+void FlatWorld::RebuildStaticTree() {
+    // in index order, so the layout only depends on the static bodies themselves
+    staticTree.Clear();
+    for (auto& body : bodyList) {
+        if (body->b_IsStatic) {
+            body->proxyId = staticTree.CreateProxy(body->GetAABB(), body);
+        }
+    }
+
+    b_StaticTreeDirty = false;
+}
+
+void FlatWorld::FindPairs(const int& begin, const int& end) {
+    std::vector<ContactPair>& pairs = pairChunks[begin / FIND_PAIRS_CHUNK_SIZE];
+    pairs.clear();
+
+    for (int k = begin; k < end; k++) {
+        FlatBody* body = dynamicBodies[k];
+        FlatAABB bodyAabb = body->GetAABB();
+
+        staticTree.Query(bodyAabb, [&](const int& proxyId) {
+            FlatBody* other = staticTree.GetBody(proxyId);
+
+            if (Collisions::IntersectAABB(bodyAabb, other->GetAABB())) {
+                if (body->index < other->index) AddFixturePairs(pairs, body, other);
+                else AddFixturePairs(pairs, other, body);
+            }
+            return true;
+        });
+
+        dynamicTree.Query(bodyAabb, [&](const int& proxyId) {
+            FlatBody* other = dynamicTree.GetBody(proxyId);
+
+            // each dynamic pair is found from both sides, keep it once
+            if (other->index <= body->index) {
+                return true;
+            }
+
+            if (Collisions::IntersectAABB(other->GetAABB(), bodyAabb)) {
+                AddFixturePairs(pairs, body, other);
+            }
+            return true;
+        });
+    }
+}
+
+void FlatWorld::AddFixturePairs(std::vector<ContactPair>& pairs, FlatBody* bodyA, FlatBody* bodyB) {
+    bool b_FixturesA = bodyA->shapeType == FlatBody::Compound || bodyA->shapeType == FlatBody::Chain;
+    bool b_FixturesB = bodyB->shapeType == FlatBody::Compound || bodyB->shapeType == FlatBody::Chain;
+    if (!b_FixturesA && !b_FixturesB) {
+        pairs.emplace_back(bodyA->index, bodyB->index, 0, 0);
+        return;
+    }
+
+    // the bodies' AABBs overlap; a compound's or chain's hierarchy narrows that down to the
+    // fixtures near the other body, so a body on long terrain only meets the segments under it
+    FlatAABB aabbB = bodyB->GetAABB();
+    bodyA->QueryFixtures(aabbB, [&](const int& fixtureA) {
+        FlatAABB aabbA = bodyA->GetFixtureAABB(fixtureA);
+        if (!Collisions::IntersectAABB(aabbA, aabbB)) return true;
+
+        bodyB->QueryFixtures(aabbA, [&](const int& fixtureB) {
+            if (Collisions::IntersectAABB(aabbA, bodyB->GetFixtureAABB(fixtureB))) {
+                pairs.emplace_back(bodyA->index, bodyB->index, fixtureA, fixtureB);
+            }
+            return true;
+        });
+        return true;
+    });
+}
+
+int FlatWorld::PreparePairs() {
+    // the last detection's pairs and axes become the cache, still in pair order; a removal
+    // clears the axes, since its index shift would pin them on the wrong pairs
+    axisPairs.swap(contactPair);
+    cachedAxes.swap(pairAxes);
+    if (cachedAxes.size() != axisPairs.size()) axisPairs.clear();
+
+    contactPair.clear();
+    for (auto& pairs : pairChunks) {
+        contactPair.insert(contactPair.end(), pairs.begin(), pairs.end());
+    }
+
+    // same order as an all-pairs sweep, so results don't depend on the tree layout or thread count
+    std::sort(contactPair.begin(), contactPair.end());
+
+    pairResults.resize(contactPair.size());
+    pairAxes.resize(contactPair.size());
+    return (int)contactPair.size();
+}
+
+void FlatWorld::CollidePairs(const int& begin, const int& end) {
+    // both pair lists are sorted: one search per chunk, then a merge finds each pair's last axis
+    if (begin == end) return;
+    int cached = (int)(std::lower_bound(axisPairs.begin(), axisPairs.end(), contactPair[begin]) - axisPairs.begin());
+    int cachedCount = (int)axisPairs.size();
+
+    for (int p = begin; p < end; p++) {
+        FlatBody* bodyA = bodyList[std::get<0>(contactPair[p])];
+        FlatBody* bodyB = bodyList[std::get<1>(contactPair[p])];
+        PairResult& result = pairResults[p];
+
+        result.cachedAxis = -1;
+        while (cached < cachedCount && axisPairs[cached] < contactPair[p]) cached++;
+        if (cached < cachedCount && axisPairs[cached] == contactPair[p]) {
+            result.cachedAxis = cachedAxes[cached++];
+        }
+
+        int axis = result.cachedAxis;
+        result.b_Colliding = Collisions::Collide(bodyA, std::get<2>(contactPair[p]), bodyB, std::get<3>(contactPair[p]),
+            result.normal, result.depth, axis);
+        pairAxes[p] = (int8_t)axis;
+    }
+}
+
+void FlatWorld::CountAxisCache(const int& pair) {
+    if (pairResults[pair].cachedAxis < 0) return;
+
+    stepStats.axisCacheLookups++;
+    if (pairAxes[pair] == pairResults[pair].cachedAxis) stepStats.axisCacheHits++;
+}
+
+int FlatWorld::FindIsland(int body) {
+    while (islandParent[body] != body) {
+        islandParent[body] = islandParent[islandParent[body]];
+        body = islandParent[body];
+    }
+    return body;
+}
+
+void FlatWorld::BuildIslands() {
+    int bodyCount = (int)bodyList.size();
+    islandParent.resize(bodyCount);
+    for (int i = 0; i < bodyCount; i++) {
+        islandParent[i] = i;
+    }
+
+    // static bodies don't move, so they never join two islands
+    for (int p = 0; p < contactPair.size(); p++) {
+        CountAxisCache(p);
+        if (!pairResults[p].b_Colliding) continue;
+
+        int a = std::get<0>(contactPair[p]);
+        int b = std::get<1>(contactPair[p]);
+        if (bodyList[a]->b_IsStatic || bodyList[b]->b_IsStatic) continue;
+
+        int rootA = FindIsland(a);
+        int rootB = FindIsland(b);
+        if (rootA != rootB) {
+            islandParent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+        }
+    }
+
+    // islands are numbered by their first pair, pairs keep their order inside an island
+    islandOfRoot.assign(bodyCount, -1);
+    islandOffsets.assign(1, 0);
+    auto islandOf = [this](const int& p) {
+        int a = std::get<0>(contactPair[p]);
+        return FindIsland(bodyList[a]->b_IsStatic ? std::get<1>(contactPair[p]) : a);
+    };
+
+    std::vector<int> pairIsland(contactPair.size(), -1);
+    for (int p = 0; p < contactPair.size(); p++) {
+        if (!pairResults[p].b_Colliding) continue;
+
+        int root = islandOf(p);
+        if (islandOfRoot[root] < 0) {
+            islandOfRoot[root] = (int)islandOffsets.size() - 1;
+            islandOffsets.push_back(0);
+        }
+        pairIsland[p] = islandOfRoot[root];
+        islandOffsets[pairIsland[p] + 1]++;
+    }
+
+    for (int i = 1; i < islandOffsets.size(); i++) {
+        islandOffsets[i] += islandOffsets[i - 1];
+    }
+
+    std::vector<int> cursor(islandOffsets.begin(), islandOffsets.end() - 1);
+    islandPairs.resize(islandOffsets.back());
+    for (int p = 0; p < contactPair.size(); p++) {
+        if (pairIsland[p] >= 0) {
+            islandPairs[cursor[pairIsland[p]]++] = p;
+        }
+    }
+
+    constraints.resize(islandPairs.size());
+    bodyGroups.resize(bodyCount);
+
+    stepStats.contactCount += islandPairs.size();
+}
+
+void FlatWorld::PrepareContacts(const int& begin, const int& end) {
+    // positional correction and contact points pair by pair, in island order
+    for (int k = islandOffsets[begin]; k < islandOffsets[end]; k++) {
+        PrepareContact(k);
+    }
+}
+
+void FlatWorld::PrepareContact(const int& k) {
+    int pair = islandPairs[k];
+    FlatBody* bodyA = bodyList[std::get<0>(contactPair[pair])];
+    FlatBody* bodyB = bodyList[std::get<1>(contactPair[pair])];
+    int fixtureA = std::get<2>(contactPair[pair]);
+    int fixtureB = std::get<3>(contactPair[pair]);
+    FlatVector normal = pairResults[pair].normal;
+    float depth = pairResults[pair].depth;
+
+    // an earlier fixture pair of the same compound or chain may already have pushed the bodies apart
+    bool b_Compound = bodyA->shapeType == FlatBody::Compound || bodyB->shapeType == FlatBody::Compound ||
+        bodyA->shapeType == FlatBody::Chain || bodyB->shapeType == FlatBody::Chain;
+    if (b_Compound && !Collisions::Collide(bodyA, fixtureA, bodyB, fixtureB, normal, depth)) {
+        normal = pairResults[pair].normal;
+        depth = 0.0f;
+    }
+
+    SeparateBodies(bodyA, bodyB, normal * depth);
+
+    FlatVector contact1, contact2;
+    int contactCount;
+
+    Collisions::FindContactPoints(bodyA, fixtureA, bodyB, fixtureB, contact1, contact2, contactCount);
+    FlatManifold contact(bodyA, bodyB, normal, depth, contact1, contact2, contactCount);
+    constraints[k] = FlatContactSolver::MakeConstraint(contact);
+}
+
+void FlatWorld::ColorConstraints() {
+    // Greedy coloring in constraint order: the lowest color neither dynamic body uses yet.
+    // Static bodies are never written by the solver, so they may appear in every color.
+    int count = (int)islandPairs.size();
+    bodyColors.assign(bodyList.size(), 0);
+
+    std::vector<int> colors(count);
+    colorOffsets.assign(COLOR_COUNT + 2, 0);
+
+    for (int k = 0; k < count; k++) {
+        int pair = islandPairs[k];
+        int a = std::get<0>(contactPair[pair]);
+        int b = std::get<1>(contactPair[pair]);
+        bool b_StaticA = bodyList[a]->b_IsStatic;
+        bool b_StaticB = bodyList[b]->b_IsStatic;
+
+        uint32_t used = (b_StaticA ? 0u : bodyColors[a]) | (b_StaticB ? 0u : bodyColors[b]);
+
+        int color = 0;
+        while (color < COLOR_COUNT && (used & (1u << color))) color++;
+
+        if (color < COLOR_COUNT) {
+            if (!b_StaticA) bodyColors[a] |= 1u << color;
+            if (!b_StaticB) bodyColors[b] |= 1u << color;
+        }
+
+        colors[k] = color;
+        colorOffsets[color + 1]++;
+    }
+
+    for (int color = 0; color <= COLOR_COUNT; color++) {
+        colorOffsets[color + 1] += colorOffsets[color];
+    }
+
+    std::vector<int> cursor(colorOffsets.begin(), colorOffsets.end() - 1);
+    colorConstraints.resize(count);
+    for (int k = 0; k < count; k++) {
+        colorConstraints[cursor[colors[k]]++] = &constraints[k];
+    }
+}
+
+void FlatWorld::PrepareSoftContacts(const int& begin, const int& end) {
+    // contact points on the current positions; overlap is left to the soft bias
+    float h = stepDt / stepIterations;
+    float hertz = std::min(contactHertz, 0.25f / h);
+
+    for (int k = islandOffsets[begin]; k < islandOffsets[end]; k++) {
+        int pair = islandPairs[k];
+        FlatBody* bodyA = bodyList[std::get<0>(contactPair[pair])];
+        FlatBody* bodyB = bodyList[std::get<1>(contactPair[pair])];
+        const PairResult& result = pairResults[pair];
+
+        FlatVector contact1, contact2;
+        float separations[2];
+        int contactCount;
+
+        // the SAT depth is the deepest point's, each point gets its own gap so a tilted body is pushed back level
+        Collisions::FindContactPoints(bodyA, std::get<2>(contactPair[pair]), bodyB, std::get<3>(contactPair[pair]), result.normal, result.depth,
+            contact1, contact2, separations[0], separations[1], contactCount);
+        FlatManifold contact(bodyA, bodyB, result.normal, result.depth, contact1, contact2, contactCount);
+        constraints[k] = FlatContactSolver::MakeConstraint(contact);
+
+        float pairHertz = bodyA->b_IsStatic || bodyB->b_IsStatic ? 2.0f * hertz : hertz;
+        FlatContactSolver::Softness softness = FlatContactSolver::Softness::Make(pairHertz, contactDampingRatio, h);
+        FlatContactSolver::PrepareSoft(constraints[k], separations, softness);
+
+        // warm start from the same pair's nearest contact point of the last Step
+        FlatVector contacts[2] = { contact1, contact2 };
+        auto cached = std::lower_bound(cachedPairs.begin(), cachedPairs.end(), contactPair[pair]);
+        if (cached == cachedPairs.end() || *cached != contactPair[pair]) continue;
+
+        const CachedImpulse& impulse = cachedImpulses[cached - cachedPairs.begin()];
+        FlatContactSolver::Constraint& c = constraints[k];
+
+        // the same force over a substep of another length, when the substep count or dt changed
+        float scale = h / cachedSubstepDt;
+
+        for (int i = 0; i < c.contactCount; i++) {
+            for (int j = 0; j < impulse.contactCount; j++) {
+                if (FlatMath::DistanceSquared(contacts[i], impulse.contacts[j]) > WARM_START_DISTANCE * WARM_START_DISTANCE) continue;
+
+                c.soft[i].normalImpulse = impulse.normalImpulse[j] * scale;
+                c.soft[i].tangentImpulse = impulse.tangentImpulse[j] * scale;
+                break;
+            }
+        }
+    }
+}
+
+void FlatWorld::StoreImpulses(const int& begin, const int& end) {
+    for (int k = begin; k < end; k++) {
+        const FlatContactSolver::Constraint& c = constraints[k];
+        CachedImpulse& impulse = cachedImpulses[islandPairs[k]];
+
+        impulse.contactCount = c.contactCount;
+        for (int i = 0; i < c.contactCount; i++) {
+            impulse.contacts[i] = c.basePositionA + c.ra[i];
+            impulse.normalImpulse[i] = c.soft[i].normalImpulse;
+            impulse.tangentImpulse[i] = c.soft[i].tangentImpulse;
+        }
+    }
+}
+
+void FlatWorld::IntegrateVelocities(const int& begin, const int& end) {
+    float h = stepDt / stepIterations;
+    for (int i = begin; i < end; i++) {
+        dynamicBodies[i]->IntegrateVelocity(gravity, h);
+    }
+}
+
+void FlatWorld::IntegratePositions(const int& begin, const int& end) {
+    float h = stepDt / stepIterations;
+    for (int i = begin; i < end; i++) {
+        dynamicBodies[i]->IntegratePosition(h);
+    }
+}
+
+void FlatWorld::WriteBack(const int& begin, const int& end) {
+    // refresh the caches of bodies the solver moved
+    for (int i = begin; i < end; i++) {
+        dynamicBodies[i]->GetAABB();
     }
 }
 
@@ -195,122 +1488,3 @@ void FlatWorld::ResolveCollisionWithRotation(FlatManifold& contact) {
 
     }
 }
-
-void FlatWorld::ResolveCollisionWithRotationAndFriction(FlatManifold& contact) {
-    float restitution = std::min(contact.bodyA->restitution, contact.bodyB->restitution);
-
-    float staticFriction = (contact.bodyA->staticFriction + contact.bodyA->staticFriction) / 2.0f;
-    float dynamicFriction = (contact.bodyA->dynamicFriction + contact.bodyA->dynamicFriction) / 2.0f;
-
-    FlatVector contactList[2] = { contact.contact1, contact.contact2 };
-    FlatVector impulseList[2] = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
-    FlatVector frictionImpulseList[2] = {{ 0.0f, 0.0f }, { 0.0f, 0.0f }};
-    FlatVector raList[2] = {{ 0.0f, 0.0f }, { 0.0f, 0.0f }};
-    FlatVector rbList[2] = {{ 0.0f, 0.0f }, { 0.0f, 0.0f }};
-    float magnitudeList[2] = { 0.0f, 0.0f };
-
-    for (int i = 0; i < contact.contactCount; i++) {
-        FlatVector ra = contactList[i] - contact.bodyA->GetPosition();
-        FlatVector rb = contactList[i] - contact.bodyB->GetPosition();
-
-        raList[i] = ra;
-        rbList[i] = rb;
-
-        FlatVector raPerp(-ra.y, ra.x);
-        FlatVector rbPerp(-rb.y, rb.x);
-
-        FlatVector angularLinearVelocityA = raPerp * contact.bodyA->GetAngularVelocity();
-        FlatVector angularLinearVelocityB = rbPerp * contact.bodyB->GetAngularVelocity();
-
-        FlatVector relativeVelocity =
-            (contact.bodyB->GetLinearVelocity() + angularLinearVelocityB) -
-            (contact.bodyA->GetLinearVelocity() + angularLinearVelocityA);
-
-        float contactVelocityMagnitue = FlatMath::Dot(relativeVelocity, contact.normal);
-
-        if (contactVelocityMagnitue > 0.0f) {
-            continue;
-        }
-
-        float raPerpDotNormal = FlatMath::Dot(raPerp, contact.normal);
-        float rbPerpDotNormal = FlatMath::Dot(rbPerp, contact.normal);
-
-        float denominator = contact.bodyA->invMass + contact.bodyB->invMass +
-            (raPerpDotNormal * raPerpDotNormal) * contact.bodyA->invInertia +
-            (rbPerpDotNormal * rbPerpDotNormal) * contact.bodyB->invInertia;
-
-        float magnitude = -(1.0f + restitution) * contactVelocityMagnitue;
-        magnitude /= denominator * (float)contact.contactCount;
-
-        magnitudeList[i] = magnitude;
-
-        FlatVector impulse = magnitude * contact.normal;
-        impulseList[i] = impulse;
-    }
-
-    for (int i = 0; i < contact.contactCount; i++) {
-        FlatVector impulse = impulseList[i];
-
-        contact.bodyA->linearVelocity += -impulse * contact.bodyA->invMass;
-        contact.bodyA->angularVelocity += -FlatMath::Cross(raList[i], impulse) * contact.bodyA->invInertia;
-
-        contact.bodyB->linearVelocity += impulse * contact.bodyB->invMass;
-        contact.bodyB->angularVelocity += FlatMath::Cross(rbList[i], impulse) * contact.bodyB->invInertia;
-    }
-
-    // Friction
-    for (int i = 0; i < contact.contactCount; i++) {
-        FlatVector ra = contactList[i] - contact.bodyA->GetPosition();
-        FlatVector rb = contactList[i] - contact.bodyB->GetPosition();
-
-        raList[i] = ra;
-        rbList[i] = rb;
-
-        FlatVector raPerp(-ra.y, ra.x);
-        FlatVector rbPerp(-rb.y, rb.x);
-
-        FlatVector angularLinearVelocityA = raPerp * contact.bodyA->GetAngularVelocity();
-        FlatVector angularLinearVelocityB = rbPerp * contact.bodyB->GetAngularVelocity();
-
-        FlatVector relativeVelocity =
-            (contact.bodyB->GetLinearVelocity() + angularLinearVelocityB) -
-            (contact.bodyA->GetLinearVelocity() + angularLinearVelocityA);
-
-        FlatVector tangent = relativeVelocity - FlatMath::Dot(relativeVelocity, contact.normal) * contact.normal;
-
-        if (FlatMath::NearlyEqual(tangent, { 0.0f, 0.0f })) continue;
-        tangent = FlatMath::Normalize(tangent);
-
-        float raPerpDotTangent = FlatMath::Dot(raPerp, tangent);
-        float rbPerpDotTangent = FlatMath::Dot(rbPerp, tangent);
-
-        float denominator = contact.bodyA->invMass + contact.bodyB->invMass +
-            (raPerpDotTangent * raPerpDotTangent) * contact.bodyA->invInertia +
-            (rbPerpDotTangent * rbPerpDotTangent) * contact.bodyB->invInertia;
-
-        float tangentMagnitude = -FlatMath::Dot(relativeVelocity, tangent);
-        tangentMagnitude /= denominator * (float)contact.contactCount;
-        
-        FlatVector frictionImpulse;
-        float magnitude = magnitudeList[i];
-
-        if (abs(tangentMagnitude) <= magnitude * staticFriction) {
-            frictionImpulse = tangentMagnitude * tangent;
-        }
-        else {
-            frictionImpulse = -magnitude * tangent * dynamicFriction;
-        }
-
-        frictionImpulseList[i] = frictionImpulse;
-    }
-
-    for (int i = 0; i < contact.contactCount; i++) {
-        FlatVector frictionImpulse = frictionImpulseList[i];
-
-        contact.bodyA->linearVelocity += -frictionImpulse * contact.bodyA->invMass;
-        contact.bodyA->angularVelocity += -FlatMath::Cross(raList[i], frictionImpulse) * contact.bodyA->invInertia;
-
-        contact.bodyB->linearVelocity += frictionImpulse * contact.bodyB->invMass;
-        contact.bodyB->angularVelocity += FlatMath::Cross(rbList[i], frictionImpulse) * contact.bodyB->invInertia;
-    }
-}
\ No newline at end of file
@@ -1,19 +1,114 @@
 #pragma once
 #include <vector>
 #include <tuple>
+#include <cstdint>
+#include <functional>
 
-#include "raylib.h"
 #include "FlatBody.h"
 #include "FlatManifold.h"
+#include "FlatDynamicTree.h"
+#include "FlatThreadPool.h"
+#include "FlatTaskGraph.h"
+#include "FlatContactSolver.h"
+#include "FlatParticleSystem.h"
+#include "FlatCommandQueue.h"
 
 class FlatWorld {
+public:
+	// Substep reruns collision detection every iteration and applies one impulse pass.
+	// SoftStep detects collisions once per Step, then runs `iterations` substeps of
+	// integrate -> soft solve -> relax and applies restitution at the end.
+	enum StepMode {
+		Substep = 0,
+		SoftStep = 1
+	};
+
 private:
-	using ContactPair = std::tuple<int, int>;
+	// body indices, lower first, and a fixture of each; circles and boxes only have fixture 0
+	using ContactPair = std::tuple<int, int, int, int>;
 
 	FlatVector gravity;
 	std::vector<FlatBody*> bodyList;
 	std::vector<ContactPair> contactPair;
 
+	// Static bodies have their own tree, rebuilt only when a static body is added, removed or
+	// moved; a Step updates and queries from the dynamic bodies alone.
+	FlatDynamicTree staticTree;
+	FlatDynamicTree dynamicTree;
+	std::vector<FlatBody*> dynamicBodies; // in index order
+	bool b_StaticTreeDirty;
+
+	struct PairResult {
+		FlatVector normal;
+		float depth = 0.0f;
+		bool b_Colliding = false;
+		int8_t cachedAxis = -1; // box pairs: the SAT axis tested first, see Collisions::IntersectPolygons
+	};
+
+	int threadCount;
+	std::unique_ptr<FlatThreadPool> threadPool;
+
+	// Step pipeline, built on the first Step and rebuilt when the mode changes
+	// (or, for SoftStep, the substep count, since its substeps are unrolled)
+	FlatTaskGraph stepGraph;
+	StepMode graphMode;
+	int graphSubsteps;
+	int updateBroadPhaseTask, findPairsTask, collideTask, buildIslandsTask;
+	int prepareContactsTask, colorTask, writeBackTask;
+	std::vector<int> integrateTasks;
+	int stepIterations;
+	float stepDt;
+
+	StepMode stepMode;
+	bool b_AdaptiveSubsteps;
+	int minSubsteps;
+	int lastSubsteps; // 0 before the first adaptive Step
+	float contactHertz;
+	float contactDampingRatio;
+
+	// SoftStep impulses of the last Step by pair, to warm start the next one.
+	// Cleared when bodies are removed, since that shifts the pair indices.
+	struct CachedImpulse {
+		FlatVector contacts[2];
+		float normalImpulse[2] = { 0.0f, 0.0f };
+		float tangentImpulse[2] = { 0.0f, 0.0f };
+		int contactCount = 0;
+	};
+
+	int storeImpulsesTask;
+	float cachedSubstepDt; // impulses scale with the substep length, see PrepareSoftContacts
+	std::vector<ContactPair> cachedPairs;
+	std::vector<CachedImpulse> cachedImpulses;
+
+	std::vector<std::vector<ContactPair>> pairChunks;
+	std::vector<PairResult> pairResults;
+
+	// SAT axis each box pair ended on, -1 for other pairs, parallel to contactPair. PreparePairs
+	// keeps the last detection's as the cache the next one merges against. Removing bodies
+	// drops them like the impulses.
+	std::vector<int8_t> pairAxes;
+	std::vector<ContactPair> axisPairs;
+	std::vector<int8_t> cachedAxes;
+
+	std::vector<int> islandParent;
+	std::vector<int> islandOfRoot;
+	std::vector<int> islandOffsets;
+	std::vector<int> islandPairs;
+
+	FlatContactSolver::Path solverPath;
+	std::vector<FlatContactSolver::Constraint> constraints; // parallel to islandPairs
+	std::vector<int> bodyGroups;
+
+	// constraints by graph color, [colorOffsets[c], colorOffsets[c + 1]); the last range is the overflow
+	std::vector<uint32_t> bodyColors;
+	std::vector<FlatContactSolver::Constraint*> colorConstraints;
+	std::vector<int> colorOffsets;
+
+	std::unique_ptr<FlatAABB> bounds;
+	std::vector<FlatBody*> removedBodies;
+
+	FlatParticleSystem particles;
+
 public:
 	static const float MIN_BODY_SIZE;  // m^2
 	static const float MAX_BODY_SIZE;
@@ -21,8 +116,118 @@ public:
 	static const float MIN_DENSITY; // g/cm^3
 	static const float MAX_DENSITY;
 
-	static const int MIN_ITERATIONS = 1;
-	static const int MAX_ITERATIONS = 128;
+	static constexpr int MIN_ITERATIONS = 1;
+	static constexpr int MAX_ITERATIONS = 128;
+
+	// Work items per task chunk; a chunk of bodies and their vertex caches stays within L2
+	static constexpr int INTEGRATION_CHUNK_SIZE = 256;
+	static constexpr int FIND_PAIRS_CHUNK_SIZE = 128;
+	static constexpr int COLLIDE_CHUNK_SIZE = 64;
+	static constexpr int PREPARE_CHUNK_SIZE = 8; // islands
+	static constexpr int COLOR_CHUNK_SIZE = 64;  // constraints, a multiple of the SIMD width
+
+	// Constraints that find no free color among these go to the serial overflow
+	static constexpr int COLOR_COUNT = 24;
+
+	static constexpr float DEFAULT_CONTACT_HERTZ = 30.0f;
+	static constexpr float DEFAULT_CONTACT_DAMPING_RATIO = 10.0f;
+
+	// m, a contact point further than this from last Step's starts cold
+	static constexpr float WARM_START_DISTANCE = 0.1f;
+
+	// Adaptive substeps: no moving body travels more than this share of the smallest moving
+	// body's extent in one substep. Bodies slower than ADAPTIVE_REST_SPEED (m/s) don't count.
+	static constexpr float ADAPTIVE_DISPLACEMENT = 0.25f;
+	static constexpr float ADAPTIVE_REST_SPEED = 0.05f;
+	static constexpr int DEFAULT_MIN_SUBSTEPS = 4; // a resting pile's soft contacts jitter below 3
+
+	// Phase timings (milliseconds) and counters of the last Step, summed over its iterations.
+	struct StepStats {
+		double integrateTime = 0.0;
+		double broadPhaseTime = 0.0;
+		double narrowPhaseTime = 0.0;
+		double criticalPathTime = 0.0;
+		double particleTime = 0.0;
+		size_t pairCount = 0;
+		size_t contactCount = 0;
+		size_t islandCount = 0;
+		size_t colorCount = 0;    // colors in use, summed over iterations
+		size_t overflowCount = 0; // constraints solved serially
+		int substepCount = 0;     // the iterations Step ran, chosen by it when adaptive
+		size_t commandCount = 0;  // applied at its start
+		size_t staleCommandCount = 0; // of those, skipped since their handle was dead
+		size_t axisCacheLookups = 0; // box pairs whose SAT started from the last detection's axis
+		size_t axisCacheHits = 0;    // of those, the axis still separated them or still overlapped least
+	};
+
+	// A pair of bodies that started, kept or stopped touching during the last Step. Bodies are
+	// in index order and the normal points from bodyA to bodyB. normalImpulse sums the normal
+	// impulses of the last solve over all contact points and, for compounds, all touching
+	// fixtures; end events only carry the bodies.
+	struct ContactEvent {
+		FlatBody* bodyA = nullptr;
+		FlatBody* bodyB = nullptr;
+		FlatVector point;
+		FlatVector normal;
+		float normalImpulse = 0.0f;
+	};
+
+	// A fixture pair the broadphase reported, with its narrowphase result. Contacts are only
+	// found for colliding pairs.
+	struct CollisionRecord {
+		FlatBody* bodyA = nullptr;
+		FlatBody* bodyB = nullptr;
+		int fixtureA = 0;
+		int fixtureB = 0;
+		bool b_Colliding = false;
+		FlatVector normal;
+		float depth = 0.0f;
+		FlatVector contacts[2];
+		int contactCount = 0;
+	};
+
+	struct RayCastHit {
+		FlatBody* body = nullptr;
+		FlatVector point;
+		FlatVector normal;
+		float fraction = 0.0f;
+	};
+
+	// Names a body in this world without pointing at it: a slot of the world's handle table and
+	// the slot's generation. Leaving the world moves the generation on, so a handle kept past
+	// that is dead instead of dangling, even once the body is deleted or the slot reused.
+	struct BodyHandle {
+		int slot = -1;
+		uint32_t generation = 0;
+	};
+
+	// A body mutation queued from any thread with Enqueue. vector is the position, velocity,
+	// impulse or force, point is where an impulse acts (world space) and value the angle or
+	// angular velocity. Impulses, forces and velocities don't apply to static bodies.
+	// Add takes the body itself; the others name it by handle and are skipped once it is dead.
+	struct Command {
+		enum Type {
+			Add = 0,
+			Remove = 1,
+			MoveTo = 2,
+			RotateTo = 3,
+			SetLinearVelocity = 4,
+			SetAngularVelocity = 5,
+			ApplyImpulse = 6,
+			AddForce = 7
+		};
+
+		Type type = Add;
+		FlatBody* body = nullptr; // Add only
+		BodyHandle handle;        // all but Add
+		FlatVector vector;
+		FlatVector point;
+		float value = 0.0f;
+
+		// commands apply by source, lowest first, each source's in the order it queued them;
+		// a source queueing from one thread at a time keeps the order deterministic
+		int source = 0;
+	};
 
 public:
 	FlatWorld();
@@ -30,16 +235,159 @@ public:
 
 	void AddBody(FlatBody*& body);
 	void RemoveBody(FlatBody*& body);
+
+	// Same as RemoveBody for each, in one pass over the body list
+	void RemoveBodies(const std::vector<FlatBody*>& bodies);
 	bool GetBody(const int& id, FlatBody*& body);
+	bool GetBodyIndex(FlatBody* body, int& id) const;
+
+	// A body gets a new handle each time it is added; outside the world it has none (slot -1).
+	// Handles are handed out and resolved on the thread that steps the world.
+	BodyHandle GetHandle(FlatBody* body) const;
+	bool GetBody(const BodyHandle& handle, FlatBody*& body) const;
 	void Step(int iterations, float dt);
 	size_t BodyCount() const;
 
+	// Call after moving or rotating a static body that is already in the world
+	void MarkStaticsChanged();
+
+	// Moves the coordinate system so newOrigin becomes (0, 0): every body, the bounds and the
+	// warm start cache are shifted by -newOrigin. Keeps positions small in large maps.
+	void ShiftOrigin(const FlatVector& newOrigin);
+
+	// Forgets everything carried from one Step to the next: warm start impulses, cached SAT axes,
+	// touching pairs and their events, removed and added body lists and the adaptive substep
+	// count. The next Step then runs as in a new world holding the same bodies.
+	void ResetCaches();
+
+	// Threads used by Step, including the calling one. Workers are created on the
+	// next Step and then persist; 1 keeps the world single-threaded.
+	void SetThreadCount(const int& count);
+	int GetThreadCount() const;
+
+	// Dynamic bodies whose AABB leaves the bounds are taken out of the world at the end of Step.
+	// They are listed by GetRemovedBodies until the next Step, after the bodies Remove commands
+	// took out at its start; deleting them is up to the owner.
+	void SetBounds(const FlatAABB& bounds);
+	void ClearBounds();
+	const std::vector<FlatBody*>& GetRemovedBodies() const;
+
+	// Contact events of the last Step, found by diffing its touching pairs against the
+	// previous Step's. Bodies taken out by the bounds get end events; bodies removed
+	// with RemoveBody don't.
+	const std::vector<ContactEvent>& GetContactBeginEvents() const;
+	const std::vector<ContactEvent>& GetContactPersistEvents() const;
+	const std::vector<ContactEvent>& GetContactEndEvents() const;
+
+	// Lock-free and callable from any thread while another steps the world. The commands are
+	// applied at the start of the next Step. Commands whose handle died before then, e.g. as the
+	// bounds took the body out and its owner deleted it, are skipped and counted in StepStats.
+	// The bodies of Add commands still queued when the world is destroyed stay the caller's.
+	void Enqueue(const Command& command);
+
+	// Applies the queued commands now. Step applies them first unless this was called since the
+	// last Step, so an owner can see the bodies added (GetAddedBodies) before they move. Each
+	// body is listed once: one removed and added back in the same batch is in neither list,
+	// one added and then removed is in both.
+	void ApplyCommands();
+	const std::vector<FlatBody*>& GetAddedBodies() const;
+
+	void SetStepMode(const StepMode& mode);
+	StepMode GetStepMode() const;
+
+	// When enabled, Step picks its substep count from the fastest moving body each call: its
+	// iterations argument becomes the upper cap and minSubsteps the lower one. The count rises
+	// at once and falls by at most half per Step. Off by default.
+	void SetAdaptiveSubsteps(const bool& b_Enabled, const int& minSubsteps = DEFAULT_MIN_SUBSTEPS);
+	bool IsAdaptiveSubsteps() const;
+	int GetMinSubsteps() const;
+
+	// Spring frequency (Hz) and damping ratio of SoftStep contacts. Per contact the frequency
+	// is capped at a quarter of the substep rate and doubled against static bodies.
+	void SetContactSoftness(const float& hertz, const float& dampingRatio);
+	float GetContactHertz() const;
+	float GetContactDampingRatio() const;
+
+	// Wide (the default) solves contacts in SIMD groups and matches Scalar exactly
+	void SetSolverPath(const FlatContactSolver::Path& path);
+	FlatContactSolver::Path GetSolverPath() const;
+
+	const StepStats& GetStepStats() const;
+
+	// Stepped after the bodies with the world's gravity, pool and bounds, and part of Checksum
+	FlatParticleSystem& GetParticles();
+
+	// Broadphase and narrowphase of the current positions through the same trees, chunks and
+	// threads as Step, without moving anything, so contacts are found before separation.
+	// Records come in Step's pair order. Overwrites the phase times and counts of GetStepStats.
+	size_t DetectCollisions(std::vector<CollisionRecord>& records);
+
+	// Per-task timings of the substep pipeline; totalTime sums the last Step's substeps.
+	const FlatTaskGraph& GetStepGraph() const;
+	uint64_t Checksum() const;
+
+	// Queries run against the broadphase trees; dynamic proxies are refreshed by Step
+	bool RayCast(const FlatVector& p1, const FlatVector& p2, RayCastHit& hit);
+	size_t RayCastAll(const FlatVector& p1, const FlatVector& p2, std::vector<RayCastHit>& hits);
+	size_t QueryAABB(const FlatAABB& aabb, std::vector<FlatBody*>& bodies, const bool& b_Exact = false);
+	size_t QueryPoint(const FlatVector& point, std::vector<FlatBody*>& bodies);
+
 private:
-	void StepBodies(const int& totalItertaion, const float& dt);
-	void BroadPhase();
-	void NarrowPhase();
+	StepStats stepStats;
+
+	// touching pairs of the last Step in index order, lower index first
+	std::vector<std::pair<FlatBody*, FlatBody*>> touchingPairs;
+	std::vector<std::pair<FlatBody*, FlatBody*>> previousTouchingPairs;
+	std::vector<int> pairConstraints; // scratch, constraint of each pair or -1
+	std::vector<ContactEvent> beginEvents;
+	std::vector<ContactEvent> persistEvents;
+	std::vector<ContactEvent> endEvents;
+
+	FlatCommandQueue<Command> commandQueue;
+	std::vector<Command> commands; // scratch of ApplyCommands
+	std::vector<FlatBody*> commandRemovals;
+	std::vector<FlatBody*> addedBodies;
+	size_t appliedCommandCount;
+	size_t staleCommandCount;
+
+	// handle slots: the body in each (null while free) and its generation
+	std::vector<FlatBody*> handleBodies;
+	std::vector<uint32_t> handleGenerations;
+	std::vector<int> freeHandles;
+	bool b_CommandsApplied;
+
+	using ConstraintRange = std::function<void(FlatContactSolver::Constraint* const* constraints, int count)>;
+
+	void ApplyCommand(const Command& command);
+	void FlushRemovals();
+	void IssueHandle(FlatBody* body);
+	void ReleaseHandle(FlatBody* body);
+	int ChooseSubsteps(const int& maxSubsteps, const float& dt);
+	void BuildStepGraph();
+	void BuildSoftStepGraph(const int& substeps);
+	int AddColorStage(const char* name, const char* overflowName, const std::vector<int>& after,
+		const ConstraintRange& color, const ConstraintRange& overflow);
+	void StepBodies(const int& begin, const int& end);
+	void UpdateProxies();
+	void RebuildStaticTree();
+	void RemoveEscapedBodies();
+	void BuildContactEvents();
+	int PreparePairs();
+	void FindPairs(const int& begin, const int& end);
+	void AddFixturePairs(std::vector<ContactPair>& pairs, FlatBody* bodyA, FlatBody* bodyB);
+	void CollidePairs(const int& begin, const int& end);
+	void CountAxisCache(const int& pair);
+	void BuildIslands();
+	int FindIsland(int body);
+	void PrepareContacts(const int& begin, const int& end);
+	void PrepareContact(const int& k);
+	void ColorConstraints();
+	void PrepareSoftContacts(const int& begin, const int& end);
+	void StoreImpulses(const int& begin, const int& end);
+	void IntegrateVelocities(const int& begin, const int& end);
+	void IntegratePositions(const int& begin, const int& end);
+	void WriteBack(const int& begin, const int& end);
 	void ResolveCollisionBasic(FlatManifold& contact);
 	void ResolveCollisionWithRotation(FlatManifold& contact);
-	void ResolveCollisionWithRotationAndFriction(FlatManifold& contact);
 	void SeparateBodies(FlatBody*& bodyA, FlatBody*& bodyB, const FlatVector& mtv);
 };    
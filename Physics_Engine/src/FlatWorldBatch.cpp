@@ -0,0 +1,232 @@
+#include "FlatWorldBatch.h"
+
+#include <algorithm>
+
+FlatWorldBatch::FlatWorldBatch(const int& worldCount, const int& threadCount) :
+	worlds(std::max(0, worldCount))
+{
+	for (auto& world : worlds) {
+		world.SetThreadCount(1);
+	}
+
+	if (threadCount > 1) {
+		threadPool = std::make_unique<FlatThreadPool>(threadCount);
+	}
+}
+
+int FlatWorldBatch::WorldCount() const {
+	return (int)worlds.size();
+}
+
+bool FlatWorldBatch::GetWorld(const int& index, FlatWorld*& world) {
+	if (index < 0 || index >= worlds.size()) {
+		world = nullptr;
+		return false;
+	}
+
+	world = &worlds[index];
+	return true;
+}
+
+void FlatWorldBatch::Capture() {
+	initialBodies.clear();
+	bodyOffsets.assign(1, 0);
+	slotBodies.clear();
+
+	for (auto& world : worlds) {
+		FlatBody* body = nullptr;
+		for (int i = 0; world.GetBody(i, body); i++) {
+			initialBodies.push_back(FlatScenario::Describe(body));
+			slotBodies.push_back(body);
+		}
+		bodyOffsets.push_back((int)initialBodies.size());
+	}
+
+	positions.assign(initialBodies.size(), FlatVector());
+	linearVelocities.assign(initialBodies.size(), FlatVector());
+	angles.assign(initialBodies.size(), 0.0f);
+	angularVelocities.assign(initialBodies.size(), 0.0f);
+
+	for (int i = 0; i < worlds.size(); i++) {
+		WriteObservations(i);
+	}
+}
+
+void FlatWorldBatch::Step(const int& iterations, const float& dt) {
+	if (bodyOffsets.size() != worlds.size() + 1) {
+		Capture();
+	}
+
+	ForEachWorld((int)worlds.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			FlatWorld& world = worlds[i];
+			world.Step(iterations, dt);
+
+			for (auto& body : world.GetRemovedBodies()) {
+				DropSlot(i, body);
+				delete body;
+			}
+
+			WriteObservations(i);
+		}
+	});
+}
+
+void FlatWorldBatch::Reset(const std::vector<int>& worldIndices) {
+	if (bodyOffsets.size() != worlds.size() + 1) {
+		Capture();
+		return;
+	}
+
+	ForEachWorld((int)worldIndices.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int index = worldIndices[i];
+			if (index < 0 || index >= worlds.size()) continue;
+
+			ResetWorld(index);
+			WriteObservations(index);
+		}
+	});
+}
+
+void FlatWorldBatch::ResetAll() {
+	std::vector<int> all(worlds.size());
+	for (int i = 0; i < all.size(); i++) {
+		all[i] = i;
+	}
+	Reset(all);
+}
+
+int FlatWorldBatch::GetBodyOffset(const int& world) const {
+	return bodyOffsets[world];
+}
+
+int FlatWorldBatch::GetBodyCapacity(const int& world) const {
+	return bodyOffsets[world + 1] - bodyOffsets[world];
+}
+
+const std::vector<FlatVector>& FlatWorldBatch::GetPositions() const {
+	return positions;
+}
+
+const std::vector<FlatVector>& FlatWorldBatch::GetLinearVelocities() const {
+	return linearVelocities;
+}
+
+const std::vector<float>& FlatWorldBatch::GetAngles() const {
+	return angles;
+}
+
+const std::vector<float>& FlatWorldBatch::GetAngularVelocities() const {
+	return angularVelocities;
+}
+
+uint64_t FlatWorldBatch::Checksum() const {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (auto& world : worlds) {
+		hash ^= world.Checksum();
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+void FlatWorldBatch::ForEachWorld(const int& count, const FlatThreadPool::Task& task) {
+	if (threadPool) {
+		threadPool->ParallelFor(count, WORLD_CHUNK_SIZE, task);
+	}
+	else if (count > 0) {
+		task(0, count);
+	}
+}
+
+void FlatWorldBatch::ResetWorld(const int& index) {
+	FlatWorld& world = worlds[index];
+	int first = bodyOffsets[index];
+	int capacity = GetBodyCapacity(index);
+
+	world.GetParticles().Clear();
+
+	bool b_SameBodies = world.BodyCount() == capacity;
+	FlatBody* body = nullptr;
+	for (int i = 0; b_SameBodies && i < capacity; i++) {
+		world.GetBody(i, body);
+		b_SameBodies = body == slotBodies[first + i];
+	}
+
+	if (!b_SameBodies) {
+		// bodies were added or taken out, rebuild the whole world
+		while (world.GetBody((int)world.BodyCount() - 1, body)) {
+			DropSlot(index, body);
+			world.RemoveBody(body);
+			delete body;
+		}
+		world.ResetCaches();
+
+		for (int i = 0; i < capacity; i++) {
+			slotBodies[first + i] = nullptr;
+			if (FlatScenario::CreateBody(initialBodies[first + i], body)) {
+				world.AddBody(body);
+				slotBodies[first + i] = body;
+			}
+		}
+		return;
+	}
+
+	// same bodies, only the state changes
+	bool b_StaticsMoved = false;
+	for (int i = 0; world.GetBody(i, body); i++) {
+		const FlatScenario::BodyDef& def = initialBodies[first + i];
+
+		if (body->b_IsStatic && (body->position.x != def.position.x || body->position.y != def.position.y || body->angle != def.angle)) {
+			b_StaticsMoved = true;
+		}
+
+		body->MoveTo(def.position);
+		body->RotateTo(def.angle);
+		body->linearVelocity = def.linearVelocity;
+		body->angularVelocity = def.angularVelocity;
+		body->force = FlatVector();
+	}
+
+	if (b_StaticsMoved) world.MarkStaticsChanged();
+	world.ResetCaches();
+}
+
+void FlatWorldBatch::DropSlot(const int& index, FlatBody* body) {
+	int first = bodyOffsets[index];
+	int capacity = GetBodyCapacity(index);
+
+	for (int i = 0; i < capacity; i++) {
+		if (slotBodies[first + i] == body) {
+			slotBodies[first + i] = nullptr;
+			return;
+		}
+	}
+}
+
+void FlatWorldBatch::WriteObservations(const int& index) {
+	FlatWorld& world = worlds[index];
+	int first = bodyOffsets[index];
+	int capacity = GetBodyCapacity(index);
+
+	// the world keeps its bodies in slot order, whatever it lost in between
+	FlatBody* body = nullptr;
+	int next = 0;
+	for (int i = 0; i < capacity; i++) {
+		if (slotBodies[first + i] && world.GetBody(next, body) && body == slotBodies[first + i]) {
+			next++;
+			positions[first + i] = body->position;
+			linearVelocities[first + i] = body->linearVelocity;
+			angles[first + i] = body->angle;
+			angularVelocities[first + i] = body->angularVelocity;
+		}
+		else {
+			positions[first + i] = FlatVector();
+			linearVelocities[first + i] = FlatVector();
+			angles[first + i] = 0.0f;
+			angularVelocities[first + i] = 0.0f;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FlatWorld.h"
+#include "FlatScenario.h"
+#include "FlatThreadPool.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Many small independent worlds stepped together, e.g. one per training environment.
+// Worlds are stepped in parallel chunks on one pool (each world stays single-threaded)
+// and their body state is gathered into dense observation arrays after every Step/Reset.
+// Bodies of world w occupy [GetBodyOffset(w), GetBodyOffset(w) + GetBodyCapacity(w)).
+class FlatWorldBatch {
+private:
+	std::vector<FlatWorld> worlds;
+	std::unique_ptr<FlatThreadPool> threadPool;
+
+	// reset state of every world, back to back
+	std::vector<FlatScenario::BodyDef> initialBodies;
+	std::vector<int> bodyOffsets;
+
+	// body in each slot, null once its world has lost it; only compared, never read, so a
+	// lost body's address reused by a new one can't land in its old slot
+	std::vector<FlatBody*> slotBodies;
+
+	std::vector<FlatVector> positions;
+	std::vector<FlatVector> linearVelocities;
+	std::vector<float> angles;
+	std::vector<float> angularVelocities;
+
+public:
+	// Worlds per pool task; enough work per chunk to hide the scheduling cost of tiny worlds
+	static constexpr int WORLD_CHUNK_SIZE = 16;
+
+public:
+	FlatWorldBatch(const int& worldCount, const int& threadCount = FlatThreadPool::HardwareThreadCount());
+
+	FlatWorldBatch(const FlatWorldBatch&) = delete;
+	FlatWorldBatch& operator=(const FlatWorldBatch&) = delete;
+
+	int WorldCount() const;
+	bool GetWorld(const int& index, FlatWorld*& world);
+
+	// Takes the current bodies of every world as the state Reset returns to and lays out
+	// the observation arrays. Step captures on its first call if this wasn't called.
+	void Capture();
+
+	void Step(const int& iterations, const float& dt);
+
+	// Puts the listed worlds back to their captured state, stepping on as a new world would.
+	// Worlds still holding exactly their captured bodies only have their state rewritten and
+	// their caches reset (FlatWorld::ResetCaches); the others are rebuilt. Particles aren't
+	// part of the captured state and are cleared.
+	void Reset(const std::vector<int>& worldIndices);
+	void ResetAll();
+
+	int GetBodyOffset(const int& world) const;
+	int GetBodyCapacity(const int& world) const;
+
+	// Slots of bodies a world has lost are zero
+	const std::vector<FlatVector>& GetPositions() const;
+	const std::vector<FlatVector>& GetLinearVelocities() const;
+	const std::vector<float>& GetAngles() const;
+	const std::vector<float>& GetAngularVelocities() const;
+
+	uint64_t Checksum() const;
+
+private:
+	void ForEachWorld(const int& count, const FlatThreadPool::Task& task);
+	void ResetWorld(const int& index);
+	void DropSlot(const int& index, FlatBody* body);
+	void WriteObservations(const int& index);
+};
@@ -8,12 +8,27 @@
 #include "Random.h"
 
 #include <chrono>
+#include <thread>
+#include <algorithm>
 //#include <iostream>
 
-auto sampleTimer = std::chrono::high_resolution_clock::now();
+static const char* RECORDING_PATH = "recording.scenario";
 
 Game::Game() = default;
 Game::~Game() {
+    if (simulationThread.joinable()) {
+        b_Simulating = false;
+        simulationThread.join();
+    }
+
+    // spawns still queued in the world already have their entities
+    if (world) {
+        world->ApplyCommands();
+        for (auto& body : world->GetAddedBodies()) {
+            entities.push_back(static_cast<FlatEntity*>(body->GetUserData()));
+        }
+    }
+
     for (auto& e : entities) {
         delete e;
     }
@@ -24,6 +39,7 @@ Game::~Game() {
     }
     removalEntities.clear();
 
+    delete recording;
     delete world;
 }
 
@@ -44,14 +60,23 @@ void Game::Init() {
     float paddingY = (maxCam.x - minCam.x) * 0.1f;
     float paddingX = (maxCam.y - minCam.y) * 0.1f;
 
+    // rolling terrain as one chain, its points 1 m apart; the first and last are ghost vertices
+    float groundWidth = maxCam.x - minCam.x - paddingX * 2;
+    int groundSegments = (int)groundWidth;
+    std::vector<FlatVector> groundPoints;
+    for (int i = -1; i <= groundSegments + 1; i++) {
+        float x = -0.5f * groundWidth + groundWidth * i / groundSegments;
+        groundPoints.emplace_back(x, 8.5f - 0.75f * (1.0f - std::cos(x * 0.25f)));
+    }
+
     FlatBody* groundBody = nullptr;
-    FlatBody::CreateBoxBody(maxCam.x - minCam.x - paddingX * 2, 3.0f, 1.0f, true, 0.5f, groundBody);
+    FlatBody::CreateChainBody(groundPoints, false, 0.5f, groundBody);
     if (!groundBody) {
         __debugbreak();
     }
-    groundBody->MoveTo({0, 10});
     world->AddBody(groundBody);
     entities.emplace_back(new FlatEntity(groundBody, DARKGRAY));
+    groundBody->SetUserData(entities.back());
 
     FlatBody* ledgeBody1 = nullptr;
     FlatBody::CreateBoxBody(20.0f, 2.0f, 0.5f, true, 0.5f, ledgeBody1);
@@ -62,6 +87,7 @@ void Game::Init() {
     ledgeBody1->Rotate(2 * PI / 20.0f);
     world->AddBody(ledgeBody1);
     entities.emplace_back(new FlatEntity(ledgeBody1, DARKGREEN));
+    ledgeBody1->SetUserData(entities.back());
 
     FlatBody* ledgeBody2 = nullptr;
     FlatBody::CreateBoxBody(15.0f, 2.0f, 0.5f, true, 0.5f, ledgeBody2);
@@ -72,55 +98,284 @@ void Game::Init() {
     ledgeBody2->Rotate(-2 * PI / 20.0f);
     world->AddBody(ledgeBody2);
     entities.emplace_back(new FlatEntity(ledgeBody2, DARKBROWN));
+    ledgeBody2->SetUserData(entities.back());
+
+    // a chassis with a cabin and two wheels, one rigid body
+    std::vector<FlatShape::Fixture> cart(4);
+    FlatShape::CreateBox(5.0f, 1.0f, cart[0].shape);
+    FlatShape::CreateBox(2.0f, 1.2f, cart[1].shape);
+    cart[1].offset = { -0.8f, -1.1f };
+    FlatShape::CreateCircle(0.7f, cart[2].shape);
+    cart[2].offset = { -1.7f, 0.6f };
+    FlatShape::CreateCircle(0.7f, cart[3].shape);
+    cart[3].offset = { 1.7f, 0.6f };
+
+    if (!FlatShape::CreateCompound(cart, cartShape)) {
+        __debugbreak();
+    }
+
+    sampleTimer = std::chrono::high_resolution_clock::now();
+    stepSampleTimer = sampleTimer;
+    pendingViewMin = FlatConverter::ToFlatVector(minCam);
+    pendingViewMax = FlatConverter::ToFlatVector(maxCam);
+    viewMin = pendingViewMin;
+    viewMax = pendingViewMax;
+
+    // the thread doesn't run yet, so the first frame's snapshot can be taken here
+    Publish();
+    b_Simulating = true;
+    simulationThread = std::thread(&Game::Simulate, this);
 }
 
-void Game::Update(float dt) { 
+void Game::Update() {
     minCam = GetScreenToWorld2D({ 0, 0 }, camera);
     maxCam = GetScreenToWorld2D({ SCREEN_WIDTH, SCREEN_HEIGHT }, camera);
-    
+
     HandleInput();
 
-    auto st = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = st - sampleTimer;
+    auto now = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = now - sampleTimer;
 
     if (elapsed.count() > 1) {
-        bodyCountString = "Body count: " + std::to_string(totalBodyCount / totalSampleCount);
-        worldStepTimeString = "Step time: " + std::to_string(std::round(totalWorldTimeStep / totalSampleCount * 10000.0) / 10000.0);
+        if (totalRenderSampleCount > 0) {
+            std::string renderTime = std::to_string(std::round(totalRenderTime / totalRenderSampleCount * 10000.0) / 10000.0);
+            if (b_BatchedRendering) {
+                batchedRenderTimeString = "Render (batched): " + renderTime;
+            }
+            else {
+                entityRenderTimeString = "Render (per entity): " + renderTime;
+            }
+        }
 
-        totalWorldTimeStep = 0;
-        totalBodyCount = 0;
-        totalSampleCount = 0;
-        sampleTimer = std::chrono::high_resolution_clock::now();
+        totalRenderTime = 0;
+        totalRenderSampleCount = 0;
+        sampleTimer = now;
+    }
+
+    // bodies that leave the camera are dropped by the world on the next tick, and only the
+    // ones inside it go into the snapshot
+    std::lock_guard<std::mutex> lock(commandMutex);
+    pendingViewMin = FlatConverter::ToFlatVector(minCam);
+    pendingViewMax = FlatConverter::ToFlatVector(maxCam);
+}
+
+void Game::Post(const Command& command) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    pendingCommands.push_back(command);
+}
+
+void Game::Simulate() {
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration tickLength = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(TICK));
+
+    Clock::time_point next = Clock::now();
+    while (b_Simulating) {
+        Tick();
+
+        // a tick that overran starts the next one late rather than queueing catch-up ticks
+        next += tickLength;
+        Clock::time_point now = Clock::now();
+        if (next < now) next = now;
+
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void Game::Tick() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        commands.swap(pendingCommands);
+        viewMin = pendingViewMin;
+        viewMax = pendingViewMax;
+    }
+
+    for (auto& command : commands) {
+        command();
+    }
+    commands.clear();
+
+    // spawns are taken in here rather than inside Step, so recordings hold them as spawned
+    world->ApplyCommands();
+    for (auto& body : world->GetAddedBodies()) {
+        entities.push_back(static_cast<FlatEntity*>(body->GetUserData()));
+
+        if (recording) {
+            recording->RecordSpawn(recordFrame, body);
+        }
+    }
+
+    world->SetBounds(FlatAABB(viewMin, viewMax));
+    if (recording) {
+        recording->RecordBounds(recordFrame, viewMin, viewMax);
     }
-    
-    world->Step(20, dt);
+
+    auto st = std::chrono::high_resolution_clock::now();
+    world->Step(iterations, TICK);
     auto ed = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> duration = ed - st;
-    
+
     totalWorldTimeStep += duration.count();
     totalBodyCount += world->BodyCount();
     totalSampleCount++;
 
+    if (std::chrono::duration<double>(ed - stepSampleTimer).count() > 1) {
+        averageStepTime = totalWorldTimeStep / totalSampleCount;
+        averageBodyCount = totalBodyCount / totalSampleCount;
+
+        totalWorldTimeStep = 0;
+        totalBodyCount = 0;
+        totalSampleCount = 0;
+        stepSampleTimer = ed;
+    }
+
+    if (recording) {
+        recording->RecordChecksum(world->Checksum());
+    }
+
+    // bodies that left the camera, or were removed by command, were taken out during Step
     removalEntities.clear();
+    for (auto& body : world->GetRemovedBodies()) {
+        removalEntities.push_back(static_cast<FlatEntity*>(body->GetUserData()));
+    }
 
-    for (auto& e : entities) {
-        if (e->body->b_IsStatic) continue;
+    if (!removalEntities.empty()) {
+        std::sort(removalEntities.begin(), removalEntities.end());
+        entities.erase(std::remove_if(entities.begin(), entities.end(), [this](FlatEntity* e) {
+            return std::binary_search(removalEntities.begin(), removalEntities.end(), e);
+        }), entities.end());
 
-        FlatAABB box = e->body->GetAABB();
-        if (box.max.x < minCam.x || box.min.x > maxCam.x ||
-            box.max.y < minCam.y || box.min.y > maxCam.y) {
-            removalEntities.push_back(e);
+        for (auto& e : removalEntities) {
+            delete e;
         }
+        removalEntities.clear();
     }
 
-    for (auto& e : removalEntities) {
-        world->RemoveBody(e->body);
-        entities.erase(std::remove(entities.begin(), entities.end(), e), entities.end());
+    if (recording) {
+        recordFrame++;
+    }
+
+    tick++;
+    Publish();
+}
+
+void Game::Publish() {
+    // the back buffer keeps its capacity, so a steady scene publishes without allocating
+    RenderSnapshot& snapshot = snapshots.Back();
+    snapshot.tick = tick;
+
+    // culled through the broadphase, which Step left exact for the moved bodies
+    world->QueryAABB(FlatAABB(viewMin, viewMax), visibleBodies);
+    snapshot.pieces.clear();
+    for (auto& body : visibleBodies) {
+        static_cast<FlatEntity*>(body->GetUserData())->Capture(snapshot.pieces);
     }
+    snapshot.drawnCount = visibleBodies.size();
+    snapshot.culledCount = entities.size() - visibleBodies.size();
+
+    const FlatParticleSystem& particles = world->GetParticles();
+    snapshot.particleX.assign(particles.GetPositionsX(), particles.GetPositionsX() + particles.Count());
+    snapshot.particleY.assign(particles.GetPositionsY(), particles.GetPositionsY() + particles.Count());
+    snapshot.particleRadius = particles.GetRadius();
+
+    const FlatWorld::StepStats& stats = world->GetStepStats();
+    snapshot.particleTime = stats.particleTime;
+    snapshot.substepCount = stats.substepCount;
+    snapshot.stepTime = averageStepTime;
+    snapshot.bodyCount = averageBodyCount;
+    snapshot.b_AdaptiveSubsteps = world->IsAdaptiveSubsteps();
+    snapshot.stepMode = world->GetStepMode();
+    snapshot.b_Recording = recording != nullptr;
+    snapshot.recordingString = recordingString;
+
+    snapshots.Publish();
+}
+
+void Game::Spawn(FlatBody* body, const FlatVector& position, const Color& color) {
+    if (!body) {
+        __debugbreak();
+    }
+    body->MoveTo(position);
+
+    // the body carries its entity to the simulation thread, which owns it from the tick that adds the body
+    FlatEntity* entity = new FlatEntity(body, color);
+    body->SetUserData(entity);
+
+    FlatWorld::Command command;
+    command.type = FlatWorld::Command::Add;
+    command.body = body;
+    world->Enqueue(command);
 }
 
 void Game::HandleKeyInput() {
+    if (IsKeyPressed(KEY_R)) {
+        Post([this] {
+            if (!recording) {
+                recording = new FlatScenario();
+                recording->CaptureScene(world, iterations, TICK);
+                recordFrame = 0;
+                recordingString = "Recording...";
+            }
+            else {
+                bool saved = recording->Save(RECORDING_PATH);
+                recordingString = saved ?
+                    "Saved " + std::to_string(recording->FrameCount()) + " frames to " + RECORDING_PATH :
+                    std::string("Could not save ") + RECORDING_PATH;
+
+                delete recording;
+                recording = nullptr;
+            }
+        });
+    }
+
+    if (IsKeyPressed(KEY_B)) {
+        b_BatchedRendering = !b_BatchedRendering;
+        totalRenderTime = 0;
+        totalRenderSampleCount = 0;
+    }
 
+    if (IsKeyPressed(KEY_C)) {
+        FlatVector position = FlatConverter::ToFlatVector(GetScreenToWorld2D(GetMousePosition(), camera));
+        Color color = Graphics::GetRandomColor();
+
+        FlatBody* body = nullptr;
+        FlatBody::CreateBody(cartShape, 1.0f, false, 0.2f, body);
+        Spawn(body, position, color);
+    }
+
+    // scenarios don't hold particles, so none are poured while recording
+    if (IsKeyDown(KEY_P)) {
+        FlatVector spout = FlatConverter::ToFlatVector(GetScreenToWorld2D(GetMousePosition(), camera));
+
+        Post([this, spout] {
+            if (recording) return;
+
+            FlatParticleSystem& particles = world->GetParticles();
+            float spacing = 2.2f * particles.GetRadius();
+
+            // fast enough that the previous tick's row has moved a spacing on
+            FlatVector velocity(0.0f, spacing / TICK);
+            for (int i = 0; i < PARTICLES_PER_FRAME; i++) {
+                float x = (i - (PARTICLES_PER_FRAME - 1) * 0.5f) * spacing;
+                particles.AddParticle(spout + FlatVector(x, 0.0f), velocity);
+            }
+        });
+    }
+
+    // the recording holds a single mode, so it can't change mid-recording
+    if (IsKeyPressed(KEY_M)) {
+        Post([this] {
+            if (recording) return;
+            world->SetStepMode(world->GetStepMode() == FlatWorld::Substep ? FlatWorld::SoftStep : FlatWorld::Substep);
+        });
+    }
+
+    // iterations stays the cap when adaptive
+    if (IsKeyPressed(KEY_A)) {
+        Post([this] {
+            if (recording) return;
+            world->SetAdaptiveSubsteps(!world->IsAdaptiveSubsteps());
+        });
+    }
 }
 
 void Game::HandleMouseInput() {
@@ -130,19 +385,26 @@ void Game::HandleMouseInput() {
         camera.target = Vector2Add(camera.target, delta);
     }
 
+    // bodies are built here and queued on the world; rand and raylib's random values aren't thread safe
     if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
         float width = Random::Float(2.0f, 3.5f);
         float height = Random::Float(2.0f, 3.5f);
+        FlatVector position = FlatConverter::ToFlatVector(GetScreenToWorld2D(GetMousePosition(), camera));
+        Color color = Graphics::GetRandomColor();
 
-        entities.emplace_back(new FlatEntity(world, width, height, false, 
-            FlatConverter::ToFlatVector(GetScreenToWorld2D(GetMousePosition(), camera))));
+        FlatBody* body = nullptr;
+        FlatBody::CreateBoxBody(width, height, 1.0f, false, 0.5f, body);
+        Spawn(body, position, color);
     }
 
     if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
         float radius = Random::Float(0.5f, 2.0f);
+        FlatVector position = FlatConverter::ToFlatVector(GetScreenToWorld2D(GetMousePosition(), camera));
+        Color color = Graphics::GetRandomColor();
 
-        entities.emplace_back(new FlatEntity(world, radius, false, 
-            FlatConverter::ToFlatVector(GetScreenToWorld2D(GetMousePosition(), camera))));
+        FlatBody* body = nullptr;
+        FlatBody::CreateCircleBody(radius, 1.0f, false, 0.5f, body);
+        Spawn(body, position, color);
     }
 
     float wheel = GetMouseWheelMove();
@@ -163,20 +425,63 @@ void Game::HandleInput() {
 }
 
 void Game::Render() {
+    // keeps the last snapshot when no tick finished since the previous frame
+    snapshots.Acquire();
+    const RenderSnapshot& snapshot = snapshots.Front();
+
     BeginDrawing();
     ClearBackground(RAYWHITE);
+
+    auto st = std::chrono::high_resolution_clock::now();
+
+    // the camera may have moved during input handling, so take its rectangle now
+    Vector2 viewMin = GetScreenToWorld2D({ 0, 0 }, camera);
+    Vector2 viewMax = GetScreenToWorld2D({ SCREEN_WIDTH, SCREEN_HEIGHT }, camera);
+    FlatAABB view(viewMin.x, viewMin.y, viewMax.x, viewMax.y);
+
     BeginMode2D(camera); 
 
-    for (auto& e : entities) {
-        e->Render(e->body->shapeType);
+    batchRenderer.Begin();
+    for (auto& piece : snapshot.pieces) {
+        if (b_BatchedRendering) batchRenderer.AddPiece(piece);
+        else FlatEntity::Render(piece);
     }
 
-    EndMode2D();
-    DrawText(worldStepTimeString.c_str(), 20, 20, 20, BLACK);
+    // particles aren't entities, both paths batch them
+    batchRenderer.AddParticles(snapshot.particleX, snapshot.particleY, snapshot.particleRadius, view, DARKBROWN);
+    batchRenderer.Flush();
+
+    EndMode2D(); // flushes the rlgl batch, so the timing covers the draw submission
+    auto ed = std::chrono::high_resolution_clock::now();
+    totalRenderTime += std::chrono::duration<double, std::milli>(ed - st).count();
+    totalRenderSampleCount++;
+
+    stepTimeString = "Step time: " + std::to_string(std::round(snapshot.stepTime * 10000.0) / 10000.0);
+    bodyCountString = "Body count: " + std::to_string(snapshot.bodyCount);
+    DrawText(stepTimeString.c_str(), 20, 20, 20, BLACK);
     DrawText(bodyCountString.c_str(), 20, 40, 20, BLACK);
+    DrawText(batchedRenderTimeString.c_str(), 20, 60, 20, b_BatchedRendering ? DARKGREEN : BLACK);
+    DrawText(entityRenderTimeString.c_str(), 20, 80, 20, b_BatchedRendering ? BLACK : DARKGREEN);
+    cullingString = "Drawn: " + std::to_string(snapshot.drawnCount) +
+        "  Culled: " + std::to_string(snapshot.culledCount);
+    DrawText(cullingString.c_str(), 20, 100, 20, BLACK);
+    DrawText(snapshot.recordingString.c_str(), 20, 120, 20, snapshot.b_Recording ? RED : BLACK);
+    DrawText(snapshot.stepMode == FlatWorld::SoftStep ? "Step: soft (M)" : "Step: substeps (M)", 20, 140, 20, BLACK);
+    particleString = "Particles: " + std::to_string(snapshot.particleX.size()) +
+        "  (" + std::to_string(std::round(snapshot.particleTime * 100.0) / 100.0) + " ms)";
+    DrawText(particleString.c_str(), 20, 160, 20, BLACK);
+
+    substepString = "Substeps: " + std::to_string(snapshot.substepCount) +
+        (snapshot.b_AdaptiveSubsteps ? " adaptive (A)" : " fixed (A)");
+    DrawText(substepString.c_str(), 20, 180, 20, BLACK);
     EndDrawing();
 }
 
 void Game::Quit() {
+    b_Simulating = false;
+    if (simulationThread.joinable()) {
+        simulationThread.join();
+    }
+
     CloseWindow();
-}
+}
\ No newline at end of file
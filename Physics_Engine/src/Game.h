@@ -2,20 +2,83 @@
 
 #include "raylib.h"
 #include "FlatEntity.h"
+#include "FlatScenario.h"
+#include "BatchRenderer.h"
+#include "RenderSnapshot.h"
+#include "TripleBuffer.h"
 #include <vector>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <chrono>
 
+// The window thread handles input and draws; the world is stepped on a simulation thread at a
+// fixed tick. Spawned bodies reach the world through its command queue, other input as Game
+// commands run at the start of the next tick, and the world reaches the window as a
+// RenderSnapshot published after each tick. Everything below "simulation thread" is only
+// touched by that thread once it runs.
 class Game {
+public:
+	static constexpr float TICK = 1.0f / 60.0f; // s
+
 private:
-	Camera2D camera = { 0 }; 
+	// window thread
+	Camera2D camera = { 0 };
 	Vector2 minCam, maxCam;
+
+	BatchRenderer batchRenderer;
+	bool b_BatchedRendering = true;
+	double totalRenderTime = 0;
+	int totalRenderSampleCount = 0;
+	std::string batchedRenderTimeString = "Render (batched): -";
+	std::string entityRenderTimeString = "Render (per entity): -";
+	std::string stepTimeString;
+	std::string bodyCountString;
+	std::string cullingString;
+	std::string particleString;
+	std::string substepString;
+	std::chrono::high_resolution_clock::time_point sampleTimer;
+
+	// particles poured per frame while P is held, one row leaving the cursor each tick
+	static const int PARTICLES_PER_FRAME = 8;
+
+	// shared: commands and the camera rectangle under commandMutex, snapshots without a lock
+	using Command = std::function<void()>;
+	std::mutex commandMutex;
+	std::vector<Command> pendingCommands;
+	FlatVector pendingViewMin;
+	FlatVector pendingViewMax;
+	TripleBuffer<RenderSnapshot> snapshots;
+
+	std::thread simulationThread;
+	std::atomic<bool> b_Simulating{ false };
+
+	// created in Init and only read after, spawns build bodies on the window thread
 	FlatWorld* world = nullptr;
+	std::shared_ptr<const FlatShape> cartShape; // one compound shape shared by every cart
+
+	// simulation thread
+	int iterations = 20;
+	uint64_t tick = 0;
+	std::vector<Command> commands;
+
+	// camera rectangle of the current tick: the world's bounds and what Publish captures
+	FlatVector viewMin;
+	FlatVector viewMax;
+	std::vector<FlatBody*> visibleBodies;
+
+	FlatScenario* recording = nullptr;
+	int recordFrame = 0;
+	std::string recordingString;
 
 	double totalWorldTimeStep = 0;
 	size_t totalBodyCount = 0;
 	int totalSampleCount = 0;
-	std::string worldStepTimeString;
-	std::string bodyCountString;
+	double averageStepTime = 0;
+	size_t averageBodyCount = 0;
+	std::chrono::high_resolution_clock::time_point stepSampleTimer;
 
 	std::vector<FlatEntity*> entities;
 	std::vector<FlatEntity*> removalEntities;
@@ -24,11 +87,23 @@ public:
 	Game();
 	~Game();
 
+	// Opens the window, builds the scene and starts the simulation thread
 	void Init();
 	void HandleKeyInput();
 	void HandleMouseInput();
 	void HandleInput();
-	void Update(float dt);
+
+	// Window thread, once per frame: input and the camera rectangle go to the simulation thread
+	void Update();
 	void Render();
+
+	// Stops the simulation thread, then closes the window
 	void Quit();
-};
\ No newline at end of file
+
+private:
+	void Post(const Command& command);
+	void Simulate();
+	void Tick();
+	void Publish();
+	void Spawn(FlatBody* body, const FlatVector& position, const Color& color);
+};
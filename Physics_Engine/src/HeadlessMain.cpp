@@ -0,0 +1,32 @@
+#include "Benchmark.h"
+#include "CollisionDiff.h"
+#include "CommandCheck.h"
+
+#include <cstdio>
+#include <cstring>
+
+// The physics without raylib or a window: microbenchmarks, and the checks the build's tests run
+int main(int argc, char** argv) {
+    if (argc == 2 && std::strcmp(argv[1], "--bench-math") == 0) {
+        return Benchmark::RunMath();
+    }
+
+    if (argc == 2 && std::strcmp(argv[1], "--bench-solver") == 0) {
+        return Benchmark::RunSolver();
+    }
+
+    if (argc == 2 && std::strcmp(argv[1], "--bench-collisions") == 0) {
+        return Benchmark::RunCollisions();
+    }
+
+    if (argc == 2 && std::strcmp(argv[1], "--diff-collisions") == 0) {
+        return CollisionDiff::Run();
+    }
+
+    if (argc == 2 && std::strcmp(argv[1], "--check-commands") == 0) {
+        return CommandCheck::Run();
+    }
+
+    std::printf("usage: %s --bench-math | --bench-solver | --bench-collisions | --diff-collisions | --check-commands\n", argv[0]);
+    return 1;
+}
@@ -1,16 +1,23 @@
 #include "Game.h"
+#include "ScenarioReplay.h"
+
+#include <cstring>
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::strcmp(argv[1], "--replay") == 0) {
+        return ScenarioReplay::RunFile(argv[2]);
+    }
 
-int main(void) {
     Game* game = new Game();
     game->Init();
 
-    float dt = 1.0f / 60.0f;
+    // the world steps at Game::TICK on its own thread; this loop only handles input and draws
     while (!WindowShouldClose()) {
-        game->Update(dt);
+        game->Update();
         game->Render(); 
     }
 
     game->Quit();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "raylib.h"
+#include "FlatShape.h"
+#include "FlatWorld.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Everything Game::Render draws, published by the simulation thread after each tick. It holds
+// copies rather than pointers into the world, so it stays valid while the next Step runs.
+struct RenderSnapshot {
+	// One circle, box or segment at its world transform; a compound adds one per fixture and a
+	// chain one per segment, centered on it and with its length as the width
+	struct Piece {
+		static constexpr float SEGMENT_THICKNESS = 0.2f; // m, as drawn
+
+		FlatShape::ShapeType type = FlatShape::Box;
+		FlatVector position;
+		float angle = 0.0f;
+		float width = 0.0f;
+		float height = 0.0f;
+		float radius = 0.0f;
+		Color color = { 0, 0, 0, 255 };
+	};
+
+	uint64_t tick = 0;
+	std::vector<Piece> pieces; // of the bodies the broadphase finds in the camera rectangle
+
+	size_t drawnCount = 0;  // bodies
+	size_t culledCount = 0;
+
+	std::vector<float> particleX;
+	std::vector<float> particleY;
+	float particleRadius = 0.0f;
+	double particleTime = 0.0; // ms, last Step
+
+	double stepTime = 0.0;  // ms, averaged over about a second
+	size_t bodyCount = 0;   // averaged with stepTime
+	int substepCount = 0;
+	bool b_AdaptiveSubsteps = false;
+	FlatWorld::StepMode stepMode = FlatWorld::Substep;
+
+	bool b_Recording = false;
+	std::string recordingString;
+};
@@ -0,0 +1,114 @@
+#include "ScenarioReplay.h"
+
+#include <chrono>
+#include <cstdio>
+
+bool ScenarioReplay::Run(const FlatScenario& scenario, Report& report) {
+	report = Report();
+
+	FlatWorld world;
+	world.SetStepMode(scenario.stepMode);
+	world.SetAdaptiveSubsteps(scenario.b_AdaptiveSubsteps, scenario.minSubsteps);
+	world.SetContactSoftness(scenario.contactHertz, scenario.contactDampingRatio);
+
+	for (auto& def : scenario.scene) {
+		FlatBody* body = nullptr;
+		if (!FlatScenario::CreateBody(def, body)) return false;
+		world.AddBody(body);
+	}
+
+	size_t nextEvent = 0;
+	const std::vector<FlatScenario::Event>& events = scenario.events;
+
+	for (int frame = 0; frame < scenario.FrameCount(); frame++) {
+		for (; nextEvent < events.size() && events[nextEvent].frame == frame &&
+			events[nextEvent].type != FlatScenario::Event::Remove; nextEvent++)
+		{
+			const FlatScenario::Event& e = events[nextEvent];
+
+			if (e.type == FlatScenario::Event::Bounds) {
+				world.SetBounds(FlatAABB(e.boundsMin, e.boundsMax));
+				continue;
+			}
+
+			FlatBody* body = nullptr;
+			if (!FlatScenario::CreateBody(e.body, body)) return false;
+			world.AddBody(body);
+		}
+
+		auto st = std::chrono::high_resolution_clock::now();
+		world.Step(scenario.iterations, scenario.dt);
+		auto ed = std::chrono::high_resolution_clock::now();
+		double stepTime = std::chrono::duration<double, std::milli>(ed - st).count();
+
+		const FlatWorld::StepStats& stats = world.GetStepStats();
+		report.totalStepTime += stepTime;
+		if (stepTime > report.maxStepTime) report.maxStepTime = stepTime;
+		report.phaseTotals.integrateTime += stats.integrateTime;
+		report.phaseTotals.broadPhaseTime += stats.broadPhaseTime;
+		report.phaseTotals.narrowPhaseTime += stats.narrowPhaseTime;
+		report.phaseTotals.pairCount += stats.pairCount;
+		report.phaseTotals.contactCount += stats.contactCount;
+		report.phaseTotals.axisCacheLookups += stats.axisCacheLookups;
+		report.phaseTotals.axisCacheHits += stats.axisCacheHits;
+
+		for (auto& body : world.GetRemovedBodies()) {
+			delete body;
+		}
+
+		if (world.Checksum() != scenario.checksums[frame]) {
+			if (report.firstDivergentFrame < 0) report.firstDivergentFrame = frame;
+			report.divergentFrames++;
+		}
+
+		for (; nextEvent < events.size() && events[nextEvent].frame == frame; nextEvent++) {
+			if (events[nextEvent].type != FlatScenario::Event::Remove) return false;
+
+			FlatBody* body = nullptr;
+			if (!world.GetBody(events[nextEvent].bodyIndex, body)) return false;
+			world.RemoveBody(body);
+			delete body;
+		}
+
+		report.frameCount++;
+	}
+
+	return true;
+}
+
+int ScenarioReplay::RunFile(const std::string& path) {
+	FlatScenario scenario;
+	if (!scenario.Load(path)) {
+		std::printf("replay: could not load scenario '%s'\n", path.c_str());
+		return 2;
+	}
+
+	Report report;
+	if (!Run(scenario, report)) {
+		std::printf("replay: scenario '%s' references a body that could not be created or found\n", path.c_str());
+		return 2;
+	}
+
+	double frames = report.frameCount > 0 ? (double)report.frameCount : 1.0;
+
+	std::printf("replay: %s\n", path.c_str());
+	std::printf("  frames        %d (%d iterations, dt %.6f)\n", report.frameCount, scenario.iterations, scenario.dt);
+	std::printf("  step          avg %.4f ms, max %.4f ms\n", report.totalStepTime / frames, report.maxStepTime);
+	std::printf("  integrate     avg %.4f ms\n", report.phaseTotals.integrateTime / frames);
+	std::printf("  broad phase   avg %.4f ms, %.1f pairs\n",
+		report.phaseTotals.broadPhaseTime / frames, report.phaseTotals.pairCount / frames);
+	std::printf("  narrow phase  avg %.4f ms, %.1f contacts\n",
+		report.phaseTotals.narrowPhaseTime / frames, report.phaseTotals.contactCount / frames);
+	std::printf("  axis cache    %.1f%% hits, %.1f box pairs\n",
+		report.phaseTotals.axisCacheLookups > 0 ? 100.0 * report.phaseTotals.axisCacheHits / report.phaseTotals.axisCacheLookups : 0.0,
+		report.phaseTotals.axisCacheLookups / frames);
+
+	if (report.divergentFrames > 0) {
+		std::printf("  DIVERGED at frame %d (%d of %d frames differ)\n",
+			report.firstDivergentFrame, report.divergentFrames, report.frameCount);
+		return 1;
+	}
+
+	std::printf("  checksums match\n");
+	return 0;
+}
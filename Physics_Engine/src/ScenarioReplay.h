@@ -0,0 +1,23 @@
+#pragma once
+
+#include "FlatScenario.h"
+#include "FlatWorld.h"
+#include <string>
+
+// Headless re-simulation of a recorded FlatScenario, used as a reproducible
+// performance regression check: every frame's checksum is compared against
+// the recording and the step time is accumulated per phase.
+class ScenarioReplay {
+public:
+	struct Report {
+		int frameCount = 0;
+		int divergentFrames = 0;
+		int firstDivergentFrame = -1;
+		double totalStepTime = 0.0;   // ms
+		double maxStepTime = 0.0;     // ms
+		FlatWorld::StepStats phaseTotals;
+	};
+
+	static bool Run(const FlatScenario& scenario, Report& report);
+	static int RunFile(const std::string& path);
+};
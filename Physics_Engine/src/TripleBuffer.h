@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+// Hands the latest T from one producer thread to one consumer thread without locks. The producer
+// fills Back() and calls Publish(); the consumer calls Acquire() and reads Front() until its next
+// Acquire. Neither ever waits: the producer always owns a buffer the consumer isn't reading, and
+// a T that is published over before the consumer acquires it is dropped.
+template<typename T>
+class TripleBuffer {
+private:
+	static constexpr int INDEX_MASK = 3;
+	static constexpr int FRESH = 4; // the middle buffer was published since the last Acquire
+
+	T buffers[3];
+	int back = 0;
+	int front = 1;
+	std::atomic<int> middle{ 2 };
+
+public:
+	// Producer side. Back() may hold any older T and has to be filled from scratch.
+	T& Back() {
+		return buffers[back];
+	}
+
+	void Publish() {
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Consumer side. Returns false, keeping the current Front(), when nothing new was published.
+	bool Acquire() {
+		if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& Front() const {
+		return buffers[front];
+	}
+};